@@ -0,0 +1,157 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Each stage of a formula on its own: lexing, parsing and evaluating, over a
+// few typical inputs and over sums of a growing number of terms.
+//
+//   bazel run -c opt //src/benchmarks:formula_benchmark
+
+#include "proto/latis_msg.pb.h"
+#include "src/formula/common.h"
+#include "src/formula/evaluator.h"
+#include "src/formula/formula.h"
+#include "src/formula/lexer.h"
+#include "src/formula/parser.h"
+#include "src/utils/thread_pool.h"
+
+#include "absl/types/optional.h"
+#include "benchmark/benchmark.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace latis {
+namespace formula {
+namespace {
+
+const std::vector<std::string> &Inputs() {
+  static const auto *const inputs = new std::vector<std::string>{
+      "12345",
+      "3.14159",
+      "\"a string\"",
+      "A1 * 2 + B2",
+      "SUM(A1:A100) / 100",
+      "POW(A1, 2) % 7",
+      "(A1 > 100) && NOT(B2 <= 3.5)",
+  };
+  return *inputs;
+}
+
+// "1 + 1 + ... + 1", of |terms| terms.
+std::string Sum(int terms) {
+  std::string sum = "1";
+  for (int i = 1; i < terms; ++i) {
+    sum += " + 1";
+  }
+  return sum;
+}
+
+// Every cell reads as 2.
+const LookupFn &Lookup() {
+  static const auto *const lookup_fn = new LookupFn([](XY) {
+    Amount amount;
+    amount.set_int_amount(2);
+    return absl::optional<Amount>(amount);
+  });
+  return *lookup_fn;
+}
+
+Expression ParseOrDie(const std::string &input) {
+  const std::vector<Token> tokens = Lex(input).ValueOrDie();
+  TSpan tspan{tokens};
+  return Parser().ConsumeExpression(&tspan).ValueOrDie();
+}
+
+void BM_Lex(benchmark::State &state, const std::string &input) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Lex(input));
+  }
+  state.SetBytesProcessed(state.iterations() * input.size());
+}
+
+void BM_ConsumeExpression(benchmark::State &state, const std::string &input) {
+  const std::vector<Token> tokens = Lex(input).ValueOrDie();
+  Parser parser;
+  for (auto _ : state) {
+    TSpan tspan{tokens};
+    benchmark::DoNotOptimize(parser.ConsumeExpression(&tspan));
+  }
+  state.SetItemsProcessed(state.iterations() * tokens.size());
+}
+
+void BM_CrunchExpression(benchmark::State &state, const std::string &input) {
+  const Expression expression = ParseOrDie(input);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Evaluator(Lookup()).CrunchExpression(expression));
+  }
+}
+
+void BM_LexSum(benchmark::State &state) { BM_Lex(state, Sum(state.range(0))); }
+BENCHMARK(BM_LexSum)->RangeMultiplier(4)->Range(1, 1 << 10);
+
+// As above, but into one buffer throughout.
+void BM_LexIntoSum(benchmark::State &state) {
+  const std::string input = Sum(state.range(0));
+  std::vector<Token> tokens;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(LexInto(input, &tokens));
+  }
+  state.SetBytesProcessed(state.iterations() * input.size());
+}
+BENCHMARK(BM_LexIntoSum)->RangeMultiplier(4)->Range(1, 1 << 10);
+
+void BM_ConsumeExpressionSum(benchmark::State &state) {
+  BM_ConsumeExpression(state, Sum(state.range(0)));
+}
+BENCHMARK(BM_ConsumeExpressionSum)->RangeMultiplier(4)->Range(1, 1 << 10);
+
+void BM_CrunchExpressionSum(benchmark::State &state) {
+  BM_CrunchExpression(state, Sum(state.range(0)));
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_CrunchExpressionSum)->RangeMultiplier(4)->Range(1, 1 << 10);
+
+// Parses 4096 of Inputs() at once, on a pool of range(0) workers.
+void BM_ParseMany(benchmark::State &state) {
+  std::vector<std::string_view> inputs;
+  for (int i = 0; i < 4096; ++i) {
+    inputs.push_back(Inputs()[i % Inputs().size()]);
+  }
+  std::unique_ptr<ThreadPool> pool;
+  if (state.range(0) > 0) {
+    pool = std::make_unique<ThreadPool>(state.range(0));
+  }
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ParseMany(inputs, pool.get()));
+  }
+  state.SetItemsProcessed(state.iterations() * inputs.size());
+}
+BENCHMARK(BM_ParseMany)->Arg(0)->Arg(1)->Arg(3)->Arg(7)->UseRealTime();
+
+// One of each per entry of Inputs(), named after the input.
+const bool kRegistered = [] {
+  for (const std::string &input : Inputs()) {
+    benchmark::RegisterBenchmark(("BM_Lex/" + input).c_str(), BM_Lex, input);
+    benchmark::RegisterBenchmark(("BM_ConsumeExpression/" + input).c_str(),
+                                 BM_ConsumeExpression, input);
+    benchmark::RegisterBenchmark(("BM_CrunchExpression/" + input).c_str(),
+                                 BM_CrunchExpression, input);
+  }
+  return true;
+}();
+
+} // namespace
+} // namespace formula
+} // namespace latis
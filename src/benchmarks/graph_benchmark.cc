@@ -0,0 +1,177 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Building a graph::Graph edge by edge, and walking it, for graphs of a few
+// shapes and of growing size; and stabbing a graph::RangeIndex.
+//
+//   bazel run -c opt //src/benchmarks:graph_benchmark
+
+#include "src/graph/graph.h"
+#include "src/graph/range_index.h"
+
+#include "benchmark/benchmark.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace latis {
+namespace graph {
+namespace {
+
+using Edges = std::vector<std::pair<int, int>>;
+
+// 0 -> 1 -> ... -> n - 1, in that order. Every edge agrees with the order so
+// far, so none needs reordering.
+Edges Chain(int n) {
+  Edges edges;
+  for (int i = 0; i + 1 < n; ++i) {
+    edges.emplace_back(i, i + 1);
+  }
+  return edges;
+}
+
+// The same chain, inserted from the far end. Every edge is from a node new to
+// the graph, which is placed first, so none needs reordering either.
+Edges ReverseChain(int n) {
+  Edges edges = Chain(n);
+  std::reverse(edges.begin(), edges.end());
+  return edges;
+}
+
+// 0 -> i, for every i.
+Edges FanOut(int n) {
+  Edges edges;
+  for (int i = 1; i < n; ++i) {
+    edges.emplace_back(0, i);
+  }
+  return edges;
+}
+
+// i -> n - 1, for every i.
+Edges FanIn(int n) {
+  Edges edges;
+  for (int i = 0; i + 1 < n; ++i) {
+    edges.emplace_back(i, n - 1);
+  }
+  return edges;
+}
+
+// A square grid in which every node points right and down.
+Edges Grid(int n) {
+  int side = 1;
+  while (side * side < n) {
+    side++;
+  }
+  Edges edges;
+  for (int y = 0; y < side; ++y) {
+    for (int x = 0; x < side; ++x) {
+      if (x + 1 < side) {
+        edges.emplace_back(y * side + x, y * side + x + 1);
+      }
+      if (y + 1 < side) {
+        edges.emplace_back(y * side + x, (y + 1) * side + x);
+      }
+    }
+  }
+  return edges;
+}
+
+// From 8 to 32K nodes.
+void Sizes(benchmark::internal::Benchmark *b) {
+  b->RangeMultiplier(8)->Range(8, 1 << 15);
+}
+
+void BM_AddEdge(benchmark::State &state, Edges (*shape)(int)) {
+  const Edges edges = shape(state.range(0));
+  for (auto _ : state) {
+    Graph<int> g;
+    for (const auto &[from, to] : edges) {
+      benchmark::DoNotOptimize(g.AddEdge(from, to));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * edges.size());
+}
+BENCHMARK_CAPTURE(BM_AddEdge, chain, Chain)->Apply(Sizes);
+BENCHMARK_CAPTURE(BM_AddEdge, reverse_chain, ReverseChain)->Apply(Sizes);
+BENCHMARK_CAPTURE(BM_AddEdge, fan_out, FanOut)->Apply(Sizes);
+BENCHMARK_CAPTURE(BM_AddEdge, fan_in, FanIn)->Apply(Sizes);
+BENCHMARK_CAPTURE(BM_AddEdge, grid, Grid)->Apply(Sizes);
+
+// A cell which nothing reads yet starts to read the head of a chain of
+// range(0) cells, i.e. an edge from a node new to the graph into one with
+// everything downstream of it. Costs the same at any length.
+void BM_AddEdgeFromNewSource(benchmark::State &state) {
+  const int n = state.range(0);
+  Graph<int> g;
+  for (const auto &[from, to] : Chain(n)) {
+    g.AddEdge(from, to);
+  }
+  int source = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(g.AddEdge(--source, 0));
+  }
+}
+BENCHMARK(BM_AddEdgeFromNewSource)->Apply(Sizes);
+
+// The same, but every edge is from the tail of the chain into a node new to
+// the graph.
+void BM_AddEdgeToNewTarget(benchmark::State &state) {
+  const int n = state.range(0);
+  Graph<int> g;
+  for (const auto &[from, to] : Chain(n)) {
+    g.AddEdge(from, to);
+  }
+  int target = n;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(g.AddEdge(n - 1, target++));
+  }
+}
+BENCHMARK(BM_AddEdgeToNewTarget)->Apply(Sizes);
+
+void BM_GetDescendantsOf(benchmark::State &state, Edges (*shape)(int)) {
+  Graph<int> g;
+  for (const auto &[from, to] : shape(state.range(0))) {
+    g.AddEdge(from, to);
+  }
+  size_t descendants = 0;
+  for (auto _ : state) {
+    descendants = g.GetDescendantsOf(0).size();
+    benchmark::DoNotOptimize(descendants);
+  }
+  state.SetItemsProcessed(state.iterations() * descendants);
+}
+BENCHMARK_CAPTURE(BM_GetDescendantsOf, chain, Chain)->Apply(Sizes);
+BENCHMARK_CAPTURE(BM_GetDescendantsOf, fan_out, FanOut)->Apply(Sizes);
+BENCHMARK_CAPTURE(BM_GetDescendantsOf, fan_in, FanIn)->Apply(Sizes);
+BENCHMARK_CAPTURE(BM_GetDescendantsOf, grid, Grid)->Apply(Sizes);
+
+// SUM(Bi:Di) in each of range(0) rows, stabbed a row at a time in column C.
+void BM_Stab(benchmark::State &state) {
+  const int n = state.range(0);
+  RangeIndex<int> index;
+  for (int y = 0; y < n; ++y) {
+    index.Insert(y, 1, y, 3, y);
+  }
+  int y = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(index.Stab(2, y));
+    y = (y + 1) % n;
+  }
+}
+BENCHMARK(BM_Stab)->Apply(Sizes);
+
+} // namespace
+} // namespace graph
+} // namespace latis
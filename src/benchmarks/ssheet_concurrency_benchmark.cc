@@ -0,0 +1,79 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Read throughput of SSheet::Get() from several threads at once, alone and
+// alongside a thread which keeps writing. With reads sharing the sheet, items
+// per second should grow with the number of threads, up to the number of
+// cores.
+//
+//   bazel run -c opt //src/benchmarks:ssheet_concurrency_benchmark
+
+#include "src/ssheet_impl.h"
+#include "src/xy.h"
+
+#include "absl/strings/str_format.h"
+#include "benchmark/benchmark.h"
+
+namespace latis {
+namespace {
+
+constexpr int kRows = 10000;
+
+// Column A holds numbers, and column B doubles them. Shared by every thread of
+// every benchmark.
+SSheet *Sheet() {
+  static SSheet *const sheet = [] {
+    auto *sheet = new SSheet();
+    for (int y = 0; y < kRows; ++y) {
+      sheet->Set(XY(0, y), absl::StrFormat("%d", y));
+      sheet->Set(XY(1, y), absl::StrFormat("A%d * 2", y + 1));
+    }
+    return sheet;
+  }();
+  return sheet;
+}
+
+void BM_Get(benchmark::State &state) {
+  SSheet *sheet = Sheet();
+  // Each thread starts somewhere else in the column.
+  int y = (state.thread_index() * 997) % kRows;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(sheet->Get(XY(1, y)));
+    y = (y + 1) % kRows;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Get)->ThreadRange(1, 32)->UseRealTime();
+
+// Thread 0 rewrites cells of column D, which nothing reads, while the others
+// read column B. Only the reads are counted.
+void BM_GetWhileSetting(benchmark::State &state) {
+  SSheet *sheet = Sheet();
+  int y = (state.thread_index() * 997) % kRows;
+  for (auto _ : state) {
+    if (state.thread_index() == 0) {
+      sheet->Set(XY(3, y), absl::StrFormat("%d", y));
+    } else {
+      benchmark::DoNotOptimize(sheet->Get(XY(1, y)));
+    }
+    y = (y + 1) % kRows;
+  }
+  if (state.thread_index() != 0) {
+    state.SetItemsProcessed(state.iterations());
+  }
+}
+BENCHMARK(BM_GetWhileSetting)->ThreadRange(2, 32)->UseRealTime();
+
+} // namespace
+} // namespace latis
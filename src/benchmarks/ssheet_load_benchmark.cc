@@ -0,0 +1,70 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Time to read a sheet in from a LatisMsg, including linking up every
+// formula's dependencies. Should stay in the low seconds at a million
+// formulas.
+//
+//   bazel run -c opt //src/benchmarks:ssheet_load_benchmark
+
+#include "proto/latis_msg.pb.h"
+#include "src/formula/formula.h"
+#include "src/ssheet_impl.h"
+#include "src/xy.h"
+
+#include "absl/strings/str_format.h"
+#include "benchmark/benchmark.h"
+
+#include <algorithm>
+#include <string>
+
+namespace latis {
+namespace {
+
+// |rows| rows, each a number in column A, a formula doubling it in column B,
+// and a formula summing the column B of the ten rows above it in column C.
+LatisMsg Workbook(int rows) {
+  LatisMsg msg;
+  const auto add = [&msg](XY xy, const std::string &input) {
+    Cell *cell = msg.add_cells();
+    *cell->mutable_point_location() = xy.ToPointLocation();
+    *cell->mutable_formula()->mutable_expression() =
+        formula::ParseExpression(input).ValueOrDie();
+  };
+  for (int y = 0; y < rows; ++y) {
+    add(XY(0, y), absl::StrFormat("%d", y));
+    add(XY(1, y), absl::StrFormat("A%d * 2", y + 1));
+    add(XY(2, y),
+        absl::StrFormat("SUM(B%d:B%d)", std::max(1, y - 9), y + 1));
+  }
+  return msg;
+}
+
+void BM_Load(benchmark::State &state) {
+  const LatisMsg msg = Workbook(state.range(0));
+  for (auto _ : state) {
+    SSheet sheet(msg);
+    benchmark::DoNotOptimize(sheet.Height());
+  }
+  state.SetItemsProcessed(state.iterations() * msg.cells_size());
+}
+// Two formulas per row, so up to a million.
+BENCHMARK(BM_Load)
+    ->RangeMultiplier(8)
+    ->Range(1 << 10, 1 << 19)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+} // namespace
+} // namespace latis
@@ -0,0 +1,146 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// SSheet::Set() on sheets of a few shapes and of growing size: both filling
+// in a sheet cell by cell, and editing the one cell everything else hangs
+// off, which recalculates the rest.
+//
+//   bazel run -c opt //src/benchmarks:ssheet_set_benchmark
+
+#include "src/ssheet_impl.h"
+#include "src/xy.h"
+
+#include "absl/strings/str_format.h"
+#include "benchmark/benchmark.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace latis {
+namespace {
+
+using Inputs = std::vector<std::pair<XY, std::string>>;
+
+// A1 = 1, A2 = A1 + 1, ..., each cell reading the one before it.
+Inputs Chain(int n) {
+  Inputs inputs{{XY(0, 0), "1"}};
+  for (int y = 1; y < n; ++y) {
+    inputs.emplace_back(XY(0, y), XY(0, y - 1).ToA1() + " + 1");
+  }
+  return inputs;
+}
+
+// A1 = 1, and every other cell of column B reads it.
+Inputs FanOut(int n) {
+  Inputs inputs{{XY(0, 0), "1"}};
+  for (int y = 0; y + 1 < n; ++y) {
+    inputs.emplace_back(XY(1, y), "A1 * 2");
+  }
+  return inputs;
+}
+
+// Column A holds numbers, and B1 sums them.
+Inputs FanIn(int n) {
+  Inputs inputs;
+  for (int y = 0; y + 1 < n; ++y) {
+    inputs.emplace_back(XY(0, y), absl::StrFormat("%d", y));
+  }
+  inputs.emplace_back(XY(1, 0), absl::StrFormat("SUM(A1:A%d)", n - 1));
+  return inputs;
+}
+
+// A square, in which A1 = 1, and every other cell adds up the cells to its
+// left and above it.
+Inputs Grid(int n) {
+  int side = 1;
+  while (side * side < n) {
+    side++;
+  }
+  Inputs inputs;
+  for (int y = 0; y < side; ++y) {
+    for (int x = 0; x < side; ++x) {
+      std::string input;
+      if (x > 0) {
+        input = XY(x - 1, y).ToA1();
+      }
+      if (y > 0) {
+        input += (input.empty() ? "" : " + ") + XY(x, y - 1).ToA1();
+      }
+      inputs.emplace_back(XY(x, y), input.empty() ? "1" : input);
+    }
+  }
+  return inputs;
+}
+
+// From 8 to 32K cells.
+void Sizes(benchmark::internal::Benchmark *b) {
+  b->RangeMultiplier(8)->Range(8, 1 << 15);
+}
+
+// Fills in an empty sheet, one Set() per cell.
+void BM_Fill(benchmark::State &state, Inputs (*shape)(int)) {
+  const Inputs inputs = shape(state.range(0));
+  for (auto _ : state) {
+    SSheet sheet;
+    for (const auto &[xy, input] : inputs) {
+      benchmark::DoNotOptimize(sheet.Set(xy, input));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * inputs.size());
+}
+
+// Rewrites A1, which every other cell depends on.
+void BM_SetRoot(benchmark::State &state, Inputs (*shape)(int)) {
+  const Inputs inputs = shape(state.range(0));
+  SSheet sheet;
+  for (const auto &[xy, input] : inputs) {
+    sheet.Set(xy, input);
+  }
+  int i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        sheet.Set(XY(0, 0), absl::StrFormat("%d", i++ % 100)));
+  }
+  state.SetItemsProcessed(state.iterations() * inputs.size());
+}
+
+// Adds a cell to a column of numbers right after taking a snapshot, as the
+// first edit after WriteTo() would; so the write is the first to find the
+// sheet's storage shared.
+void BM_SetAfterSnapshot(benchmark::State &state) {
+  SSheet sheet;
+  for (int y = 0; y < state.range(0); ++y) {
+    sheet.Set(XY(0, y), absl::StrFormat("%d", y));
+  }
+  int y = 0;
+  for (auto _ : state) {
+    SSheet::Snapshot snapshot = sheet.TakeSnapshot();
+    benchmark::DoNotOptimize(sheet.Set(XY(1, y), "1"));
+    y = (y + 1) % state.range(0);
+  }
+}
+
+BENCHMARK_CAPTURE(BM_Fill, chain, Chain)->Apply(Sizes);
+BENCHMARK_CAPTURE(BM_Fill, fan_out, FanOut)->Apply(Sizes);
+BENCHMARK_CAPTURE(BM_Fill, fan_in, FanIn)->Apply(Sizes);
+BENCHMARK_CAPTURE(BM_Fill, grid, Grid)->Apply(Sizes);
+BENCHMARK_CAPTURE(BM_SetRoot, chain, Chain)->Apply(Sizes);
+BENCHMARK_CAPTURE(BM_SetRoot, fan_out, FanOut)->Apply(Sizes);
+BENCHMARK_CAPTURE(BM_SetRoot, fan_in, FanIn)->Apply(Sizes);
+BENCHMARK_CAPTURE(BM_SetRoot, grid, Grid)->Apply(Sizes);
+BENCHMARK(BM_SetAfterSnapshot)->RangeMultiplier(8)->Range(8, 1 << 18);
+
+} // namespace
+} // namespace latis
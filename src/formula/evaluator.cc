@@ -32,15 +32,10 @@ using ::google::protobuf::util::error::OK;
 
 namespace {
 
-Amount BoolToAmount(bool b) {
-  Amount a;
-  a.set_bool_amount(b);
-  return a;
-}
 // Monadic shim.
-StatusOr<Amount> BoolToAmount(StatusOr<bool> b) {
+StatusOr<Value> BoolToValue(StatusOr<bool> b) {
   if (b.ok()) {
-    return BoolToAmount(b.ValueOrDie());
+    return Value::Bool(b.ValueOrDie());
   }
   return b.status();
 }
@@ -48,9 +43,17 @@ StatusOr<Amount> BoolToAmount(StatusOr<bool> b) {
 } // namespace
 
 StatusOr<Amount> Evaluator::CrunchExpression(const Expression &expression) {
-  // NB: no has_range.
+  StringArena arena;
+  Value value;
+  ASSIGN_OR_RETURN_(value, CrunchValue(expression));
+  return value.ToAmount();
+}
+
+StatusOr<Value> Evaluator::CrunchValue(const Expression &expression) {
+  // NB: no has_range. Ranges are only meaningful as the argument of an
+  // aggregating operation, see CrunchRangeOperation().
   if (expression.has_value()) {
-    return expression.value();
+    return Value::From(expression.value());
   } else if (expression.has_operation()) {
     return CrunchOperation(expression.operation());
   } else if (expression.has_lookup()) {
@@ -60,7 +63,7 @@ StatusOr<Amount> Evaluator::CrunchExpression(const Expression &expression) {
   }
 }
 
-StatusOr<Amount>
+StatusOr<Value>
 Evaluator::CrunchPointLocation(const PointLocation &point_location) {
   const XY xy = XY::From(point_location);
   const absl::optional<Amount> maybe_value = lookup_fn_(xy);
@@ -68,16 +71,19 @@ Evaluator::CrunchPointLocation(const PointLocation &point_location) {
     return Status(INVALID_ARGUMENT,
                   absl::StrFormat("Evaluator: no value in cell %s", xy.ToA1()));
   }
-  return maybe_value.value();
+  return Value::Keep(maybe_value.value());
 }
 
-StatusOr<Amount> Evaluator::CrunchOperation(const Expression::Operation &op) {
+StatusOr<Value> Evaluator::CrunchOperation(const Expression::Operation &op) {
   std::string_view fn_name = op.fn_name();
 
   switch (op.terms_size()) {
   case (1): {
-    Amount arg;
-    ASSIGN_OR_RETURN_(arg, CrunchExpression(op.terms(0)));
+    if (op.terms(0).has_range()) {
+      return CrunchRangeOperation(fn_name, op.terms(0).range());
+    }
+    Value arg;
+    ASSIGN_OR_RETURN_(arg, CrunchValue(op.terms(0)));
     if (fn_name == functions::kNOT) {
       return !arg;
     } else if (fn_name == functions::kNEG) {
@@ -85,10 +91,10 @@ StatusOr<Amount> Evaluator::CrunchOperation(const Expression::Operation &op) {
     }
   }
   case (2): {
-    Amount lhs;
-    ASSIGN_OR_RETURN_(lhs, CrunchExpression(op.terms(0)));
-    Amount rhs;
-    ASSIGN_OR_RETURN_(rhs, CrunchExpression(op.terms(1)));
+    Value lhs;
+    ASSIGN_OR_RETURN_(lhs, CrunchValue(op.terms(0)));
+    Value rhs;
+    ASSIGN_OR_RETURN_(rhs, CrunchValue(op.terms(1)));
 
     if (fn_name == functions::kPLUS || fn_name == functions::kSUM ||
         fn_name == functions::kADD) {
@@ -107,17 +113,17 @@ StatusOr<Amount> Evaluator::CrunchOperation(const Expression::Operation &op) {
     } else if (fn_name == functions::kOR) {
       return lhs || rhs;
     } else if (fn_name == functions::kLTHAN) {
-      return BoolToAmount(lhs < rhs);
+      return BoolToValue(lhs < rhs);
     } else if (fn_name == functions::kGTHAN) {
-      return BoolToAmount(lhs > rhs);
+      return BoolToValue(lhs > rhs);
     } else if (fn_name == functions::kLEQ) {
-      return BoolToAmount(lhs <= rhs);
+      return BoolToValue(lhs <= rhs);
     } else if (fn_name == functions::kGEQ) {
-      return BoolToAmount(lhs >= rhs);
+      return BoolToValue(lhs >= rhs);
     } else if (fn_name == functions::kEQ) {
-      return BoolToAmount(lhs == rhs);
+      return BoolToValue(lhs == rhs);
     } else if (fn_name == functions::kNEQ) {
-      return BoolToAmount(lhs != rhs);
+      return BoolToValue(lhs != rhs);
     } else if (fn_name == functions::kPOW) {
       return lhs ^ rhs;
     } else if (fn_name == functions::kMOD) {
@@ -130,5 +136,45 @@ StatusOr<Amount> Evaluator::CrunchOperation(const Expression::Operation &op) {
   }
 }
 
+StatusOr<Value>
+Evaluator::CrunchRangeOperation(std::string_view fn_name,
+                                const RangeLocation &range_location) {
+  const auto maybe_range = XYRange::From(range_location);
+  if (!maybe_range.ok()) {
+    return maybe_range.status();
+  }
+  const XYRange range = maybe_range.ValueOrDie();
+  if (!range.IsBounded()) {
+    return Status(INVALID_ARGUMENT,
+                  "Evaluator: can't aggregate over an unbounded range");
+  }
+
+  StatusOr<Value> (*fold)(Value, Value);
+  if (fn_name == functions::kPLUS || fn_name == functions::kSUM ||
+      fn_name == functions::kADD) {
+    fold = [](Value lhs, Value rhs) { return lhs + rhs; };
+  } else if (fn_name == functions::kMULTIPLIED_BY ||
+             fn_name == functions::kTIMES || fn_name == functions::kPRODUCT) {
+    fold = [](Value lhs, Value rhs) { return lhs * rhs; };
+  } else if (fn_name == functions::kAND) {
+    fold = [](Value lhs, Value rhs) { return lhs && rhs; };
+  } else if (fn_name == functions::kOR) {
+    fold = [](Value lhs, Value rhs) { return lhs || rhs; };
+  } else {
+    return Status(INVALID_ARGUMENT, " no range operation match.");
+  }
+
+  return FoldRange(
+      range,
+      [this](XY xy) -> absl::optional<Value> {
+        const absl::optional<Amount> maybe_value = lookup_fn_(xy);
+        if (!maybe_value.has_value()) {
+          return absl::nullopt;
+        }
+        return Value::Keep(maybe_value.value());
+      },
+      fold);
+}
+
 } // namespace formula
 } // namespace latis
@@ -19,6 +19,7 @@
 
 #include "proto/latis_msg.pb.h"
 #include "src/formula/common.h"
+#include "src/formula/value.h"
 #include "src/xy.h"
 
 #include "absl/types/optional.h"
@@ -38,12 +39,23 @@ public:
   ::google::protobuf::util::StatusOr<Amount>
   CrunchExpression(const Expression &expression);
 
-  ::google::protobuf::util::StatusOr<Amount>
+  // As above, but stays in the native Value representation. Any string
+  // computed is kept in the caller's StringArena.
+  ::google::protobuf::util::StatusOr<Value>
+  CrunchValue(const Expression &expression);
+
+  ::google::protobuf::util::StatusOr<Value>
   CrunchPointLocation(const PointLocation &operation);
 
-  ::google::protobuf::util::StatusOr<Amount>
+  ::google::protobuf::util::StatusOr<Value>
   CrunchOperation(const Expression::Operation &operation);
 
+  // Folds the (non-empty) cells of a bounded range with the binary operation
+  // named |fn_name|, i.e. SUM(A1:A3) = A1 + A2 + A3.
+  ::google::protobuf::util::StatusOr<Value>
+  CrunchRangeOperation(std::string_view fn_name,
+                       const RangeLocation &range_location);
+
 private:
   const LookupFn &lookup_fn_;
 };
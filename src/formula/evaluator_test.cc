@@ -189,6 +189,33 @@ INSTANTIATE_TEST_SUITE_P(
         },
     }));
 
+class RangeTest : public TestClassBase {};
+
+TEST_F(RangeTest, SumSkipsEmptyCells) {
+  EXPECT_CALL(mock_lookup_fn_, Call)
+      .WillRepeatedly(Return(absl::optional<Amount>()));
+  EXPECT_CALL(mock_lookup_fn_, Call(XY(0, 0)))
+      .WillOnce(Return(ToProto<Amount>("int_amount: 1")));
+  EXPECT_CALL(mock_lookup_fn_, Call(XY(0, 2)))
+      .WillOnce(Return(ToProto<Amount>("int_amount: 2")));
+
+  Run("SUM(A1:A3)", "int_amount: 3");
+}
+
+TEST_F(RangeTest, EmptyRange) {
+  EXPECT_CALL(mock_lookup_fn_, Call)
+      .Times(2)
+      .WillRepeatedly(Return(absl::optional<Amount>()));
+
+  Run("SUM(A1:B1)", absl::nullopt);
+}
+
+TEST_F(RangeTest, UnboundedRange) {
+  EXPECT_CALL(mock_lookup_fn_, Call).Times(0);
+
+  Run("SUM(A:B)", absl::nullopt);
+}
+
 } // namespace
 } // namespace formula
 } // namespace latis
@@ -31,16 +31,39 @@ namespace formula {
 
 using ::google::protobuf::util::StatusOr;
 
-StatusOr<std::tuple<Expression, Amount>> Parse(std::string_view input,
-                                               const LookupFn &lookup_fn) {
-  static Parser parser{};
+StatusOr<Expression> ParseExpression(std::string_view input) {
+  // One of each per thread, so that threads can parse alongside each other.
+  // Both are kept between calls, so that neither allocates for anything
+  // shorter than the longest input so far.
+  thread_local Parser parser{};
+  thread_local std::vector<Token> tokens;
 
-  std::vector<Token> tokens;
-  ASSIGN_OR_RETURN_(tokens, Lex(input));
+  RETURN_IF_ERROR_(LexInto(input, &tokens));
   TSpan tspan{tokens};
 
+  return parser.ConsumeExpression(&tspan);
+}
+
+std::vector<StatusOr<Expression>>
+ParseMany(absl::Span<const std::string_view> inputs, ThreadPool *pool) {
+  std::vector<StatusOr<Expression>> resultant(inputs.size());
+  const auto parse = [&](size_t i) {
+    resultant[i] = ParseExpression(inputs[i]);
+  };
+  if (pool == nullptr) {
+    for (size_t i = 0; i < inputs.size(); ++i) {
+      parse(i);
+    }
+  } else {
+    pool->ParallelFor(inputs.size(), parse);
+  }
+  return resultant;
+}
+
+StatusOr<std::tuple<Expression, Amount>> Parse(std::string_view input,
+                                               const LookupFn &lookup_fn) {
   Expression expr;
-  ASSIGN_OR_RETURN_(expr, parser.ConsumeExpression(&tspan));
+  ASSIGN_OR_RETURN_(expr, ParseExpression(input));
 
   Amount amt;
   ASSIGN_OR_RETURN_(amt, Evaluator(lookup_fn).CrunchExpression(expr));
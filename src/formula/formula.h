@@ -19,13 +19,29 @@
 
 #include "proto/latis_msg.pb.h"
 #include "src/formula/common.h"
+#include "src/utils/thread_pool.h"
 
 #include "absl/strings/str_format.h"
+#include "absl/types/span.h"
 #include "google/protobuf/stubs/statusor.h"
 
+#include <string_view>
+#include <vector>
+
 namespace latis {
 namespace formula {
 
+// Lex and parse, without evaluating. Safe to call from any number of threads
+// at once.
+::google::protobuf::util::StatusOr<Expression>
+ParseExpression(std::string_view input);
+
+// ParseExpression() on each of |inputs|, with the results in the same order.
+// If there is a |pool|, the inputs are shared out across it.
+std::vector<::google::protobuf::util::StatusOr<Expression>>
+ParseMany(absl::Span<const std::string_view> inputs,
+          ThreadPool *pool = nullptr);
+
 // One-stop shop for lex, parse, and evaluate.
 ::google::protobuf::util::StatusOr<std::tuple<Expression, Amount>>
 Parse(std::string_view input, const LookupFn &lookup_fn);
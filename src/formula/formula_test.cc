@@ -0,0 +1,121 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/formula/formula.h"
+
+#include "src/test_utils/test_utils.h"
+#include "src/utils/thread_pool.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace latis {
+namespace formula {
+namespace {
+
+using ::testing::Not;
+
+// A mix of inputs, some of which don't parse.
+std::vector<std::string> Inputs(int n) {
+  std::vector<std::string> inputs;
+  for (int i = 0; i < n; ++i) {
+    switch (i % 4) {
+    case 0:
+      inputs.push_back(std::to_string(i));
+      break;
+    case 1:
+      inputs.push_back("SUM(A1:A" + std::to_string(i) + ") + B2");
+      break;
+    case 2:
+      inputs.push_back("(A" + std::to_string(i) + " * 2");
+      break;
+    case 3:
+      inputs.push_back("\"" + std::to_string(i) + "\" ++");
+      break;
+    }
+  }
+  return inputs;
+}
+
+void ExpectSameAsOneByOne(
+    const std::vector<std::string> &inputs,
+    const std::vector<::google::protobuf::util::StatusOr<Expression>>
+        &results) {
+  ASSERT_EQ(results.size(), inputs.size());
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    const auto expected = ParseExpression(inputs[i]);
+    ASSERT_EQ(results[i].ok(), expected.ok()) << inputs[i];
+    if (expected.ok()) {
+      EXPECT_THAT(results[i].ValueOrDie(), EqualsProto(expected.ValueOrDie()))
+          << inputs[i];
+    }
+  }
+}
+
+TEST(ParseMany, Empty) { EXPECT_TRUE(ParseMany({}).empty()); }
+
+TEST(ParseMany, InOrder) {
+  const std::vector<std::string> inputs = {"1", "A1 + 2", "(", "\"s\""};
+  const std::vector<std::string_view> views(inputs.begin(), inputs.end());
+
+  const auto results = ParseMany(views);
+  ASSERT_EQ(results.size(), 4);
+  EXPECT_THAT(results[0], IsOk());
+  EXPECT_THAT(results[1], IsOk());
+  EXPECT_THAT(results[2], Not(IsOk()));
+  EXPECT_THAT(results[3], IsOk());
+  ExpectSameAsOneByOne(inputs, results);
+}
+
+class ParseManyTest : public ::testing::TestWithParam<int> {};
+
+TEST_P(ParseManyTest, SameAsOneByOne) {
+  const std::vector<std::string> inputs = Inputs(1000);
+  const std::vector<std::string_view> views(inputs.begin(), inputs.end());
+
+  ThreadPool pool(GetParam());
+  ExpectSameAsOneByOne(inputs, ParseMany(views, &pool));
+}
+
+INSTANTIATE_TEST_SUITE_P(Threads, ParseManyTest, ::testing::Values(0, 1, 3));
+
+TEST(ParseExpression, FromManyThreads) {
+  const std::vector<std::string> inputs = Inputs(200);
+
+  std::vector<std::vector<::google::protobuf::util::StatusOr<Expression>>>
+      results(4);
+  std::vector<std::thread> threads;
+  for (auto &result : results) {
+    threads.emplace_back([&inputs, &result] {
+      for (const std::string &input : inputs) {
+        result.push_back(ParseExpression(input));
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  for (const auto &result : results) {
+    ExpectSameAsOneByOne(inputs, result);
+  }
+}
+
+} // namespace
+} // namespace formula
+} // namespace latis
@@ -16,8 +16,11 @@
 
 #include "src/utils/status_macros.h"
 
+#include "absl/strings/str_cat.h"
+
 #include <cmath>
 #include <functional>
+#include <limits>
 
 namespace latis {
 namespace formula {
@@ -30,20 +33,14 @@ using ::google::protobuf::util::error::OK;
 
 namespace {
 
-// Numeric conversions.
-
-bool IsNumeric(const Amount &a) {
-  return a.has_int_amount() || a.has_double_amount();
-}
-double AsDouble(const Amount &a) {
-  return a.double_amount() + static_cast<double>(a.int_amount());
-}
-
 // Money conversions.
 
 double AsDouble(const Money &m) {
   return m.dollars() + (static_cast<double>(m.cents()) / 100.0);
 }
+double MoneyAsDouble(Value m) {
+  return m.dollars() + (static_cast<double>(m.cents()) / 100.0);
+}
 
 Money AsMoney(double d) {
   Money resultant;
@@ -58,6 +55,10 @@ Money AsMoney(double d) {
   }
   return resultant;
 }
+Value AsMoneyValue(double d, Money::Currency currency) {
+  const Money m = AsMoney(d);
+  return Value::OfMoney(m.dollars(), m.cents(), currency);
+}
 
 Status CheckSameCurrency(const Money &lhs, const Money &rhs) {
   if (lhs.currency() != rhs.currency()) {
@@ -65,17 +66,30 @@ Status CheckSameCurrency(const Money &lhs, const Money &rhs) {
   }
   return Status(OK, "");
 }
+Status CheckSameCurrency(Value lhs, Value rhs) {
+  if (lhs.currency() != rhs.currency()) {
+    return Status(INVALID_ARGUMENT, "different currencies.");
+  }
+  return Status(OK, "");
+}
 
-// Amount conversions
-Amount FromInt(int i) {
-  Amount resultant;
-  resultant.set_int_amount(i);
-  return resultant;
+// An Amount only has room for an int32, so an int result which doesn't fit is
+// an error, rather than something which is right mid-expression and wraps once
+// stored.
+StatusOr<Value> IntValue(int64_t i) {
+  if (i < std::numeric_limits<int32_t>::min() ||
+      i > std::numeric_limits<int32_t>::max()) {
+    return Status(INVALID_ARGUMENT, "integer overflow.");
+  }
+  return Value::Int(i);
 }
-Amount FromDouble(double d) {
-  Amount resultant;
-  resultant.set_double_amount(d);
-  return resultant;
+
+// Monadic shim.
+StatusOr<Amount> ToAmount(StatusOr<Value> v) {
+  if (v.ok()) {
+    return v.ValueOrDie().ToAmount();
+  }
+  return v.status();
 }
 
 } // namespace
@@ -132,158 +146,197 @@ StatusOr<Money> operator/(const Money &lhs, const Money &rhs) {
   return resultant;
 }
 
-// AMOUNTS
-
-StatusOr<bool> operator<=(const Amount &lhs, const Amount &rhs) {
-  if (lhs.has_str_amount() && rhs.has_str_amount()) {
-    return lhs.str_amount() <= rhs.str_amount();
-  } else if (lhs.has_timestamp_amount() && rhs.has_timestamp_amount()) {
-    return lhs.timestamp_amount() <= rhs.timestamp_amount();
-  } else if (lhs.has_money_amount() && rhs.has_money_amount()) {
-    return lhs.money_amount() <= rhs.money_amount();
-  } else if (lhs.has_int_amount() && rhs.has_int_amount()) {
-    return lhs.int_amount() <= rhs.int_amount();
-  } else if (lhs.has_bool_amount() && rhs.has_bool_amount()) {
-    return lhs.bool_amount() <= rhs.bool_amount();
-  } else if (IsNumeric(lhs) && IsNumeric(rhs)) {
-    return AsDouble(lhs) <= AsDouble(rhs);
+// VALUES
+
+StatusOr<bool> operator<=(Value lhs, Value rhs) {
+  using K = Value::Kind;
+  if (lhs.kind() == K::kString && rhs.kind() == K::kString) {
+    return lhs.string_value() <= rhs.string_value();
+  } else if (lhs.kind() == K::kTimestamp && rhs.kind() == K::kTimestamp) {
+    return lhs.seconds() <= rhs.seconds() && lhs.nanos() <= rhs.nanos();
+  } else if (lhs.kind() == K::kMoney && rhs.kind() == K::kMoney) {
+    return lhs.dollars() <= rhs.dollars() && lhs.cents() <= rhs.cents();
+  } else if (lhs.kind() == K::kInt && rhs.kind() == K::kInt) {
+    return lhs.int_value() <= rhs.int_value();
+  } else if (lhs.kind() == K::kBool && rhs.kind() == K::kBool) {
+    return lhs.bool_value() <= rhs.bool_value();
+  } else if (lhs.IsNumeric() && rhs.IsNumeric()) {
+    return lhs.AsDouble() <= rhs.AsDouble();
   }
   return Status(INVALID_ARGUMENT, "No operator<=() implemented.");
 }
 
-StatusOr<bool> operator==(const Amount &lhs, const Amount &rhs) {
-  if (lhs.has_str_amount() && rhs.has_str_amount()) {
-    return lhs.str_amount() == rhs.str_amount();
-  } else if (lhs.has_timestamp_amount() && rhs.has_timestamp_amount()) {
-    return lhs.timestamp_amount() == rhs.timestamp_amount();
-  } else if (lhs.has_money_amount() && rhs.has_money_amount()) {
-    return lhs.money_amount() == rhs.money_amount();
-  } else if (lhs.has_int_amount() && rhs.has_int_amount()) {
-    return lhs.int_amount() == rhs.int_amount();
-  } else if (lhs.has_bool_amount() && rhs.has_bool_amount()) {
-    return lhs.bool_amount() == rhs.bool_amount();
-  } else if (IsNumeric(lhs) && IsNumeric(rhs)) {
-    return AsDouble(lhs) == AsDouble(rhs);
+StatusOr<bool> operator==(Value lhs, Value rhs) {
+  using K = Value::Kind;
+  if (lhs.kind() == K::kString && rhs.kind() == K::kString) {
+    return lhs.string_value() == rhs.string_value();
+  } else if (lhs.kind() == K::kTimestamp && rhs.kind() == K::kTimestamp) {
+    return lhs.seconds() == rhs.seconds() && lhs.nanos() == rhs.nanos();
+  } else if (lhs.kind() == K::kMoney && rhs.kind() == K::kMoney) {
+    return lhs.dollars() == rhs.dollars() && lhs.cents() == rhs.cents() &&
+           lhs.currency() == rhs.currency();
+  } else if (lhs.kind() == K::kInt && rhs.kind() == K::kInt) {
+    return lhs.int_value() == rhs.int_value();
+  } else if (lhs.kind() == K::kBool && rhs.kind() == K::kBool) {
+    return lhs.bool_value() == rhs.bool_value();
+  } else if (lhs.IsNumeric() && rhs.IsNumeric()) {
+    return lhs.AsDouble() == rhs.AsDouble();
   }
   return Status(INVALID_ARGUMENT, "No operator<=() implemented.");
 }
 
-StatusOr<Amount> operator+(const Amount &lhs, const Amount &rhs) {
-  Amount resultant;
-
-  if (lhs.has_str_amount() && rhs.has_str_amount()) {
-    resultant = lhs;
-    resultant.mutable_str_amount()->append(rhs.str_amount());
-    return resultant;
-  } else if (lhs.has_timestamp_amount() && rhs.has_timestamp_amount()) {
-    ASSIGN_OR_RETURN_(*resultant.mutable_timestamp_amount(),
-                      lhs.timestamp_amount() + rhs.timestamp_amount());
-    return resultant;
-  } else if (lhs.has_money_amount() && rhs.has_money_amount()) {
-    ASSIGN_OR_RETURN_(*resultant.mutable_money_amount(),
-                      lhs.money_amount() + rhs.money_amount());
-    return resultant;
-  } else if (lhs.has_int_amount() && rhs.has_int_amount()) {
-    return FromInt(lhs.int_amount() + rhs.int_amount());
-  } else if (IsNumeric(lhs) && IsNumeric(rhs)) {
-    // guaranteed not to double-count ;)
-    return FromDouble(AsDouble(lhs) + AsDouble(rhs));
+StatusOr<Value> operator+(Value lhs, Value rhs) {
+  using K = Value::Kind;
+  if (lhs.kind() == K::kString && rhs.kind() == K::kString) {
+    return Value::String(StringArena::Keep(
+        absl::StrCat(lhs.string_value(), rhs.string_value())));
+  } else if (lhs.kind() == K::kTimestamp && rhs.kind() == K::kTimestamp) {
+    return Value::OfTimestamp(lhs.seconds() + rhs.seconds(),
+                              lhs.nanos() + rhs.nanos());
+  } else if (lhs.kind() == K::kMoney && rhs.kind() == K::kMoney) {
+    RETURN_IF_ERROR_(CheckSameCurrency(lhs, rhs));
+    return AsMoneyValue(MoneyAsDouble(lhs) + MoneyAsDouble(rhs),
+                        lhs.currency());
+  } else if (lhs.kind() == K::kInt && rhs.kind() == K::kInt) {
+    return IntValue(lhs.int_value() + rhs.int_value());
+  } else if (lhs.IsNumeric() && rhs.IsNumeric()) {
+    return Value::Double(lhs.AsDouble() + rhs.AsDouble());
   }
   return Status(INVALID_ARGUMENT, "no sum");
 }
 
-StatusOr<Amount> operator-(const Amount &arg) {
-  Amount resultant = arg;
-  if (resultant.has_int_amount()) {
-    return FromInt(-arg.int_amount());
-  } else if (resultant.has_double_amount()) {
-    return FromDouble(-arg.double_amount());
-  } else if (resultant.has_money_amount()) {
-    *resultant.mutable_money_amount() = -resultant.money_amount();
-  } else if (resultant.has_timestamp_amount()) {
-    *resultant.mutable_timestamp_amount() = -resultant.timestamp_amount();
-  } else if (resultant.has_bool_amount()) {
-    resultant.set_bool_amount(-resultant.bool_amount());
-  } else if (resultant.has_str_amount()) {
+StatusOr<Value> operator-(Value arg) {
+  using K = Value::Kind;
+  switch (arg.kind()) {
+  case K::kInt:
+    return IntValue(-arg.int_value());
+  case K::kDouble:
+    return Value::Double(-arg.double_value());
+  case K::kMoney:
+    return AsMoneyValue(-1.0 * MoneyAsDouble(arg), arg.currency());
+  case K::kTimestamp:
+    return Value::OfTimestamp(-arg.seconds(), -arg.nanos());
+  case K::kString:
     return Status(INVALID_ARGUMENT, "Can't negate a string.");
+  default:
+    // Negating a bool, i.e. casting -1 or -0 back to bool, is a no-op.
+    return arg;
   }
-  return resultant;
 }
 
-StatusOr<Amount> operator*(const Amount &lhs, const Amount &rhs) {
-  Amount resultant;
-
-  if (lhs.has_money_amount() && rhs.has_money_amount()) {
-    ASSIGN_OR_RETURN_(*resultant.mutable_money_amount(),
-                      lhs.money_amount() * rhs.money_amount());
-    return resultant;
-  } else if (lhs.has_int_amount() && rhs.has_int_amount()) {
-    return FromInt(lhs.int_amount() * rhs.int_amount());
-  } else if (IsNumeric(lhs) && IsNumeric(rhs)) {
-    return FromDouble(AsDouble(lhs) * AsDouble(rhs));
+StatusOr<Value> operator*(Value lhs, Value rhs) {
+  using K = Value::Kind;
+  if (lhs.kind() == K::kMoney && rhs.kind() == K::kMoney) {
+    RETURN_IF_ERROR_(CheckSameCurrency(lhs, rhs));
+    return AsMoneyValue(MoneyAsDouble(lhs) * MoneyAsDouble(rhs),
+                        lhs.currency());
+  } else if (lhs.kind() == K::kInt && rhs.kind() == K::kInt) {
+    return IntValue(lhs.int_value() * rhs.int_value());
+  } else if (lhs.IsNumeric() && rhs.IsNumeric()) {
+    return Value::Double(lhs.AsDouble() * rhs.AsDouble());
   }
-
   return Status(INVALID_ARGUMENT, "no product");
 }
 
-StatusOr<Amount> operator/(const Amount &lhs, const Amount &rhs) {
-  Amount resultant;
-
-  if (lhs.has_money_amount() && rhs.has_money_amount()) {
-    ASSIGN_OR_RETURN_(*resultant.mutable_money_amount(),
-                      lhs.money_amount() / rhs.money_amount());
-    return resultant;
-  } else if (IsNumeric(lhs) && IsNumeric(rhs)) {
-    return FromDouble(AsDouble(lhs) / AsDouble(rhs));
+StatusOr<Value> operator/(Value lhs, Value rhs) {
+  using K = Value::Kind;
+  if (lhs.kind() == K::kMoney && rhs.kind() == K::kMoney) {
+    RETURN_IF_ERROR_(CheckSameCurrency(lhs, rhs));
+    return AsMoneyValue(MoneyAsDouble(lhs) / MoneyAsDouble(rhs),
+                        lhs.currency());
+  } else if (lhs.IsNumeric() && rhs.IsNumeric()) {
+    return Value::Double(lhs.AsDouble() / rhs.AsDouble());
   }
-
   return Status(INVALID_ARGUMENT, "no division");
 }
 
-StatusOr<Amount> operator^(const Amount &lhs, const Amount &rhs) {
-  Amount resultant;
-  if (IsNumeric(lhs) && IsNumeric(rhs)) {
-    return FromDouble(pow(AsDouble(lhs), AsDouble(rhs)));
+StatusOr<Value> operator^(Value lhs, Value rhs) {
+  if (lhs.IsNumeric() && rhs.IsNumeric()) {
+    return Value::Double(pow(lhs.AsDouble(), rhs.AsDouble()));
   }
   return Status(INVALID_ARGUMENT, "no exponent");
 }
 
-StatusOr<Amount> operator%(const Amount &lhs, const Amount &rhs) {
-  Amount resultant;
-  if (lhs.has_int_amount() && rhs.has_int_amount()) {
-    return FromInt(lhs.int_amount() % rhs.int_amount());
-  } else if (IsNumeric(lhs) && IsNumeric(rhs)) {
-    return FromDouble(fmod(AsDouble(lhs), AsDouble(rhs)));
+StatusOr<Value> operator%(Value lhs, Value rhs) {
+  using K = Value::Kind;
+  if (lhs.kind() == K::kInt && rhs.kind() == K::kInt) {
+    return IntValue(lhs.int_value() % rhs.int_value());
+  } else if (lhs.IsNumeric() && rhs.IsNumeric()) {
+    return Value::Double(fmod(lhs.AsDouble(), rhs.AsDouble()));
   }
   return Status(INVALID_ARGUMENT, "no exponent");
 }
 
-StatusOr<Amount> operator&&(const Amount &lhs, const Amount &rhs) {
-  Amount resultant;
-  if (lhs.has_bool_amount() && rhs.has_bool_amount()) {
-    resultant.set_bool_amount(lhs.bool_amount() && rhs.bool_amount());
-    return resultant;
+StatusOr<Value> operator&&(Value lhs, Value rhs) {
+  using K = Value::Kind;
+  if (lhs.kind() == K::kBool && rhs.kind() == K::kBool) {
+    return Value::Bool(lhs.bool_value() && rhs.bool_value());
   }
   return Status(INVALID_ARGUMENT, "Can't && non-bools.");
 }
 
-StatusOr<Amount> operator||(const Amount &lhs, const Amount &rhs) {
-  Amount resultant;
-  if (lhs.has_bool_amount() && rhs.has_bool_amount()) {
-    resultant.set_bool_amount(lhs.bool_amount() || rhs.bool_amount());
-    return resultant;
+StatusOr<Value> operator||(Value lhs, Value rhs) {
+  using K = Value::Kind;
+  if (lhs.kind() == K::kBool && rhs.kind() == K::kBool) {
+    return Value::Bool(lhs.bool_value() || rhs.bool_value());
   }
   return Status(INVALID_ARGUMENT, "Can't || non-bools.");
 }
 
-StatusOr<Amount> operator!(const Amount &arg) {
-  Amount resultant;
-  if (arg.has_bool_amount()) {
-    resultant.set_bool_amount(!arg.bool_amount());
-    return resultant;
+StatusOr<Value> operator!(Value arg) {
+  if (arg.kind() == Value::Kind::kBool) {
+    return Value::Bool(!arg.bool_value());
   }
   return Status(INVALID_ARGUMENT, "Can't ! non-bools.");
 }
 
+// AMOUNTS
+
+StatusOr<bool> operator<=(const Amount &lhs, const Amount &rhs) {
+  return Value::From(lhs) <= Value::From(rhs);
+}
+
+StatusOr<bool> operator==(const Amount &lhs, const Amount &rhs) {
+  return Value::From(lhs) == Value::From(rhs);
+}
+
+StatusOr<Amount> operator+(const Amount &lhs, const Amount &rhs) {
+  // For a concatenation, until it's copied out.
+  StringArena arena;
+  return ToAmount(Value::From(lhs) + Value::From(rhs));
+}
+
+StatusOr<Amount> operator-(const Amount &arg) {
+  return ToAmount(-Value::From(arg));
+}
+
+StatusOr<Amount> operator*(const Amount &lhs, const Amount &rhs) {
+  return ToAmount(Value::From(lhs) * Value::From(rhs));
+}
+
+StatusOr<Amount> operator/(const Amount &lhs, const Amount &rhs) {
+  return ToAmount(Value::From(lhs) / Value::From(rhs));
+}
+
+StatusOr<Amount> operator^(const Amount &lhs, const Amount &rhs) {
+  return ToAmount(Value::From(lhs) ^ Value::From(rhs));
+}
+
+StatusOr<Amount> operator%(const Amount &lhs, const Amount &rhs) {
+  return ToAmount(Value::From(lhs) % Value::From(rhs));
+}
+
+StatusOr<Amount> operator&&(const Amount &lhs, const Amount &rhs) {
+  return ToAmount(Value::From(lhs) && Value::From(rhs));
+}
+
+StatusOr<Amount> operator||(const Amount &lhs, const Amount &rhs) {
+  return ToAmount(Value::From(lhs) || Value::From(rhs));
+}
+
+StatusOr<Amount> operator!(const Amount &arg) {
+  return ToAmount(!Value::From(arg));
+}
+
 } // namespace formula
 } // namespace latis
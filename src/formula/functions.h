@@ -19,8 +19,12 @@
 
 #include "proto/latis_msg.pb.h"
 
+#include "src/formula/value.h"
 #include "src/utils/status_macros.h"
+#include "src/xy.h"
 
+#include "absl/strings/str_format.h"
+#include "absl/types/optional.h"
 #include "absl/types/span.h"
 #include "google/protobuf/stubs/status.h"
 #include "google/protobuf/stubs/status_macros.h"
@@ -45,7 +49,22 @@ Money operator-(const Money &arg);
 StatusOr<Money> operator*(const Money &lhs, const Money &rhs);
 StatusOr<Money> operator/(const Money &lhs, const Money &rhs);
 
+// Value (operating on numeric)
+StatusOr<bool> operator<=(Value lhs, Value rhs);
+StatusOr<bool> operator==(Value lhs, Value rhs);
+StatusOr<Value> operator+(Value lhs, Value rhs);
+StatusOr<Value> operator-(Value arg);
+StatusOr<Value> operator*(Value lhs, Value rhs);
+StatusOr<Value> operator/(Value lhs, Value rhs);
+StatusOr<Value> operator^(Value lhs, Value rhs);
+StatusOr<Value> operator%(Value lhs, Value rhs);
+// Value (operating on bool)
+StatusOr<Value> operator&&(Value lhs, Value rhs);
+StatusOr<Value> operator||(Value lhs, Value rhs);
+StatusOr<Value> operator!(Value arg);
+
 // Amount (operating on numeric)
+// These convert to and from Value, and are only for use at the edges.
 StatusOr<bool> operator<=(const Amount &lhs, const Amount &rhs);
 StatusOr<bool> operator==(const Amount &lhs, const Amount &rhs);
 StatusOr<Amount> operator+(const Amount &lhs, const Amount &rhs);
@@ -99,6 +118,40 @@ StatusOr<bool> operator>=(const T &lhs, const T &rhs) {
   return gt || eq;
 }
 
+// Ranges
+
+// Folds the (non-empty) cells of the bounded |range| with |fold|, i.e.
+// SUM(A1:A3) = A1 + A2 + A3. Reads each cell with |lookup|, which returns an
+// absl::optional<Value>, and |fold| is a StatusOr<Value>(Value, Value).
+template <typename Lookup, typename Fold>
+StatusOr<Value> FoldRange(const XYRange &range, const Lookup &lookup,
+                          const Fold &fold) {
+  // Empty cells are skipped.
+  absl::optional<Value> resultant;
+  for (int y = range.Min().Y(); y <= range.Max().Y(); ++y) {
+    for (int x = range.Min().X(); x <= range.Max().X(); ++x) {
+      const absl::optional<Value> value = lookup(XY(x, y));
+      if (!value.has_value()) {
+        continue;
+      }
+      if (!resultant.has_value()) {
+        resultant = value;
+        continue;
+      }
+      Value next;
+      ASSIGN_OR_RETURN_(next, fold(resultant.value(), value.value()));
+      resultant = next;
+    }
+  }
+  if (!resultant.has_value()) {
+    return ::google::protobuf::util::Status(
+        ::google::protobuf::util::error::INVALID_ARGUMENT,
+        absl::StrFormat("Evaluator: no values in range %s:%s",
+                        range.Min().ToA1(), range.Max().ToA1()));
+  }
+  return resultant.value();
+}
+
 // TODO(ambuc): pow, mod
 
 } // namespace formula
@@ -77,6 +77,7 @@ INSTANTIATE_TEST_SUITE_P(
     AllTests, AdditionTestSuite,
     ValuesIn(std::vector<Params>{
         {"int_amount: 1", "int_amount: 2", "int_amount: 3"},
+        {"int_amount: 2147483646", "int_amount: 1", "int_amount: 2147483647"},
         {"int_amount: 1", "double_amount: 2.0", "double_amount: 3.0"},
         {"double_amount: 1.0", "int_amount: 2", "double_amount: 3.0"},
         {"double_amount: 2.1", "int_amount: 3", "double_amount: 5.1"},
@@ -90,6 +91,8 @@ INSTANTIATE_TEST_SUITE_P(
          "money_amount: { currency: USD dollars: 3 cents: 23 }"},
 
         // INVALID
+        // Doesn't fit back into an int_amount.
+        {"int_amount: 2147483647", "int_amount: 1", absl::nullopt},
         {"int_amount : 1", "str_amount: \"a\"", absl::nullopt},
         {"int_amount : 1", "money_amount: {} ", absl::nullopt},
         {"int_amount : 1", "timestamp_amount: {} ", absl::nullopt},
@@ -160,6 +163,8 @@ INSTANTIATE_TEST_SUITE_P(
         {"double_amount: 1.0", "double_amount: -2.0", "double_amount: -2.0"},
 
         // INVALID
+        // Doesn't fit back into an int_amount.
+        {"int_amount: 65536", "int_amount: 65536", absl::nullopt},
         {"int_amount : 1", "str_amount: \"a\"", absl::nullopt},
         {"int_amount : 1", "money_amount: {} ", absl::nullopt},
         {"int_amount : 1", "timestamp_amount: {} ", absl::nullopt},
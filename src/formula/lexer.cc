@@ -14,156 +14,149 @@
 
 #include "src/formula/lexer.h"
 
-#include <deque>
-
 #include "src/utils/status_macros.h"
 
-#include "absl/memory/memory.h"
-#include "absl/strings/numbers.h"
 #include "absl/strings/str_format.h"
 
+#include <array>
+#include <cstdint>
+#include <utility>
+
 namespace latis {
 namespace formula {
 
 using ::google::protobuf::util::Status;
 using ::google::protobuf::util::StatusOr;
 using ::google::protobuf::util::error::INVALID_ARGUMENT;
-using ::google::protobuf::util::error::OK;
 
 namespace {
 
-// Returns a status: "Can't parse FOO as BAR."
-Status CantParseAs(std::string_view *input, std::string_view as) {
-  return Status(
-      INVALID_ARGUMENT,
-      absl::StrFormat("Couldn't parse %s as a token of type %s.", input, as));
-}
-
-// Returns a token with one-or-more characters off |input| matching |lambda| and
-// fits them into a token of type |token_type|. Otherwise errors with |msg|.
-StatusOr<Token> ExtractOneOrMore(Token::T token_type,
-                                 std::function<bool(char)> lambda,
-                                 std::string_view msg,
-                                 std::string_view *input) {
-  int n = 0;
-  for (const char c : *input) {
-    if (!lambda(c)) {
-      break;
-    }
-    n++;
+// What a byte starts.
+enum class Class : uint8_t {
+  kInvalid,
+  kSpace,
+  // A token of its own, of the type in the table.
+  kSingle,
+  // One or more, as one token.
+  kDigit,
+  kAlpha,
+  // "...", as one token without the quotes.
+  kQuote,
+  // \?, as one token of the escaped character.
+  kEscape,
+};
+
+struct Entry {
+  Class cls;
+  Token::T type;
+};
+
+using Table = std::array<Entry, 256>;
+
+constexpr Table MakeTable() {
+  Table table{};
+  for (Entry &entry : table) {
+    entry = {Class::kInvalid, Token::T::literal};
   }
-
-  if (n == 0) {
-    return CantParseAs(input, msg);
+  table[' '] = {Class::kSpace, Token::T::literal};
+  for (int c = '0'; c <= '9'; ++c) {
+    table[c] = {Class::kDigit, Token::T::numeric};
   }
-
-  const auto value = input->substr(0, n);
-  input->remove_prefix(n);
-
-  return Token{.type = token_type, .value = value};
-}
-
-// Returns a token containing the first numeric character off |input|.
-StatusOr<Token> AsNumeric(std::string_view *input) {
-  return ExtractOneOrMore(
-      Token::T::numeric,
-      /*lambda=*/[](char c) -> bool { return isdigit(c); },
-      /*msg=*/"NUMERIC", input);
-}
-
-// Returns a token containing the first alpha character off |input|.
-StatusOr<Token> AsAlpha(std::string_view *input) {
-  return ExtractOneOrMore(
-      Token::T::alpha,
-      /*lambda=*/[](char c) -> bool { return isalpha(c); },
-      /*msg=*/"ALPHA", input);
-}
-
-// Returns a token containing a quoted string.
-StatusOr<Token> AsQuote(std::string_view *input) {
-  if (input->front() != '\"') {
-    return CantParseAs(input, "Quote, first char isn't \".");
+  for (int c = 'a'; c <= 'z'; ++c) {
+    table[c] = {Class::kAlpha, Token::T::alpha};
+    table[c - 'a' + 'A'] = {Class::kAlpha, Token::T::alpha};
   }
-  const auto len = input->find('\"', /*pos=*/1);
-  if (len == std::string_view::npos) {
-    return CantParseAs(input, "Quote, couldn't find second \".");
+  table['"'] = {Class::kQuote, Token::T::quote};
+  table['\\'] = {Class::kEscape, Token::T::literal};
+
+  constexpr std::pair<char, Token::T> kSingles[] = {
+      {'=', Token::T::equals},    {'.', Token::T::period},
+      {',', Token::T::comma},     {'(', Token::T::lparen},
+      {')', Token::T::rparen},    {'+', Token::T::plus},
+      {'-', Token::T::minus},     {'*', Token::T::asterisk},
+      {'/', Token::T::slash},     {'^', Token::T::carat},
+      {'$', Token::T::dollar},    {'%', Token::T::percent},
+      {'\'', Token::T::tick},     {'<', Token::T::lthan},
+      {'>', Token::T::gthan},     {'?', Token::T::question},
+      {':', Token::T::colon},     {'_', Token::T::underscore},
+      {'&', Token::T::ampersand}, {'|', Token::T::pipe},
+      {'!', Token::T::bang},
+  };
+  for (const auto &[c, type] : kSingles) {
+    table[static_cast<unsigned char>(c)] = {Class::kSingle, type};
   }
-  std::string_view value = input->substr(1, len - 1);
-  input->remove_prefix(len + 1);
-  return Token{.type = Token::T::quote, .value = value};
+  return table;
 }
 
-// Pops the head of |input| off as a token.
-StatusOr<Token> AsToken(std::string_view *input) {
-  if (input->empty()) {
-    return Status(INVALID_ARGUMENT, "Is empty!");
-  }
-
-  const std::string_view cand = input->substr(0, 1);
-  const char front = input->front();
-
-  for (const auto [c, token] : std::vector<std::tuple<char, Token::T>>{
-           {'=', Token::T::equals},    {'.', Token::T::period},
-           {',', Token::T::comma},     {'(', Token::T::lparen},
-           {')', Token::T::rparen},    {'+', Token::T::plus},
-           {'-', Token::T::minus},     {'*', Token::T::asterisk},
-           {'/', Token::T::slash},     {'^', Token::T::carat},
-           {'$', Token::T::dollar},    {'%', Token::T::percent},
-           {'\'', Token::T::tick},     {'<', Token::T::lthan},
-           {'>', Token::T::gthan},     {'?', Token::T::question},
-           {':', Token::T::colon},     {'_', Token::T::underscore},
-           {'&', Token::T::ampersand}, {'|', Token::T::pipe},
-           {'!', Token::T::bang},
-       }) {
-    if (front == c) {
-      input->remove_prefix(1);
-      return Token{.type = token, .value = cand};
-    }
-  }
-
-  if (front == '\\') {
-    const std::string_view value = input->substr(1, 2);
-    input->remove_prefix(2);
-    return Token{.type = Token::T::literal, .value = value};
-  }
+// Indexed by byte, so that each token costs one lookup to classify.
+constexpr Table kTable = MakeTable();
 
-  // Finally try matchers which require >1 char to work
-  for (const auto lambda : {
-           AsNumeric,
-           AsAlpha,
-           AsQuote,
-       }) {
-    if (const auto status_or_token = lambda(input); status_or_token.ok()) {
-      return status_or_token.ValueOrDie();
-    }
-  }
+const Entry &EntryFor(char c) {
+  return kTable[static_cast<unsigned char>(c)];
+}
 
-  return Status(INVALID_ARGUMENT, "?");
+// Returns a status: "Can't parse FOO as BAR."
+Status CantParseAs(std::string_view input, std::string_view as) {
+  return Status(
+      INVALID_ARGUMENT,
+      absl::StrFormat("Couldn't parse %s as a token of type %s.", input, as));
 }
 
 } // namespace
 
-StatusOr<std::vector<Token>> Lex(std::string_view s) {
-  std::string_view mutable_s(s);
-  std::vector<Token> tokens;
+Status LexInto(std::string_view s, std::vector<Token> *tokens) {
+  tokens->clear();
 
-  while (true) {
-    // Break if empty.
-    if (mutable_s.empty()) {
-      break;
+  size_t i = 0;
+  while (i < s.size()) {
+    const Entry &entry = EntryFor(s[i]);
+    switch (entry.cls) {
+    case Class::kSpace:
+      i++;
+      continue;
+    case Class::kSingle:
+      tokens->push_back(Token{.type = entry.type, .value = s.substr(i, 1)});
+      i++;
+      continue;
+    case Class::kDigit:
+    case Class::kAlpha: {
+      size_t end = i + 1;
+      while (end < s.size() && EntryFor(s[end]).cls == entry.cls) {
+        end++;
+      }
+      tokens->push_back(
+          Token{.type = entry.type, .value = s.substr(i, end - i)});
+      i = end;
+      continue;
     }
-
-    // Ignore whitespace.
-    if (mutable_s.front() == ' ') {
-      mutable_s.remove_prefix(1);
+    case Class::kQuote: {
+      const size_t end = s.find('"', i + 1);
+      if (end == std::string_view::npos) {
+        return CantParseAs(s.substr(i), "QUOTE");
+      }
+      tokens->push_back(
+          Token{.type = entry.type, .value = s.substr(i + 1, end - i - 1)});
+      i = end + 1;
       continue;
     }
-
-    Token t;
-    ASSIGN_OR_RETURN_(t, AsToken(&mutable_s));
-    tokens.push_back(t);
+    case Class::kEscape:
+      if (i + 1 == s.size()) {
+        return CantParseAs(s.substr(i), "LITERAL");
+      }
+      tokens->push_back(Token{.type = entry.type, .value = s.substr(i + 1, 1)});
+      i += 2;
+      continue;
+    case Class::kInvalid:
+      return CantParseAs(s.substr(i), "ANY");
+    }
   }
 
+  return Status();
+}
+
+StatusOr<std::vector<Token>> Lex(std::string_view s) {
+  std::vector<Token> tokens;
+  RETURN_IF_ERROR_(LexInto(s, &tokens));
   return tokens;
 }
 
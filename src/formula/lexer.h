@@ -26,6 +26,9 @@
 #include "google/protobuf/stubs/status_macros.h"
 #include "google/protobuf/stubs/statusor.h"
 
+#include <string_view>
+#include <vector>
+
 namespace latis {
 namespace formula {
 
@@ -33,6 +36,12 @@ namespace formula {
 // Returns a non-OkStatus if there was an error.
 ::google::protobuf::util::StatusOr<std::vector<Token>> Lex(std::string_view s);
 
+// As above, but into |tokens|, which is cleared first. Reusing one buffer
+// across calls saves allocating a fresh one each time. The tokens point into
+// |s|, so are only good for as long as it is.
+::google::protobuf::util::Status LexInto(std::string_view s,
+                                         std::vector<Token> *tokens);
+
 } // namespace formula
 } // namespace latis
 
@@ -114,6 +114,31 @@ TEST_F(LexerTestClass, EqualsSomethingComplicated) {
           IsTokenRparen())));
 }
 
+TEST_F(LexerTestClass, EscapesOneChar) {
+  EXPECT_THAT(Lex("\\cd"),
+              IsOkAndHolds(ElementsAre(IsTokenEscape("c"), IsTokenAlpha("d"))));
+}
+
+TEST_F(LexerTestClass, Errors) {
+  EXPECT_THAT(Lex("1 # 2"), Not(IsOk()));
+  EXPECT_THAT(Lex("\"FOO"), Not(IsOk()));
+  EXPECT_THAT(Lex("FOO\\"), Not(IsOk()));
+  EXPECT_THAT(Lex("\xe2\x82\xac"), Not(IsOk()));
+  EXPECT_THAT(Lex("\t1"), Not(IsOk()));
+}
+
+TEST_F(LexerTestClass, IntoReusedBuffer) {
+  std::vector<Token> tokens;
+  ASSERT_THAT(LexInto("SUM(A1:A100) + 1", &tokens), IsOk());
+  const Token *const data = tokens.data();
+
+  // Shorter input fits in what's already there.
+  ASSERT_THAT(LexInto("=4.605", &tokens), IsOk());
+  EXPECT_THAT(tokens, ElementsAre(IsTokenEquals(), IsTokenNumeric(4),
+                                  IsTokenPeriod(), IsTokenNumeric(605)));
+  EXPECT_THAT(tokens.data(), Eq(data));
+}
+
 } // namespace
 } // namespace formula
 } // namespace latis
@@ -38,30 +38,6 @@ namespace {
 template <class... Ts> struct overload : Ts... { using Ts::operator()...; };
 template <class... Ts> overload(Ts...)->overload<Ts...>;
 
-// If given a tspan where the -1st token is lparen, will return the index of the
-// matching parenthesis. Will return
-//
-//                    0123456789
-// MatchParentheses("(2),Baz(3)") == 2
-// MatchParentheses("(Foo(1)),Baz(3)") == 7
-StatusOr<TSpan::iterator> MatchParentheses(TSpan *tspan) {
-  if (tspan->empty()) {
-    return Status(INVALID_ARGUMENT, "MatchParentheses failed, empty");
-  }
-  int depth = 1;
-  for (TSpan::iterator it = tspan->begin(); it != tspan->end(); ++it) {
-    if (it->type == Token::T::lparen) {
-      depth++;
-    } else if (it->type == Token::T::rparen) {
-      depth--;
-    }
-    if (depth == 0) {
-      return it;
-    }
-  }
-  return Status(INVALID_ARGUMENT, "MatchParentheses failed, no ')'.");
-}
-
 } // namespace
 
 StatusOr<std::string_view> Parser::ConsumeExact(Token::T type, TSpan *tspan) {
@@ -89,6 +65,10 @@ StatusOr<std::string_view> Parser::ConsumeExact(Token::T type, TSpan *tspan) {
 }
 
 StatusOr<int> Parser::ConsumeInt(TSpan *tspan) {
+  return Memoized(&memo_.ints, &Parser::ParseInt, tspan);
+}
+
+StatusOr<int> Parser::ParseInt(TSpan *tspan) {
   depth_++;
   auto d = MakeCleanup([&] { depth_--; });
   PrintAttempt(tspan, "INT");
@@ -221,10 +201,9 @@ StatusOr<Money::Currency> Parser::ConsumeCurrency(TSpan *tspan) {
   auto d = MakeCleanup([&] { depth_--; });
 
   PrintAttempt(tspan, "CURRENCY");
-  return Any<Money::Currency>({
+  return Any<Money::Currency>(
       absl::bind_front(&Parser::ConsumeCurrencySymbol, this),
-      absl::bind_front(&Parser::ConsumeCurrencyWord, this),
-  })(tspan);
+      absl::bind_front(&Parser::ConsumeCurrencyWord, this))(tspan);
 }
 
 // Expects "USD" or "CAD".
@@ -327,8 +306,8 @@ StatusOr<absl::TimeZone> Parser::ConsumeTimeOffset(TSpan *tspan) {
       (InSequence<std::string_view, int, std::string_view, int>(
           // + / -
           Any<std::string_view>(
-              {absl::bind_front(&Parser::ConsumeExact, this, Token::T::plus),
-               absl::bind_front(&Parser::ConsumeExact, this, Token::T::minus)}),
+              absl::bind_front(&Parser::ConsumeExact, this, Token::T::plus),
+              absl::bind_front(&Parser::ConsumeExact, this, Token::T::minus)),
           // TIME_HOUR
           absl::bind_front(&Parser::ConsumeTimeHour, this),
           // :
@@ -467,6 +446,10 @@ StatusOr<int> Parser::ConsumeRowIndicator(TSpan *tspan) {
 }
 
 StatusOr<int> Parser::ConsumeColIndicator(TSpan *tspan) {
+  return Memoized(&memo_.col_indicators, &Parser::ParseColIndicator, tspan);
+}
+
+StatusOr<int> Parser::ParseColIndicator(TSpan *tspan) {
   depth_++;
   auto d = MakeCleanup([&] { depth_--; });
   PrintAttempt(tspan, "COL_INDICATOR");
@@ -495,6 +478,10 @@ StatusOr<int> Parser::ConsumeColIndicator(TSpan *tspan) {
 }
 
 StatusOr<PointLocation> Parser::ConsumePointLocation(TSpan *tspan) {
+  return Memoized(&memo_.point_locations, &Parser::ParsePointLocation, tspan);
+}
+
+StatusOr<PointLocation> Parser::ParsePointLocation(TSpan *tspan) {
   depth_++;
   auto d = MakeCleanup([&] { depth_--; });
   PrintAttempt(tspan, "POINT_LOCATION");
@@ -522,11 +509,10 @@ StatusOr<RangeLocation> Parser::ConsumeRangeLocation(TSpan *tspan) {
   auto d = MakeCleanup([&] { depth_--; });
 
   PrintAttempt(tspan, "RANGE_LOCATION");
-  return Any<RangeLocation>({
+  return Any<RangeLocation>(
       absl::bind_front(&Parser::ConsumeRangeLocationPointThenAny, this),
       absl::bind_front(&Parser::ConsumeRangeLocationRowThenRow, this),
-      absl::bind_front(&Parser::ConsumeRangeLocationColThenCol, this),
-  })(tspan);
+      absl::bind_front(&Parser::ConsumeRangeLocationColThenCol, this))(tspan);
 }
 
 StatusOr<RangeLocation> Parser::ConsumeRangeLocationPointThenAny(TSpan *tspan) {
@@ -727,31 +713,6 @@ StatusOr<std::string> Parser::ConsumeFnName(TSpan *tspan) {
   return resultant;
 }
 
-StatusOr<Expression::Operation> Parser::ConsumeOperationPrefix(TSpan *tspan) {
-  depth_++;
-  auto d = MakeCleanup([&] { depth_--; });
-  PrintAttempt(tspan, "OPERATION_PREFIX");
-  TSpan lcl = *tspan;
-
-  std::tuple<std::string, std::vector<Expression>> t;
-  ASSIGN_OR_RETURN_(
-      t, (InSequence<std::string, std::vector<Expression>>(
-             // FN
-             absl::bind_front(&Parser::ConsumeFnName, this),
-             // PARENS
-             absl::bind_front(&Parser::ConsumeParentheses, this))(&lcl)));
-
-  Expression::Operation resultant;
-  resultant.set_fn_name(std::get<0>(t));
-  for (const Expression &expr : std::get<1>(t)) {
-    *resultant.add_terms() = expr;
-  }
-
-  PrintStep(&lcl, tspan, "OPERATION_PREFIX");
-  *tspan = lcl;
-  return resultant;
-}
-
 StatusOr<std::string_view> Parser::ConsumeOpBinaryInfixFn(TSpan *tspan) {
   depth_++;
   auto d = MakeCleanup([&] { depth_--; });
@@ -822,128 +783,181 @@ StatusOr<std::string_view> Parser::ConsumeOpBinaryInfixFn(TSpan *tspan) {
   return resultant;
 }
 
-StatusOr<Expression::Operation> Parser::ConsumeOperationInfix(TSpan *tspan) {
-  // Mark this point as tried. When this method ends, pop this key off the
-  // stack.
-  Cache::key_type key;
-  ASSIGN_OR_RETURN_(key, RepeatGuard("consume_op_binary_infix", tspan));
-  auto d2 = MakeCleanup([&] { cache_.erase(key); });
-
+StatusOr<Expression::Operation> Parser::ConsumeOperationPrefix(TSpan *tspan) {
   depth_++;
   auto d = MakeCleanup([&] { depth_--; });
-  PrintAttempt(tspan, "OP_BINARY_INFIX");
+  PrintAttempt(tspan, "OPERATION_PREFIX");
   TSpan lcl = *tspan;
 
-  std::tuple<Expression, std::string, Expression> t;
-  ASSIGN_OR_RETURN_(
-      t, (InSequence<Expression, std::string, Expression>(
-             // EXPR
-             absl::bind_front(&Parser::ConsumeExpression, this),
-             // + - etc
-             absl::bind_front(&Parser::ConsumeOpBinaryInfixFn, this),
-             // EXPR
-             absl::bind_front(&Parser::ConsumeExpression, this))(&lcl)));
-
   Expression::Operation resultant;
-  *resultant.add_terms() = std::get<0>(t);
-  resultant.set_fn_name(std::get<1>(t));
-  *resultant.add_terms() = std::get<2>(t);
+  RETURN_IF_ERROR_(ConsumeOperationPrefixInto(&lcl, &resultant));
 
-  PrintStep(&lcl, tspan, "OP_BINARY_INFIX");
+  PrintStep(&lcl, tspan, "OPERATION_PREFIX");
   *tspan = lcl;
   return resultant;
 }
 
-StatusOr<Expression::Operation> Parser::ConsumeOperation(TSpan *tspan) {
+StatusOr<std::vector<Expression>> Parser::ConsumeParentheses(TSpan *tspan) {
   depth_++;
   auto d = MakeCleanup([&] { depth_--; });
-  PrintAttempt(tspan, "OPERATION");
-  return Any<Expression::Operation>({
-      absl::bind_front(&Parser::ConsumeOperationInfix, this),
-      absl::bind_front(&Parser::ConsumeOperationPrefix, this),
-  })(tspan);
+  PrintAttempt(tspan, "PARENTHESES");
+  TSpan lcl = *tspan;
+
+  google::protobuf::RepeatedPtrField<Expression> exprs;
+  RETURN_IF_ERROR_(ConsumeParenthesesInto(&lcl, &exprs));
+
+  PrintStep(&lcl, tspan, "PARENTHESES");
+  *tspan = lcl;
+  return std::vector<Expression>(exprs.begin(), exprs.end());
 }
 
-StatusOr<std::vector<Expression>> Parser::ConsumeParentheses(TSpan *tspan) {
+StatusOr<Expression> Parser::ConsumeExpression(TSpan *tspan) {
   depth_++;
   auto d = MakeCleanup([&] { depth_--; });
-  PrintAttempt(tspan, "PARENTHESES");
-
+  PrintAttempt(tspan, "EXPRESSION");
   TSpan lcl = *tspan;
 
-  // check lcl[0] == '('
-  if (!ConsumeExact(Token::T::lparen, &lcl).ok()) {
-    return Status(INVALID_ARGUMENT, "Not a PARENTHESES, 1st char is not '('.");
-  }
+  StartMemo(&lcl);
+  auto m = MakeCleanup([&] { EndMemo(); });
+
+  Expression resultant;
+  RETURN_IF_ERROR_(ConsumeExpressionInto(&lcl, &resultant));
+
+  PrintStep(&lcl, tspan, "EXPRESSION");
+  *tspan = lcl;
+  return resultant;
+}
+
+void Parser::StartMemo(TSpan *tspan) {
+  memo_.begin = tspan->data();
+  // One past the end too, so that a rule may start on an empty span.
+  memo_.ints.resize(tspan->size() + 1);
+  memo_.col_indicators.resize(tspan->size() + 1);
+  memo_.point_locations.resize(tspan->size() + 1);
+}
 
-  TSpan::iterator rparen;
-  ASSIGN_OR_RETURN_(rparen, MatchParentheses(&lcl));
+void Parser::EndMemo() {
+  memo_.begin = nullptr;
+  // Keeps the capacity, which is bounded by the longest parse so far, so that
+  // the next parse of a similar length doesn't allocate.
+  memo_.ints.clear();
+  memo_.col_indicators.clear();
+  memo_.point_locations.clear();
+}
 
-  auto size_of_inner = std::distance(lcl.begin(), rparen);
-  TSpan lcl_inner(lcl.data(), size_of_inner);
+Status Parser::ConsumeOperationPrefixInto(TSpan *tspan,
+                                          Expression::Operation *output) {
+  std::string fn_name;
+  ASSIGN_OR_RETURN_(fn_name, ConsumeFnName(tspan));
+  RETURN_IF_ERROR_(ConsumeParenthesesInto(tspan, output->mutable_terms()));
+  output->set_fn_name(fn_name);
+  return Status();
+}
 
-  std::vector<Expression> resultant{};
+Status Parser::ConsumeParenthesesInto(
+    TSpan *tspan, google::protobuf::RepeatedPtrField<Expression> *output) {
+  if (!ConsumeExact(Token::T::lparen, tspan).ok()) {
+    return Status(INVALID_ARGUMENT, "Not a PARENTHESES, 1st char is not '('.");
+  }
+  while (true) {
+    RETURN_IF_ERROR_(ConsumeExpressionInto(tspan, output->Add()));
+    if (ConsumeExact(Token::T::comma, tspan).ok()) {
+      continue;
+    }
+    if (ConsumeExact(Token::T::rparen, tspan).ok()) {
+      return Status();
+    }
+    return Status(INVALID_ARGUMENT,
+                  "Not a PARENTHESES, expected ',' or ')' after a term.");
+  }
+}
 
-  // Pop Expressions off the inner stack.
+Status Parser::ConsumeExpressionInto(TSpan *tspan, Expression *output) {
+  // Every infix operator binds as tightly as every other, and to the right, so
+  // 3+2+1 is 3+(2+1). Rather than recursing for each right hand side, take
+  // the operands and operators in one pass, then fold them up from the right.
+  std::vector<Expression> operands(1);
+  std::vector<std::string_view> fn_names;
+  RETURN_IF_ERROR_(ConsumePrimaryInto(tspan, &operands.back()));
   while (true) {
-    Expression expr;
-    ASSIGN_OR_RETURN_(expr, ConsumeExpression(&lcl_inner));
-    resultant.push_back(expr);
-    if (!ConsumeExact(Token::T::comma, &lcl_inner).ok()) {
+    TSpan lcl = *tspan;
+    const auto fn_name = ConsumeOpBinaryInfixFn(&lcl);
+    if (!fn_name.ok()) {
+      break;
+    }
+    Expression operand;
+    // NB: An operator without an operand after it is left for the caller.
+    if (!ConsumePrimaryInto(&lcl, &operand).ok()) {
       break;
     }
+    fn_names.push_back(fn_name.ValueOrDie());
+    operands.push_back(std::move(operand));
+    *tspan = lcl;
   }
-  lcl.remove_prefix(size_of_inner + 1);
 
-  PrintStep(&lcl, tspan, "PARENTHESES");
-  *tspan = lcl;
-  return resultant;
+  *output = std::move(operands.back());
+  for (size_t i = fn_names.size(); i-- > 0;) {
+    Expression lhs = std::move(operands[i]);
+    Expression rhs = std::move(*output);
+    output->Clear();
+    Expression::Operation *operation = output->mutable_operation();
+    operation->set_fn_name(std::string(fn_names[i]));
+    *operation->add_terms() = std::move(lhs);
+    *operation->add_terms() = std::move(rhs);
+  }
+  return Status();
 }
 
-StatusOr<Expression> Parser::ConsumeExpression(TSpan *tspan) {
+Status Parser::ConsumePrimaryInto(TSpan *tspan, Expression *output) {
   depth_++;
   auto d = MakeCleanup([&] { depth_--; });
-  PrintAttempt(tspan, "EXPRESSION");
-
-  TSpan lcl = *tspan;
-  Expression resultant;
+  PrintAttempt(tspan, "PRIMARY");
 
-  absl::variant<Expression::Operation, std::vector<Expression>, RangeLocation,
-                PointLocation, Amount>
-      expression;
+  if (tspan->empty()) {
+    return Status(INVALID_ARGUMENT, "Can't ConsumePrimary: empty.");
+  }
 
-  ASSIGN_OR_RETURN_(
-      expression,
-      (AnyVariant<Expression::Operation, std::vector<Expression>, RangeLocation,
-                  PointLocation, Amount>(
-          absl::bind_front(&Parser::ConsumeOperation, this),
-          WithRestriction<std::vector<Expression>>(
-              [](const std::vector<Expression> exprs) -> bool {
-                return exprs.size() == 1;
-              })(absl::bind_front(&Parser::ConsumeParentheses, this)),
-          absl::bind_front(&Parser::ConsumeRangeLocation, this),
-          absl::bind_front(&Parser::ConsumePointLocation, this),
-          absl::bind_front(&Parser::ConsumeAmount, this))(&lcl)));
+  // Only try what can begin with the first token, in the same order as ever,
+  // so that each is only ever parsed once.
+  const Token::T type = tspan->front().type;
+  if (type == Token::T::lparen) {
+    TSpan lcl = *tspan;
+    google::protobuf::RepeatedPtrField<Expression> exprs;
+    RETURN_IF_ERROR_(ConsumeParenthesesInto(&lcl, &exprs));
+    if (exprs.size() != 1) {
+      return Status(INVALID_ARGUMENT,
+                    "Can't ConsumePrimary: (...) must hold one expression.");
+    }
+    *output = std::move(*exprs.Mutable(0));
+    PrintStep(&lcl, tspan, "PRIMARY");
+    *tspan = lcl;
+    return Status();
+  }
+  if (type == Token::T::alpha) {
+    TSpan lcl = *tspan;
+    if (ConsumeOperationPrefixInto(&lcl, output->mutable_operation()).ok()) {
+      PrintStep(&lcl, tspan, "PRIMARY");
+      *tspan = lcl;
+      return Status();
+    }
+    output->Clear();
+  }
 
-  std::visit(
-      overload{
-          [&resultant](std::vector<Expression> exprs) {
-            // For (AMOUNT).
-            assert(exprs.size() == 1);
-            resultant = exprs[0];
-          },
-          [&resultant](Expression::Operation o) {
-            *resultant.mutable_operation() = o;
-          },
-          [&resultant](RangeLocation rl) { *resultant.mutable_range() = rl; },
-          [&resultant](PointLocation pl) { *resultant.mutable_lookup() = pl; },
-          [&resultant](Amount value) { *resultant.mutable_value() = value; },
-      },
-      expression);
+  TSpan lcl = *tspan;
+  if (const auto range = ConsumeRangeLocation(&lcl); range.ok()) {
+    *output->mutable_range() = range.ValueOrDie();
+  } else if (const auto point = ConsumePointLocation(&lcl); point.ok()) {
+    *output->mutable_lookup() = point.ValueOrDie();
+  } else if (const auto amount = ConsumeAmount(&lcl); amount.ok()) {
+    *output->mutable_value() = amount.ValueOrDie();
+  } else {
+    return Status(INVALID_ARGUMENT, "Can't ConsumePrimary: not an operation, "
+                                    "(expression), location or amount.");
+  }
 
-  PrintStep(&lcl, tspan, "EXPRESSION");
+  PrintStep(&lcl, tspan, "PRIMARY");
   *tspan = lcl;
-  return resultant;
+  return Status();
 }
 
 } // namespace formula
@@ -24,7 +24,6 @@
 #include "src/utils/cleanup.h"
 #include "src/utils/status_macros.h"
 
-#include "absl/container/flat_hash_set.h"
 #include "absl/functional/bind_front.h"
 #include "absl/strings/numbers.h"
 #include "absl/strings/str_format.h"
@@ -98,6 +97,54 @@ private:
 
   int depth_{0};
 
+  // Packrat memo. The rules below are tried more than once from the same token
+  // -- A1 is a PointLocation on the way to not being a RangeLocation, and
+  // then again on its own -- so within a call to ConsumeExpression() their
+  // results are kept by where they started. Each table holds one slot per
+  // token, and is emptied once that call returns.
+  template <typename T> struct MemoEntry {
+    ::google::protobuf::util::StatusOr<T> result;
+    // The offset of the first token not consumed.
+    size_t end;
+  };
+  template <typename T>
+  using MemoTable = std::vector<absl::optional<MemoEntry<T>>>;
+  struct Memo {
+    // The first token of the parse in progress, or nullptr if there is none.
+    TSpan::pointer begin{nullptr};
+    MemoTable<int> ints;
+    MemoTable<int> col_indicators;
+    MemoTable<PointLocation> point_locations;
+  };
+  Memo memo_;
+
+  void StartMemo(TSpan *tspan);
+  void EndMemo();
+
+  // Runs |rule| on |tspan|, or if a memo is in progress and |rule| has already
+  // run from the front of |tspan|, replays its result from |table|.
+  template <typename T>
+  ::google::protobuf::util::StatusOr<T>
+  Memoized(MemoTable<T> *table,
+           ::google::protobuf::util::StatusOr<T> (Parser::*rule)(TSpan *),
+           TSpan *tspan) {
+    if (memo_.begin == nullptr) {
+      return (this->*rule)(tspan);
+    }
+    const size_t begin = tspan->data() - memo_.begin;
+    // NB: The tables are never resized mid-parse, so |entry| stays put while
+    // |rule| fills in the tables for other offsets.
+    absl::optional<MemoEntry<T>> &entry = (*table)[begin];
+    if (!entry.has_value()) {
+      TSpan lcl = *tspan;
+      auto result = (this->*rule)(&lcl);
+      const size_t end = lcl.data() - memo_.begin;
+      entry.emplace(MemoEntry<T>{std::move(result), end});
+    }
+    tspan->remove_prefix(entry->end - begin);
+    return entry->result;
+  }
+
   // Logging w/ depth_
   void PrintAttempt(TSpan *tspan, const std::string &step) {
     if (options_.should_log_verbosely) {
@@ -117,28 +164,15 @@ private:
     }
   }
 
-  // RepeatGuard apparatus
-  using CacheItem = std::tuple<std::string, TSpan::pointer>;
-  using Cache = absl::flat_hash_set<CacheItem>;
-  Cache cache_;
-
-  // NB: RepeatGuards are only necessary for right-recursive expressions... I
-  // think.
-  ::google::protobuf::util::StatusOr<Cache::key_type>
-  RepeatGuard(std::string step, TSpan *tspan) {
-    CacheItem item = {step, tspan->data()};
-
-    if (cache_.contains(item)) {
-      return ::google::protobuf::util::Status(
-          ::google::protobuf::util::error::INVALID_ARGUMENT,
-          "RepeatGuard denied! Already been here");
-    }
-    cache_.insert(item);
-    return item;
-  }
-
   // Private consumers.
 
+  // The unmemoized workings of ConsumeInt(), ConsumeColIndicator() and
+  // ConsumePointLocation().
+  ::google::protobuf::util::StatusOr<int> ParseInt(TSpan *tspan);
+  ::google::protobuf::util::StatusOr<int> ParseColIndicator(TSpan *tspan);
+  ::google::protobuf::util::StatusOr<PointLocation>
+  ParsePointLocation(TSpan *tspan);
+
   ::google::protobuf::util::StatusOr<std::string_view>
   ConsumeExact(Token::T type, TSpan *tspan);
 
@@ -170,12 +204,21 @@ private:
   ::google::protobuf::util::StatusOr<std::string_view>
   ConsumeOpBinaryInfixFn(TSpan *tspan);
   ::google::protobuf::util::StatusOr<Expression::Operation>
-  ConsumeOperationInfix(TSpan *tspan);
-  ::google::protobuf::util::StatusOr<Expression::Operation>
   ConsumeOperationPrefix(TSpan *tspan);
 
-  ::google::protobuf::util::StatusOr<Expression::Operation>
-  ConsumeOperation(TSpan *tspan);
+  // The workings of ConsumeOperationPrefix(), ConsumeParentheses() and
+  // ConsumeExpression(), which build straight into |output| rather than
+  // returning copies. On failure, |tspan| and |output| are left part way.
+  ::google::protobuf::util::Status
+  ConsumeOperationPrefixInto(TSpan *tspan, Expression::Operation *output);
+  ::google::protobuf::util::Status ConsumeParenthesesInto(
+      TSpan *tspan, google::protobuf::RepeatedPtrField<Expression> *output);
+  ::google::protobuf::util::Status ConsumeExpressionInto(TSpan *tspan,
+                                                         Expression *output);
+  // Anything but an infix operation, i.e. anything which can be an operand of
+  // one: a prefix operation, (EXPRESSION), a location or an amount.
+  ::google::protobuf::util::Status ConsumePrimaryInto(TSpan *tspan,
+                                                      Expression *output);
 };
 
 } // namespace formula
@@ -22,10 +22,19 @@
 
 #include "absl/types/optional.h"
 #include "absl/types/variant.h"
+#include "absl/utility/utility.h"
 
 namespace latis {
 namespace formula {
 
+// A parser is anything which can be called as
+//     ::google::protobuf::util::StatusOr<T>(TSpan *)
+// -- a Prsr<T>, but just as well a lambda or an absl::bind_front() of a Parser
+// method. The combinators below keep each parser as its own type and return a
+// lambda, rather than a std::function, so that a grammar rule built from them
+// is one concrete type which the compiler can see through and inline. Nothing
+// is allocated or type-erased along the way. Parsers are taken by value.
+
 // Parser combinator |AnyVariant|.
 //
 // Useful for combining n parsers, all of whom have different return types.
@@ -36,26 +45,38 @@ namespace formula {
 // Types:
 //     AnyVariant :: [Prsr<A>, Prsr<B>, ...]
 //                -> Prsr<variant<A, B, ...>>
-template <typename... O> //
-static std::function<
-    ::google::protobuf::util::StatusOr<absl::variant<O...>>(TSpan *)>
-AnyVariant(
-    std::function<::google::protobuf::util::StatusOr<O>(TSpan *)>... ls) {
-  return [&](TSpan *
-             tspan) -> ::google::protobuf::util::StatusOr<absl::variant<O...>> {
-    std::vector<std::function<
-        ::google::protobuf::util::StatusOr<absl::variant<O...>>(TSpan *)>>
-        fns{ls...};
-    for (const auto fn : fns) {
-      TSpan lcl = *tspan;
-      if (const auto v = fn(&lcl); v.ok()) {
-        *tspan = lcl;
-        return v.ValueOrDie();
-      }
+template <typename... O, typename... Ps, std::size_t... I> //
+static ::google::protobuf::util::StatusOr<absl::variant<O...>>
+AnyVariant_impl(TSpan *tspan, const std::tuple<Ps...> &ps,
+                std::index_sequence<I...>) {
+  absl::optional<absl::variant<O...>> resultant;
+
+  // Tries each parser in turn, and stops at the first match.
+  (... || [tspan, &ps, &resultant] {
+    TSpan lcl = *tspan;
+    const auto v = std::get<I>(ps)(&lcl);
+    if (!v.ok()) {
+      return false;
     }
+    *tspan = lcl;
+    resultant.emplace(absl::in_place_index_t<I>(), v.ValueOrDie());
+    return true;
+  }());
+
+  if (!resultant.has_value()) {
     return ::google::protobuf::util::Status(
         ::google::protobuf::util::error::INVALID_ARGUMENT,
         "no match in AnyVariant<>().");
+  }
+  return *std::move(resultant);
+}
+
+template <typename... O, typename... Ps> //
+static auto AnyVariant(Ps... ps) {
+  static_assert(sizeof...(O) == sizeof...(Ps),
+                "AnyVariant<>() needs one parser per alternative.");
+  return [ps = std::make_tuple(std::move(ps)...)](TSpan *tspan) {
+    return AnyVariant_impl<O...>(tspan, ps, std::index_sequence_for<Ps...>{});
   };
 }
 
@@ -69,19 +90,30 @@ AnyVariant(
 // Types:
 //     Any :: [Prsr<T>]
 //         -> Prsr<T>
-template <typename T> //
-static Prsr<T> Any(const std::vector<Prsr<T>> fns) {
-  return [&](TSpan *tspan) -> ::google::protobuf::util::StatusOr<T> {
-    for (const auto fn : fns) {
+template <typename T, typename... Ps> //
+static auto Any(Ps... ps) {
+  return [ps...](TSpan *tspan) -> ::google::protobuf::util::StatusOr<T> {
+    absl::optional<T> resultant;
+
+    // Tries each parser in turn, and stops at the first match.
+    const auto attempt = [tspan, &resultant](const auto &fn) {
       TSpan lcl = *tspan;
-      if (const auto v = fn(&lcl); v.ok()) {
-        *tspan = lcl;
-        return v.ValueOrDie();
+      const auto v = fn(&lcl);
+      if (!v.ok()) {
+        return false;
       }
+      *tspan = lcl;
+      resultant.emplace(v.ValueOrDie());
+      return true;
+    };
+    (... || attempt(ps));
+
+    if (!resultant.has_value()) {
+      return ::google::protobuf::util::Status(
+          ::google::protobuf::util::error::INVALID_ARGUMENT,
+          "no match in Any<>()");
     }
-    return ::google::protobuf::util::Status(
-        ::google::protobuf::util::error::INVALID_ARGUMENT,
-        "no match in Any<>()");
+    return *std::move(resultant);
   };
 }
 
@@ -93,9 +125,9 @@ static Prsr<T> Any(const std::vector<Prsr<T>> fns) {
 // Types:
 //     Maybe :: (TSpan* -> StatusOr<T>)
 //           -> (TSpan* -> optional<T>)
-template <typename T> //
-static std::function<absl::optional<T>(TSpan *)> Maybe(const Prsr<T> &fn) {
-  return [&](TSpan *tspan) -> absl::optional<T> {
+template <typename T, typename P> //
+static auto Maybe(P fn) {
+  return [fn](TSpan *tspan) -> absl::optional<T> {
     TSpan lcl = *tspan;
 
     if (const auto v = fn(&lcl); v.ok()) {
@@ -114,14 +146,13 @@ static std::function<absl::optional<T>(TSpan *)> Maybe(const Prsr<T> &fn) {
 //     WithRestriction<int>(r)(ConsumeInt)(tspan);
 //
 // Types:
-//     WithRestriction :: std::function<bool(T)>
+//     WithRestriction :: (T -> bool)
 //                     -> Prsr<T>
 //                     -> Prsr<T>
-template <typename T> //
-static std::function<Prsr<T>(const Prsr<T> &)>
-WithRestriction(std::function<bool(T)> r) {
-  return [&r](const Prsr<T> &p) -> Prsr<T> {
-    return [&r, &p](TSpan *tspan) -> ::google::protobuf::util::StatusOr<T> {
+template <typename T, typename R> //
+static auto WithRestriction(R r) {
+  return [r](auto p) {
+    return [r, p](TSpan *tspan) -> ::google::protobuf::util::StatusOr<T> {
       TSpan lcl = *tspan;
       if (const auto v = p(&lcl); !v.ok()) {
         return v.status();
@@ -141,17 +172,19 @@ WithRestriction(std::function<bool(T)> r) {
 // Parser combinator |InSequence|.
 //
 // Usage:
-//    InSequence<std::tuple<A, B, C>>(ConsumeA, ConsumeB, ConsumeC)(tspan);
+//    InSequence<A, B, C>(ConsumeA, ConsumeB, ConsumeC)(tspan);
 //
 // Types:
 //    InSequence :: Prsr<A>
 //               -> Prsr<B>
 //               -> Prsr<C>
 //               -> (TSpan* -> StatusOr<std::tuple<A, B, C>>)
+//
+// A parser may also return a bare T, e.g. a Maybe<>() returning an optional.
 
-template <typename... Ts, std::size_t... I> //
+template <typename... Ts, typename... Ps, std::size_t... I> //
 static ::google::protobuf::util::StatusOr<std::tuple<Ts...>>
-InSequence_impl(TSpan *tspan, std::tuple<const Prsr<Ts> &...> fns_tuple,
+InSequence_impl(TSpan *tspan, const std::tuple<Ps...> &ps,
                 std::index_sequence<I...>) {
   TSpan lcl = *tspan;
   std::tuple<Ts...> resultant;
@@ -159,21 +192,18 @@ InSequence_impl(TSpan *tspan, std::tuple<const Prsr<Ts> &...> fns_tuple,
   auto loop_status =
       ::google::protobuf::util::Status(::google::protobuf::util::error::OK, "");
 
-  std::apply(
-      [&loop_status, &resultant, &lcl](Prsr<Ts> const &... fn) {
-        (
-            [&loop_status, &resultant, &lcl, &fn] {
-              if (loop_status.ok()) {
-                if (const auto maybe_value = fn(&lcl); maybe_value.ok()) {
-                  std::get<I>(resultant) = maybe_value.ValueOrDie();
-                } else {
-                  loop_status = maybe_value.status();
-                }
-              }
-            }(),
-            ...);
-      },
-      fns_tuple);
+  // Runs each parser in turn, and stops at the first failure.
+  (... && [&ps, &loop_status, &resultant, &lcl] {
+    using T = std::tuple_element_t<I, std::tuple<Ts...>>;
+    const ::google::protobuf::util::StatusOr<T> maybe_value =
+        std::get<I>(ps)(&lcl);
+    if (!maybe_value.ok()) {
+      loop_status = maybe_value.status();
+      return false;
+    }
+    std::get<I>(resultant) = maybe_value.ValueOrDie();
+    return true;
+  }());
 
   RETURN_IF_ERROR_(loop_status);
 
@@ -181,42 +211,31 @@ InSequence_impl(TSpan *tspan, std::tuple<const Prsr<Ts> &...> fns_tuple,
   return resultant;
 }
 
-template <typename... Ts> //
-static std::function<
-    ::google::protobuf::util::StatusOr<std::tuple<Ts...>>(TSpan *)>
-InSequence(const Prsr<Ts> &... fns) {
-  return [&](TSpan *
-             tspan) -> ::google::protobuf::util::StatusOr<std::tuple<Ts...>> {
-
-    TSpan lcl = *tspan;
-
-    std::tuple<Ts...> resultant;
-    ASSIGN_OR_RETURN_(resultant,
-                      InSequence_impl(&lcl, std::forward_as_tuple(fns...),
-                                      std::index_sequence_for<Ts...>{}));
-
-    *tspan = lcl;
-    return resultant;
+template <typename... Ts, typename... Ps> //
+static auto InSequence(Ps... ps) {
+  static_assert(sizeof...(Ts) == sizeof...(Ps),
+                "InSequence<>() needs one parser per element.");
+  return [ps = std::make_tuple(std::move(ps)...)](TSpan *tspan) {
+    return InSequence_impl<Ts...>(tspan, ps, std::index_sequence_for<Ps...>{});
   };
 }
 
 // Parser combinator |WithTransformation|
 //
 // Usage: (A -> B)
-//     std::function<bool(int)> tr = [](int i) -> bool { return i == 0; };
+//     auto tr = [](int i) -> bool { return i == 0; };
 //     WithTransformation<A, B>(tr)(ConsumeInt)(tspan);
 //
 // Types:
 //   WithTransformation :: (A -> B)
 //                      -> Prsr<A>
 //                      -> Prsr<B>
-template <typename A, typename B> //
-static std::function<Prsr<B>(const Prsr<A> &)>
-WithTransformation(std::function<B(A)> t) {
-  return [&t](const Prsr<A> &p) -> Prsr<B> {
-    return [&t, &p](TSpan *tspan) -> ::google::protobuf::util::StatusOr<B> {
+template <typename A, typename B, typename F> //
+static auto WithTransformation(F t) {
+  return [t](auto p) {
+    return [t, p](TSpan *tspan) -> ::google::protobuf::util::StatusOr<B> {
       TSpan lcl = *tspan;
-      const auto v = p(&lcl);
+      const ::google::protobuf::util::StatusOr<A> v = p(&lcl);
       if (!v.ok()) {
         return v.status();
       }
@@ -230,17 +249,16 @@ WithTransformation(std::function<B(A)> t) {
 //
 // Usage:
 //     absl::flat_hash_map<K, V> key_to_val = {{"A", "a"}, {"B", "b"}};
-//     WithLookup<K, V>(key_to_val)(ConsumeString)(tspan);
+//     WithLookup(key_to_val)(ConsumeString)(tspan);
 //     // If the output of the inner parser is in the map, returns the match.
 //     // Otherwise returns a status explaining.
 //     // If the output of the inner parser is a Status, returns that.
+//
+// NB: Holds onto |map| by reference, so it must outlive the parser.
 template <typename M> //
-static std::function<
-    Prsr<typename M::mapped_type>(const Prsr<typename M::key_type> &)>
-WithLookup(const M &map) {
-  return [&map](const Prsr<typename M::key_type> &p)
-             -> Prsr<typename M::mapped_type> {
-    return [&map, &p ](TSpan * tspan)
+static auto WithLookup(const M &map) {
+  return [&map](auto p) {
+    return [&map, p](TSpan *tspan)
                -> ::google::protobuf::util::StatusOr<typename M::mapped_type> {
       TSpan lcl = *tspan;
 
@@ -250,9 +268,7 @@ WithLookup(const M &map) {
         return maybe_key.status();
       }
 
-      typename M::key_type key = maybe_key.ValueOrDie();
-
-      const typename M::const_iterator it = map.find(key);
+      const typename M::const_iterator it = map.find(maybe_key.ValueOrDie());
       if (it == map.end()) {
         return ::google::protobuf::util::Status(
             ::google::protobuf::util::error::INVALID_ARGUMENT,
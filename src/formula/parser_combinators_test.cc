@@ -85,7 +85,7 @@ TEST(Any, AB_SucceedsOnA) {
 
   TSpan tspan;
   EXPECT_THAT(
-      (Any<int>({MockA.AsStdFunction(), MockB.AsStdFunction()})(&tspan)),
+      (Any<int>(MockA.AsStdFunction(), MockB.AsStdFunction())(&tspan)),
       IsOkAndHolds(1));
 }
 
@@ -99,7 +99,7 @@ TEST(Any, AB_SucceedsOnB) {
 
   TSpan tspan;
   EXPECT_THAT(
-      (Any<int>({MockA.AsStdFunction(), MockB.AsStdFunction()})(&tspan)),
+      (Any<int>(MockA.AsStdFunction(), MockB.AsStdFunction())(&tspan)),
       IsOkAndHolds(1));
 }
 
@@ -115,7 +115,7 @@ TEST(Any, AB_Fails) {
 
   TSpan tspan;
   EXPECT_THAT(
-      (Any<int>({MockA.AsStdFunction(), MockB.AsStdFunction()})(&tspan)),
+      (Any<int>(MockA.AsStdFunction(), MockB.AsStdFunction())(&tspan)),
       Not(IsOk()));
 }
 
@@ -281,6 +281,36 @@ TEST(WithLookup, AToB_NotFound) {
               Not(IsOk()));
 }
 
+TEST(Composition, PlainLambdas) {
+  const auto one = [](TSpan *) -> StatusOr<int> { return 1; };
+  const auto none = [](TSpan *) -> StatusOr<int> {
+    return Status(INVALID_ARGUMENT, "");
+  };
+  const auto parser = InSequence<int, absl::optional<int>, bool>(
+      Any<int>(none, one), Maybe<int>(none),
+      WithTransformation<int, bool>([](int i) { return i == 1; })(one));
+
+  TSpan tspan;
+  EXPECT_THAT(parser(&tspan), IsOkAndHolds(Eq(std::make_tuple(
+                                  1, absl::optional<int>(), true))));
+}
+
+TEST(Composition, OutlivesItsParts) {
+  Prsr<absl::variant<std::string, int>> parser;
+  {
+    const auto word = [](TSpan *) -> StatusOr<std::string_view> {
+      return std::string_view("word");
+    };
+    const auto restriction = [](std::string_view s) { return s.empty(); };
+    parser = AnyVariant<std::string, int>(
+        WithRestriction<std::string_view>(restriction)(word),
+        [](TSpan *) -> StatusOr<int> { return 2; });
+  }
+
+  TSpan tspan;
+  EXPECT_THAT(parser(&tspan), IsOkAndHolds(VariantWith<int>(2)));
+}
+
 } // namespace
 } // namespace formula
 } // namespace latis
@@ -692,6 +692,96 @@ INSTANTIATE_TEST_SUITE_P(
         },
     }));
 
+INSTANTIATE_TEST_SUITE_P(
+    Malformed, ExpressionTestSuite,
+    ValuesIn(std::vector<std::pair<std::string, absl::optional<std::string>>>{
+        {"()", absl::nullopt},
+        {"(3+)", absl::nullopt},
+        {"(1, 2)", absl::nullopt},
+        {"FOO()", absl::nullopt},
+        {"FOO(1 2)", absl::nullopt},
+        {"FOO(1,)", absl::nullopt},
+        {"+", absl::nullopt},
+    }));
+
+TEST(ExpressionTest, LongSum) {
+  const int n = 10000;
+  std::string input = "1";
+  for (int i = 1; i < n; ++i) {
+    input += "+1";
+  }
+
+  std::vector<Token> tokens;
+  ASSERT_OK_AND_ASSIGN(tokens, Lex(input));
+  TSpan tspan{tokens};
+  Parser p;
+  const auto expression_or_status = p.ConsumeExpression(&tspan);
+  ASSERT_THAT(expression_or_status, IsOk());
+  EXPECT_THAT(tspan, IsEmpty());
+  const Expression &expression = expression_or_status.ValueOrDie();
+
+  // Right-associative, so the operations nest down the last term.
+  int depth = 0;
+  const Expression *e = &expression;
+  while (e->has_operation()) {
+    ASSERT_EQ(e->operation().fn_name(), "PLUS");
+    ASSERT_EQ(e->operation().terms_size(), 2);
+    EXPECT_TRUE(e->operation().terms(0).has_value());
+    e = &e->operation().terms(1);
+    ++depth;
+  }
+  EXPECT_EQ(depth, n - 1);
+}
+
+TEST(ExpressionTest, DeeplyNested) {
+  const int n = 200;
+  const std::string input =
+      std::string(n, '(') + "A1 + 1" + std::string(n, ')');
+
+  std::vector<Token> tokens;
+  ASSERT_OK_AND_ASSIGN(tokens, Lex(input));
+  TSpan tspan{tokens};
+  Parser p;
+  const auto expression_or_status = p.ConsumeExpression(&tspan);
+  ASSERT_THAT(expression_or_status, IsOk());
+  EXPECT_THAT(tspan, IsEmpty());
+  const Expression &expression = expression_or_status.ValueOrDie();
+  EXPECT_THAT(expression, EqualsProto(ToProto<Expression>(
+                              R"pb(operation {
+                                     fn_name: "PLUS"
+                                     terms: { lookup: { row: 0 col: 0 } }
+                                     terms: { value: { int_amount: 1 } }
+                                   })pb")));
+}
+
+TEST(ExpressionTest, ParserIsReusable) {
+  // Nothing remembered from one parse should leak into the next, even where
+  // the tokens land at the same addresses.
+  const std::vector<std::string> inputs = {
+      "A1 + 2", "2 + A1", "A1:B2", "(1 +)", "B2 * A1", "A1 + 2",
+  };
+  Parser reused;
+  for (const std::string &input : inputs) {
+    std::vector<Token> tokens;
+    ASSERT_OK_AND_ASSIGN(tokens, Lex(input));
+
+    TSpan fresh_tspan{tokens};
+    Parser fresh;
+    const auto fresh_or_status = fresh.ConsumeExpression(&fresh_tspan);
+
+    TSpan reused_tspan{tokens};
+    const auto reused_or_status = reused.ConsumeExpression(&reused_tspan);
+
+    ASSERT_EQ(reused_or_status.ok(), fresh_or_status.ok()) << input;
+    EXPECT_EQ(reused_tspan.size(), fresh_tspan.size()) << input;
+    if (fresh_or_status.ok()) {
+      EXPECT_THAT(reused_or_status.ValueOrDie(),
+                  EqualsProto(fresh_or_status.ValueOrDie()))
+          << input;
+    }
+  }
+}
+
 } // namespace
 } // namespace formula
 } // namespace latis
@@ -0,0 +1,307 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/formula/program.h"
+
+#include "proto/latis_msg.pb.h"
+#include "src/formula/common.h"
+#include "src/formula/functions.h"
+#include "src/utils/cleanup.h"
+#include "src/utils/status_macros.h"
+
+#include "absl/strings/str_format.h"
+#include "absl/types/optional.h"
+
+#include <algorithm>
+
+namespace latis {
+namespace formula {
+
+using ::google::protobuf::util::Status;
+using ::google::protobuf::util::StatusOr;
+using ::google::protobuf::util::error::INVALID_ARGUMENT;
+
+namespace {
+
+using Op = Program::Op;
+
+absl::optional<Op> ResolveUnary(absl::string_view fn_name) {
+  if (fn_name == functions::kNOT) {
+    return Op::kNot;
+  } else if (fn_name == functions::kNEG) {
+    return Op::kNeg;
+  }
+  return absl::nullopt;
+}
+
+absl::optional<Op> ResolveBinary(absl::string_view fn_name) {
+  if (fn_name == functions::kPLUS || fn_name == functions::kSUM ||
+      fn_name == functions::kADD) {
+    return Op::kAdd;
+  } else if (fn_name == functions::kMINUS || fn_name == functions::kSUB ||
+             fn_name == functions::kSUBTRACT) {
+    return Op::kSub;
+  } else if (fn_name == functions::kMULTIPLIED_BY ||
+             fn_name == functions::kTIMES || fn_name == functions::kPRODUCT) {
+    return Op::kMul;
+  } else if (fn_name == functions::kDIVIDED_BY || fn_name == functions::kDIV) {
+    return Op::kDiv;
+  } else if (fn_name == functions::kAND) {
+    return Op::kAnd;
+  } else if (fn_name == functions::kOR) {
+    return Op::kOr;
+  } else if (fn_name == functions::kLTHAN) {
+    return Op::kLthan;
+  } else if (fn_name == functions::kGTHAN) {
+    return Op::kGthan;
+  } else if (fn_name == functions::kLEQ) {
+    return Op::kLeq;
+  } else if (fn_name == functions::kGEQ) {
+    return Op::kGeq;
+  } else if (fn_name == functions::kEQ) {
+    return Op::kEq;
+  } else if (fn_name == functions::kNEQ) {
+    return Op::kNeq;
+  } else if (fn_name == functions::kPOW) {
+    return Op::kPow;
+  } else if (fn_name == functions::kMOD) {
+    return Op::kMod;
+  }
+  return absl::nullopt;
+}
+
+// The subset of binary ops which can fold a range.
+bool CanFold(Op op) {
+  return op == Op::kAdd || op == Op::kMul || op == Op::kAnd || op == Op::kOr;
+}
+
+// Monadic shim.
+StatusOr<Value> BoolToValue(StatusOr<bool> b) {
+  if (b.ok()) {
+    return Value::Bool(b.ValueOrDie());
+  }
+  return b.status();
+}
+
+StatusOr<Value> ApplyUnary(Op op, Value arg) {
+  switch (op) {
+  case Op::kNot:
+    return !arg;
+  case Op::kNeg:
+    return -arg;
+  default:
+    return Status(INVALID_ARGUMENT, " no operation match.");
+  }
+}
+
+StatusOr<Value> ApplyBinary(Op op, Value lhs, Value rhs) {
+  switch (op) {
+  case Op::kAdd:
+    return lhs + rhs;
+  case Op::kSub:
+    return lhs - rhs;
+  case Op::kMul:
+    return lhs * rhs;
+  case Op::kDiv:
+    return lhs / rhs;
+  case Op::kAnd:
+    return lhs && rhs;
+  case Op::kOr:
+    return lhs || rhs;
+  case Op::kLthan:
+    return BoolToValue(lhs < rhs);
+  case Op::kGthan:
+    return BoolToValue(lhs > rhs);
+  case Op::kLeq:
+    return BoolToValue(lhs <= rhs);
+  case Op::kGeq:
+    return BoolToValue(lhs >= rhs);
+  case Op::kEq:
+    return BoolToValue(lhs == rhs);
+  case Op::kNeq:
+    return BoolToValue(lhs != rhs);
+  case Op::kPow:
+    return lhs ^ rhs;
+  case Op::kMod:
+    return lhs % rhs;
+  default:
+    return Status(INVALID_ARGUMENT, " no operation match.");
+  }
+}
+
+} // namespace
+
+Program Program::Compile(const Expression &expression) {
+  Program program;
+  program.Emit(expression, 0);
+  return program;
+}
+
+void Program::Emit(const Expression &expression, int depth) {
+  max_depth_ = std::max(max_depth_, depth + 1);
+  if (expression.has_value()) {
+    code_.push_back({Op::kPushConstant, Op::kPushConstant,
+                     static_cast<int32_t>(constants_.size())});
+    // The Value only names its string, so the program keeps the characters.
+    if (expression.value().has_str_amount()) {
+      strings_.push_front(expression.value().str_amount());
+      constants_.push_back(Value::String(strings_.front()));
+    } else {
+      constants_.push_back(Value::From(expression.value()));
+    }
+  } else if (expression.has_operation()) {
+    EmitOperation(expression.operation(), depth);
+  } else if (expression.has_lookup()) {
+    code_.push_back({Op::kLookup, Op::kLookup,
+                     static_cast<int32_t>(cells_.size())});
+    cells_.push_back(XY::From(expression.lookup()));
+  } else {
+    EmitFail("?");
+  }
+}
+
+void Program::EmitOperation(const Expression::Operation &op, int depth) {
+  const absl::string_view fn_name = op.fn_name();
+
+  switch (op.terms_size()) {
+  case (1): {
+    if (op.terms(0).has_range()) {
+      const auto maybe_range = XYRange::From(op.terms(0).range());
+      if (!maybe_range.ok()) {
+        EmitFail(std::string(maybe_range.status().error_message()));
+        return;
+      }
+      if (!maybe_range.ValueOrDie().IsBounded()) {
+        EmitFail("Evaluator: can't aggregate over an unbounded range");
+        return;
+      }
+      const absl::optional<Op> fold = ResolveBinary(fn_name);
+      if (!fold.has_value() || !CanFold(fold.value())) {
+        EmitFail(" no range operation match.");
+        return;
+      }
+      code_.push_back({Op::kFoldRange, fold.value(),
+                       static_cast<int32_t>(ranges_.size())});
+      ranges_.push_back(maybe_range.ValueOrDie());
+      return;
+    }
+    Emit(op.terms(0), depth);
+    const absl::optional<Op> unary = ResolveUnary(fn_name);
+    if (!unary.has_value()) {
+      EmitFail(" no operation match.");
+      return;
+    }
+    code_.push_back({unary.value(), unary.value(), 0});
+    return;
+  }
+  case (2): {
+    Emit(op.terms(0), depth);
+    Emit(op.terms(1), depth + 1);
+    const absl::optional<Op> binary = ResolveBinary(fn_name);
+    if (!binary.has_value()) {
+      EmitFail(" no operation match.");
+      return;
+    }
+    code_.push_back({binary.value(), binary.value(), 0});
+    return;
+  }
+  default: {
+    EmitFail(" no operation match.");
+    return;
+  }
+  }
+}
+
+void Program::EmitFail(std::string error) {
+  code_.push_back({Op::kFail, Op::kFail, static_cast<int32_t>(errors_.size())});
+  errors_.push_back(std::move(error));
+}
+
+StatusOr<Amount> Program::Run(const LookupFn &lookup_fn) const {
+  // NB: Keeps the strings looked up in the arena of the Run() below.
+  return Run([&lookup_fn](XY xy) -> absl::optional<Value> {
+    const absl::optional<Amount> maybe_value = lookup_fn(xy);
+    if (!maybe_value.has_value()) {
+      return absl::nullopt;
+    }
+    return Value::Keep(maybe_value.value());
+  });
+}
+
+StatusOr<Amount> Program::Run(const ValueLookupFn &lookup_fn) const {
+  // For whatever strings are computed, until the result is copied out.
+  StringArena arena;
+  // One stack per thread, kept between runs so that it only allocates when a
+  // program runs deeper than any before it. It's taken rather than borrowed,
+  // so that a |lookup_fn| which runs a program of its own gets its own stack.
+  thread_local std::vector<Value> spare;
+  std::vector<Value> stack = std::move(spare);
+  auto give_back = MakeCleanup([&] {
+    stack.clear();
+    spare = std::move(stack);
+  });
+  stack.clear();
+  stack.reserve(max_depth_);
+
+  for (const Instruction &instruction : code_) {
+    switch (instruction.op) {
+    case Op::kPushConstant: {
+      stack.push_back(constants_[instruction.arg]);
+      break;
+    }
+    case Op::kLookup: {
+      const XY xy = cells_[instruction.arg];
+      const absl::optional<Value> maybe_value = lookup_fn(xy);
+      if (!maybe_value.has_value()) {
+        return Status(
+            INVALID_ARGUMENT,
+            absl::StrFormat("Evaluator: no value in cell %s", xy.ToA1()));
+      }
+      stack.push_back(maybe_value.value());
+      break;
+    }
+    case Op::kFoldRange: {
+      Value value;
+      ASSIGN_OR_RETURN_(
+          value, FoldRange(ranges_[instruction.arg], lookup_fn,
+                           [op = instruction.fold](Value lhs, Value rhs) {
+                             return ApplyBinary(op, lhs, rhs);
+                           }));
+      stack.push_back(value);
+      break;
+    }
+    case Op::kFail: {
+      return Status(INVALID_ARGUMENT, errors_[instruction.arg]);
+    }
+    case Op::kNot:
+    case Op::kNeg: {
+      ASSIGN_OR_RETURN_(stack.back(), ApplyUnary(instruction.op, stack.back()));
+      break;
+    }
+    default: {
+      const Value rhs = stack.back();
+      stack.pop_back();
+      ASSIGN_OR_RETURN_(stack.back(),
+                        ApplyBinary(instruction.op, stack.back(), rhs));
+      break;
+    }
+    }
+  }
+
+  // Every well-formed program leaves exactly its result behind.
+  return stack.back().ToAmount();
+}
+
+} // namespace formula
+} // namespace latis
@@ -0,0 +1,141 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_FORMULA_PROGRAM_H_
+#define SRC_FORMULA_PROGRAM_H_
+
+#include "proto/latis_msg.pb.h"
+#include "src/formula/common.h"
+#include "src/formula/value.h"
+#include "src/xy.h"
+
+#include "google/protobuf/stubs/status.h"
+#include "google/protobuf/stubs/statusor.h"
+
+#include "absl/types/optional.h"
+
+#include <cstdint>
+#include <forward_list>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace latis {
+namespace formula {
+
+// Looks up the value of a cell for a Program to run on. Any string must stay
+// put for the length of the run.
+using ValueLookupFn = std::function<absl::optional<Value>(XY)>;
+
+// A Program is an Expression compiled down to flat postfix bytecode, for a
+// small stack machine to run.
+//
+// Compiling resolves function names to opcodes and lookups to XYs up front,
+// so that re-evaluating a cell is a single pass over a vector rather than a
+// walk over a proto tree with string comparisons at each node.
+//
+// Programs are immutable once compiled, and cheap to run repeatedly:
+//   const Program program = Program::Compile(expression);
+//   ASSIGN_OR_RETURN_(amount, program.Run(lookup_fn));
+class Program {
+public:
+  enum class Op : uint8_t {
+    // Pushes constants_[arg].
+    kPushConstant,
+    // Pushes the value at cells_[arg], or fails if there is none.
+    kLookup,
+    // Folds the values in ranges_[arg] with the binary op in |fold|.
+    kFoldRange,
+    // Fails with errors_[arg].
+    kFail,
+    // Pop one, push one.
+    kNot,
+    kNeg,
+    // Pop two (rhs on top), push one.
+    kAdd,
+    kSub,
+    kMul,
+    kDiv,
+    kAnd,
+    kOr,
+    kLthan,
+    kGthan,
+    kLeq,
+    kGeq,
+    kEq,
+    kNeq,
+    kPow,
+    kMod,
+  };
+
+  struct Instruction {
+    Op op;
+    // Only used by kFoldRange.
+    Op fold;
+    // An index into one of the side tables, if |op| needs one.
+    int32_t arg;
+  };
+
+  Program() {}
+
+  // Move-only, as |constants_| point into |strings_|.
+  Program(Program &&) = default;
+  Program &operator=(Program &&) = default;
+  Program(const Program &) = delete;
+  Program &operator=(const Program &) = delete;
+
+  // Compiles |expression|. Never fails: a malformed expression compiles to a
+  // program which fails when run, at the same point and with the same error
+  // as Evaluator::CrunchExpression() would.
+  static Program Compile(const Expression &expression);
+
+  // Runs the program, reading cells through |lookup_fn|. Produces exactly what
+  // Evaluator::CrunchExpression() would for the compiled expression. Only the
+  // result is converted to an Amount.
+  ::google::protobuf::util::StatusOr<Amount>
+  Run(const ValueLookupFn &lookup_fn) const;
+  // As above, for a |lookup_fn| which reads Amounts.
+  ::google::protobuf::util::StatusOr<Amount>
+  Run(const LookupFn &lookup_fn) const;
+
+  const std::vector<Instruction> &code() const { return code_; }
+  // The cells and ranges the program reads, in no particular order.
+  const std::vector<XY> &cells() const { return cells_; }
+  const std::vector<XYRange> &ranges() const { return ranges_; }
+
+private:
+  // Appends the code for |expression|, which starts running with |depth|
+  // values already on the stack.
+  void Emit(const Expression &expression, int depth);
+  void EmitOperation(const Expression::Operation &operation, int depth);
+  void EmitFail(std::string error);
+
+  std::vector<Instruction> code_;
+  std::vector<Value> constants_;
+  // The characters of the string constants. Not a vector, whose strings would
+  // move as it grew.
+  std::forward_list<std::string> strings_;
+  std::vector<XY> cells_;
+  std::vector<XYRange> ranges_;
+  std::vector<std::string> errors_;
+  // The deepest the stack gets while running.
+  int max_depth_{0};
+};
+
+} // namespace formula
+} // namespace latis
+
+#endif // SRC_FORMULA_PROGRAM_H_
@@ -0,0 +1,155 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/formula/program.h"
+
+#include "src/formula/evaluator.h"
+#include "src/formula/lexer.h"
+#include "src/formula/parser.h"
+#include "src/test_utils/test_utils.h"
+
+#include "absl/container/flat_hash_map.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace latis {
+namespace formula {
+namespace {
+
+using ::testing::Eq;
+using ::testing::Not;
+using ::testing::SizeIs;
+using ::testing::ValuesIn;
+
+class ProgramTest : public ::testing::TestWithParam<std::string> {
+public:
+  ProgramTest() {
+    cells_[XY(0, 0)] = ToProto<Amount>("int_amount: 1");
+    cells_[XY(0, 1)] = ToProto<Amount>("double_amount: 2.5");
+    cells_[XY(0, 2)] = ToProto<Amount>("int_amount: 4");
+    cells_[XY(1, 0)] = ToProto<Amount>("bool_amount: true");
+    cells_[XY(1, 1)] = ToProto<Amount>("str_amount: 'foo'");
+  }
+
+protected:
+  Expression ParseOrDie(const std::string &input) {
+    std::vector<Token> tokens = Lex(input).ValueOrDie();
+    TSpan tspan{tokens};
+    return parser_.ConsumeExpression(&tspan).ValueOrDie();
+  }
+
+  absl::flat_hash_map<XY, Amount> cells_;
+  const LookupFn lookup_fn_ = [this](XY xy) -> absl::optional<Amount> {
+    if (const auto it = cells_.find(xy); it != cells_.end()) {
+      return it->second;
+    }
+    return absl::nullopt;
+  };
+  Parser parser_;
+};
+
+// The VM must agree with the tree-walking evaluator, errors and all.
+TEST_P(ProgramTest, MatchesEvaluator) {
+  const Expression expression = ParseOrDie(GetParam());
+
+  const auto expected = Evaluator(lookup_fn_).CrunchExpression(expression);
+  const auto actual = Program::Compile(expression).Run(lookup_fn_);
+
+  ASSERT_THAT(actual.ok(), Eq(expected.ok())) << actual.status();
+  if (expected.ok()) {
+    EXPECT_THAT(actual.ValueOrDie(), EqualsProto(expected.ValueOrDie()));
+  } else {
+    EXPECT_THAT(actual.status().error_message(),
+                Eq(expected.status().error_message()));
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(All, ProgramTest,
+                         ValuesIn(std::vector<std::string>{
+                             "1.234",
+                             "\"FOO\"",
+                             "2 + 2",
+                             "(2147483647 + 1) > 0",
+                             "PLUS(2,3)",
+                             "SUB(3.0,2.5)",
+                             "5*2.5",
+                             "True && False",
+                             "NOT(True)",
+                             "NEG(A1)",
+                             "1 < 2",
+                             " 3 >= 2 ",
+                             " 2 != 2 ",
+                             "POW(10,2)",
+                             "10 % 3.0",
+                             "A1",
+                             "A1 + A2 * A3",
+                             "(A1 + A2) * A3",
+                             "A1 + Z99",
+                             "A1 / 0",
+                             "B1 || False",
+                             "B2 + 1",
+                             "SUM(A1:A3)",
+                             "PRODUCT(A1:A3)",
+                             "SUM(C1:C3)",
+                             "SUM(A:A)",
+                             "POW(A1:A3)",
+                             "FOO(1, 2)",
+                             "FOO(Z1, 2)",
+                         }));
+
+TEST(Program, ResolvesOpsUpFront) {
+  std::vector<Token> tokens = Lex("SUM(A1, 2)").ValueOrDie();
+  TSpan tspan{tokens};
+  Parser parser;
+  const Program program =
+      Program::Compile(parser.ConsumeExpression(&tspan).ValueOrDie());
+
+  ASSERT_THAT(program.code(), SizeIs(3));
+  EXPECT_THAT(program.code()[0].op, Eq(Program::Op::kLookup));
+  EXPECT_THAT(program.code()[1].op, Eq(Program::Op::kPushConstant));
+  EXPECT_THAT(program.code()[2].op, Eq(Program::Op::kAdd));
+}
+
+TEST(Program, EmptyExpressionFails) {
+  EXPECT_THAT(Program::Compile(Expression()).Run(
+                  [](XY) -> absl::optional<Amount> { return absl::nullopt; }),
+              Not(IsOk()));
+}
+
+TEST(Program, LookupsCanRunPrograms) {
+  const auto compile = [](const std::string &input) {
+    std::vector<Token> tokens = Lex(input).ValueOrDie();
+    TSpan tspan{tokens};
+    Parser parser;
+    return Program::Compile(parser.ConsumeExpression(&tspan).ValueOrDie());
+  };
+  // A1 is itself a program, run mid-way through the outer one while the
+  // outer one has values on its stack.
+  const Program inner = compile("(2 * 3) + (4 * 5)");
+  const Program outer = compile("(1 + 1) * (A1 + A1)");
+  const LookupFn lookup_fn = [&inner](XY) -> absl::optional<Amount> {
+    return inner
+        .Run([](XY) -> absl::optional<Value> { return absl::nullopt; })
+        .ValueOrDie();
+  };
+
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_THAT(outer.Run(lookup_fn),
+                IsOkAndHolds(EqualsProto(ToProto<Amount>("int_amount: 104"))));
+  }
+}
+
+} // namespace
+} // namespace formula
+} // namespace latis
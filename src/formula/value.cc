@@ -0,0 +1,138 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/formula/value.h"
+
+#include <cassert>
+#include <string>
+
+namespace latis {
+namespace formula {
+
+namespace {
+
+thread_local StringArena *current_arena = nullptr;
+
+} // namespace
+
+StringArena::StringArena() : outer_(current_arena) { current_arena = this; }
+
+StringArena::~StringArena() { current_arena = outer_; }
+
+absl::string_view StringArena::Keep(std::string s) {
+  assert(current_arena != nullptr);
+  current_arena->strings_.push_front(std::move(s));
+  return current_arena->strings_.front();
+}
+
+Value Value::Int(int64_t i) {
+  Value v(Kind::kInt, 0);
+  v.u_.i = i;
+  return v;
+}
+
+Value Value::Double(double d) {
+  Value v(Kind::kDouble, 0);
+  v.u_.d = d;
+  return v;
+}
+
+Value Value::Bool(bool b) {
+  Value v(Kind::kBool, 0);
+  v.u_.b = b;
+  return v;
+}
+
+Value Value::String(absl::string_view s) {
+  Value v(Kind::kString, static_cast<int32_t>(s.size()));
+  v.u_.s = s.data();
+  return v;
+}
+
+Value Value::OfMoney(int32_t dollars, int32_t cents,
+                     Money::Currency currency) {
+  Value v(Kind::kMoney, currency);
+  v.u_.pair[0] = dollars;
+  v.u_.pair[1] = cents;
+  return v;
+}
+
+Value Value::OfTimestamp(int64_t seconds, int32_t nanos) {
+  Value v(Kind::kTimestamp, nanos);
+  v.u_.i = seconds;
+  return v;
+}
+
+Value Value::From(const Amount &amount) {
+  switch (amount.amount_demux_case()) {
+  case Amount::kStrAmount:
+    return String(amount.str_amount());
+  case Amount::kIntAmount:
+    return Int(amount.int_amount());
+  case Amount::kDoubleAmount:
+    return Double(amount.double_amount());
+  case Amount::kTimestampAmount:
+    return OfTimestamp(amount.timestamp_amount().seconds(),
+                       amount.timestamp_amount().nanos());
+  case Amount::kMoneyAmount:
+    return OfMoney(amount.money_amount().dollars(),
+                   amount.money_amount().cents(),
+                   amount.money_amount().currency());
+  case Amount::kBoolAmount:
+    return Bool(amount.bool_amount());
+  case Amount::AMOUNT_DEMUX_NOT_SET:
+    break;
+  }
+  return Value();
+}
+
+Value Value::Keep(const Amount &amount) {
+  if (amount.has_str_amount()) {
+    return String(StringArena::Keep(amount.str_amount()));
+  }
+  return From(amount);
+}
+
+Amount Value::ToAmount() const {
+  Amount amount;
+  switch (kind_) {
+  case Kind::kEmpty:
+    break;
+  case Kind::kString:
+    amount.set_str_amount(std::string(string_value()));
+    break;
+  case Kind::kInt:
+    amount.set_int_amount(static_cast<int32_t>(u_.i));
+    break;
+  case Kind::kDouble:
+    amount.set_double_amount(u_.d);
+    break;
+  case Kind::kTimestamp:
+    amount.mutable_timestamp_amount()->set_seconds(seconds());
+    amount.mutable_timestamp_amount()->set_nanos(nanos());
+    break;
+  case Kind::kMoney:
+    amount.mutable_money_amount()->set_dollars(dollars());
+    amount.mutable_money_amount()->set_cents(cents());
+    amount.mutable_money_amount()->set_currency(currency());
+    break;
+  case Kind::kBool:
+    amount.set_bool_amount(u_.b);
+    break;
+  }
+  return amount;
+}
+
+} // namespace formula
+} // namespace latis
@@ -0,0 +1,143 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_FORMULA_VALUE_H_
+#define SRC_FORMULA_VALUE_H_
+
+#include "proto/latis_msg.pb.h"
+
+#include "absl/strings/string_view.h"
+
+#include <cstdint>
+#include <forward_list>
+#include <string>
+#include <type_traits>
+
+namespace latis {
+namespace formula {
+
+// Value is the evaluator's native form of an Amount: a 16-byte tagged union.
+// Arithmetic on Values never touches the heap; Amount protos are only built at
+// the edges, i.e. when reading from or writing back to cells.
+//
+// Values are trivially copyable, so a string Value doesn't own its characters;
+// it only names them. Whoever made it keeps them alive: the Amount it was read
+// from, the storage::TileStore it was looked up in, the Program it is a
+// constant of, or, for a string computed while evaluating, the current
+// StringArena.
+class Value {
+public:
+  enum class Kind : uint8_t {
+    kEmpty, // An Amount with nothing in it.
+    kString,
+    kInt,
+    kDouble,
+    kTimestamp,
+    kMoney,
+    kBool,
+  };
+
+  // An empty value.
+  Value() : kind_(Kind::kEmpty), aux_(0), u_{0} {}
+
+  static Value Int(int64_t i);
+  static Value Double(double d);
+  static Value Bool(bool b);
+  // Doesn't copy |s|, which must outlive the Value.
+  static Value String(absl::string_view s);
+  static Value OfMoney(int32_t dollars, int32_t cents,
+                       Money::Currency currency);
+  static Value OfTimestamp(int64_t seconds, int32_t nanos);
+
+  // Any string is |amount|'s own, so |amount| must outlive the Value.
+  static Value From(const Amount &amount);
+  // As From(), but keeps any string in the current StringArena, so that
+  // |amount| needn't outlive the Value.
+  static Value Keep(const Amount &amount);
+  Amount ToAmount() const;
+
+  Kind kind() const { return kind_; }
+  bool IsNumeric() const {
+    return kind_ == Kind::kInt || kind_ == Kind::kDouble;
+  }
+
+  // Each of these is only meaningful for the matching kind.
+  int64_t int_value() const { return u_.i; }
+  double double_value() const { return u_.d; }
+  bool bool_value() const { return u_.b; }
+  absl::string_view string_value() const {
+    return absl::string_view(u_.s, static_cast<uint32_t>(aux_));
+  }
+  int32_t dollars() const { return u_.pair[0]; }
+  int32_t cents() const { return u_.pair[1]; }
+  Money::Currency currency() const {
+    return static_cast<Money::Currency>(aux_);
+  }
+  int64_t seconds() const { return u_.i; }
+  int32_t nanos() const { return aux_; }
+
+  // For numerics, the value as a double.
+  double AsDouble() const {
+    return kind_ == Kind::kInt ? static_cast<double>(u_.i) : u_.d;
+  }
+
+private:
+  Value(Kind kind, int32_t aux) : kind_(kind), aux_(aux), u_{0} {}
+
+  Kind kind_;
+  // Money::Currency for kMoney, nanos for kTimestamp, the length for kString.
+  int32_t aux_;
+  union {
+    int64_t i;       // kInt, seconds for kTimestamp.
+    double d;        // kDouble.
+    bool b;          // kBool.
+    const char *s;   // kString.
+    int32_t pair[2]; // {dollars, cents} for kMoney.
+  } u_;
+};
+
+static_assert(sizeof(Value) == 16, "Value should be two words.");
+static_assert(std::is_trivially_copyable<Value>::value,
+              "Value should copy as plain bytes.");
+
+// Holds the strings computed while evaluating, i.e. by concatenation, for as
+// long as the Values naming them are in use.
+//
+// Arenas nest: the one most recently made on a thread, and not yet destroyed,
+// is that thread's current arena. Whatever evaluates, i.e. Program::Run(),
+// makes one for the length of the evaluation, and converts its result to an
+// Amount before letting it go. Allocates nothing unless a string is kept.
+class StringArena {
+public:
+  StringArena();
+  ~StringArena();
+
+  StringArena(const StringArena &) = delete;
+  StringArena &operator=(const StringArena &) = delete;
+
+  // Moves |s| into the current arena, which there must be, and returns it.
+  static absl::string_view Keep(std::string s);
+
+private:
+  StringArena *const outer_;
+  // Not a vector, whose strings would move as it grew.
+  std::forward_list<std::string> strings_;
+};
+
+} // namespace formula
+} // namespace latis
+
+#endif // SRC_FORMULA_VALUE_H_
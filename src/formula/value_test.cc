@@ -0,0 +1,99 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/formula/value.h"
+
+#include "src/test_utils/test_utils.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace latis {
+namespace formula {
+namespace {
+
+using ::testing::Eq;
+using ::testing::ValuesIn;
+
+class RoundTripTest : public ::testing::TestWithParam<std::string> {};
+
+TEST_P(RoundTripTest, AmountSurvivesValue) {
+  const Amount amount = ToProto<Amount>(GetParam());
+  EXPECT_THAT(Value::From(amount).ToAmount(), EqualsProto(amount))
+      << Value::From(amount).ToAmount().DebugString();
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    All, RoundTripTest,
+    ValuesIn(std::vector<std::string>{
+        "",
+        "int_amount: 5",
+        "int_amount: -12",
+        "double_amount: 2.5",
+        "bool_amount: true",
+        "bool_amount: false",
+        "str_amount: 'hello'",
+        "str_amount: ''",
+        "timestamp_amount { seconds: 100 nanos: 5 }",
+        "money_amount { dollars: 3 cents: 50 currency: USD }",
+        "money_amount { dollars: 0 cents: 0 currency: CAD }",
+    }));
+
+TEST(ValueTest, Kinds) {
+  EXPECT_THAT(Value().kind(), Eq(Value::Kind::kEmpty));
+  EXPECT_THAT(Value::Int(1).kind(), Eq(Value::Kind::kInt));
+  EXPECT_THAT(Value::Double(1.0).kind(), Eq(Value::Kind::kDouble));
+  EXPECT_THAT(Value::Bool(true).kind(), Eq(Value::Kind::kBool));
+  EXPECT_THAT(Value::String("a").kind(), Eq(Value::Kind::kString));
+  EXPECT_TRUE(Value::Int(1).IsNumeric());
+  EXPECT_TRUE(Value::Double(1.0).IsNumeric());
+  EXPECT_FALSE(Value::Bool(true).IsNumeric());
+  EXPECT_THAT(Value::Int(3).AsDouble(), Eq(3.0));
+}
+
+TEST(ValueTest, StringsNameTheirCharacters) {
+  const std::string s = "latis";
+  const Value a = Value::String(s);
+  const Value b = a;
+  EXPECT_THAT(a.string_value(), Eq("latis"));
+  EXPECT_THAT(b.string_value().data(), Eq(s.data()));
+}
+
+TEST(ValueTest, KeepOutlivesTheAmount) {
+  StringArena arena;
+  Value value;
+  {
+    Amount amount;
+    amount.set_str_amount("short-lived");
+    value = Value::Keep(amount);
+  }
+  EXPECT_THAT(value.kind(), Eq(Value::Kind::kString));
+  EXPECT_THAT(value.string_value(), Eq("short-lived"));
+}
+
+TEST(ValueTest, ArenasNest) {
+  StringArena outer;
+  const absl::string_view a = StringArena::Keep("a");
+  {
+    StringArena inner;
+    EXPECT_THAT(StringArena::Keep("b"), Eq("b"));
+  }
+  // Back in |outer|, which still has its own.
+  EXPECT_THAT(StringArena::Keep("c"), Eq("c"));
+  EXPECT_THAT(a, Eq("a"));
+}
+
+} // namespace
+} // namespace formula
+} // namespace latis
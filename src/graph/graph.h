@@ -21,7 +21,11 @@
 #include "absl/container/flat_hash_set.h"
 #include "absl/memory/memory.h"
 #include <algorithm>
+#include <cstdint>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <utility>
 #include <vector>
 
 namespace latis {
@@ -30,7 +34,12 @@ namespace graph {
 // Implements online dynamic topological sort.
 //
 // For a set of nodes of type T, maintains a directed acyclic graph of edges
-// between nodes.
+// between nodes, alongside a topological order of those nodes. The order is
+// kept up to date on every insertion with the Pearce-Kelly algorithm (see "A
+// Dynamic Topological Sort Algorithm for Directed Acyclic Graphs", 2006): an
+// edge which already agrees with the order costs O(1), and one which doesn't
+// only searches and reorders the nodes between its two endpoints. An edge to
+// or from a node new to the graph always agrees with the order.
 template <typename T> //
 class Graph {
 public:
@@ -40,16 +49,93 @@ public:
   // If an edge creates a cycle, this method will return false and not perform
   // the insertion. Otherwise, will return true.
   bool AddEdge(T from, T to) {
-    if (IsCycle(from, to)) {
+    if (from == to) {
       return false;
     }
+    const int ub = OrdOf(from, /*first=*/true);
+    const int lb = OrdOf(to, /*first=*/false);
+    if (lb < ub) {
+      // Discover the affected region, i.e. the nodes ordered between |to| and
+      // |from| which would have to move.
+      std::vector<T> forward{};
+      if (!SearchForward(to, ub, from, &forward)) {
+        return false;
+      }
+      std::vector<T> backward{};
+      SearchBackward(from, lb, &backward);
+      Reorder(&forward, &backward);
+    }
     p2c_[from].insert(to);
     c2p_[to].insert(from);
     return true;
   }
 
+  // Inserts every edge of |edges| at once. Rather than keeping the order up to
+  // date edge by edge, builds it afresh in one pass over the whole graph with
+  // Kahn's algorithm, in O(V + E); this suits loading a graph in bulk, where
+  // most edges would otherwise each need a search. If together the edges
+  // would create a cycle, returns false and inserts none of them.
+  bool AddEdges(const std::vector<std::pair<T, T>> &edges) {
+    std::vector<std::pair<T, T>> inserted{};
+    inserted.reserve(edges.size());
+    const auto undo = [&]() {
+      for (const auto &[from, to] : inserted) {
+        RemoveEdge(from, to);
+      }
+      return false;
+    };
+    for (const auto &[from, to] : edges) {
+      if (from == to) {
+        return undo();
+      }
+      if (p2c_[from].insert(to).second) {
+        c2p_[to].insert(from);
+        inserted.emplace_back(from, to);
+      }
+    }
+
+    // Count the edges into every node, including those only known to
+    // |ord_|, then peel off whichever have none left.
+    absl::flat_hash_map<T, size_t> pending{};
+    pending.reserve(ord_.size() + p2c_.size());
+    for (const auto &[node, ord] : ord_) {
+      pending.try_emplace(node, 0);
+    }
+    for (const auto &[node, children] : p2c_) {
+      pending.try_emplace(node, 0);
+    }
+    for (const auto &[node, parents] : c2p_) {
+      pending[node] = parents.size();
+    }
+    std::vector<T> ready{};
+    for (const auto &[node, count] : pending) {
+      if (count == 0) {
+        ready.push_back(node);
+      }
+    }
+    absl::flat_hash_map<T, int> ord{};
+    ord.reserve(pending.size());
+    while (!ready.empty()) {
+      const T curr = ready.back();
+      ready.pop_back();
+      ord.emplace(curr, static_cast<int>(ord.size()));
+      for (const T &kid : p2c_[curr]) {
+        if (--pending[kid] == 0) {
+          ready.push_back(kid);
+        }
+      }
+    }
+    if (ord.size() != pending.size()) {
+      return undo();
+    }
+    first_ord_ = 0;
+    next_ord_ = static_cast<int>(ord.size());
+    ord_ = std::move(ord);
+    return true;
+  }
+
   // The inverse of AddEdge, except there is no checking of whether the edge
-  // existed before.
+  // existed before. The topological order remains valid.
   void RemoveEdge(T from, T to) {
     p2c_[from].erase(to);
     c2p_[to].erase(from);
@@ -58,14 +144,110 @@ public:
   // Possibly useful.
   bool HasEdge(T from, T to) { return p2c_[from].contains(to); }
 
+  // A plan for recalculating everything downstream of some set of dirty nodes.
+  struct Plan {
+    // Every node to recalculate, each exactly once, in topological order.
+    std::vector<T> nodes;
+    // Where each level ends in |nodes|. No node of a level depends on another
+    // node of the same level.
+    std::vector<size_t> level_ends;
+    // Nodes downstream of a cycle formed by |extra_children|, which can't be
+    // placed in any order. Always empty without |extra_children|.
+    std::vector<T> cyclic;
+    // The number of times the walk reached a node which was already planned.
+    // Each is a recalculation which a walk over every path would have
+    // repeated.
+    int64_t saved{0};
+  };
+
+  // Appends to its second argument any children of its first argument which
+  // aren't recorded as edges in this graph.
+  using ChildrenFn = std::function<void(const T &, std::vector<T> *)>;
+
+  // Plans the recalculation of every node descending from any of |dirty|.
+  // Nodes are grouped by level, i.e. by the length of the longest path to
+  // them from |dirty|, so that all the nodes of one level come before the
+  // next; within a level they are in topological order. Nodes of |dirty| are
+  // only included if they descend from another.
+  //
+  // If given, |extra_children| adds implicit edges to the walk, e.g. for
+  // dependencies which are indexed elsewhere.
+  Plan PlanRecalculation(const std::vector<T> &dirty,
+                         const ChildrenFn &extra_children = nullptr) {
+    Plan plan{};
+
+    // Discover the affected subgraph, and count the edges into each node.
+    absl::flat_hash_map<T, std::vector<T>> children{};
+    absl::flat_hash_map<T, int> pending{};
+    std::vector<T> stack(dirty.begin(), dirty.end());
+    for (const T &root : dirty) {
+      children.try_emplace(root);
+    }
+    while (!stack.empty()) {
+      const T curr = stack.back();
+      stack.pop_back();
+      // NB: Built up on the side, since the loop below inserts into
+      // |children|, and a rehash would move any entry we held onto.
+      std::vector<T> kids(p2c_[curr].begin(), p2c_[curr].end());
+      if (extra_children != nullptr) {
+        extra_children(curr, &kids);
+      }
+      for (const T &kid : kids) {
+        if (pending[kid]++ > 0) {
+          plan.saved++;
+        }
+        if (children.try_emplace(kid).second) {
+          stack.push_back(kid);
+        }
+      }
+      children[curr] = std::move(kids);
+    }
+
+    // Peel off one level at a time, starting from the roots which nothing
+    // else in the subgraph points to.
+    std::vector<T> level{};
+    for (const T &root : dirty) {
+      if (!pending.contains(root)) {
+        level.push_back(root);
+      }
+    }
+    while (!level.empty()) {
+      std::vector<T> next{};
+      for (const T &curr : level) {
+        for (const T &kid : children[curr]) {
+          if (--pending[kid] == 0) {
+            next.push_back(kid);
+          }
+        }
+      }
+      SortByOrd(&next);
+      plan.nodes.insert(plan.nodes.end(), next.begin(), next.end());
+      if (!next.empty()) {
+        plan.level_ends.push_back(plan.nodes.size());
+      }
+      level = std::move(next);
+    }
+
+    for (const auto &[node, count] : pending) {
+      if (count > 0) {
+        plan.cyclic.push_back(node);
+      }
+    }
+
+    saved_ += plan.saved;
+    return plan;
+  }
+
   // Returns a vector of nodes descending from some input node.
-  // The returned vector will be in topological order.
+  // The returned vector will be in topological order, and free of duplicates.
+  // See PlanRecalculation().
   std::vector<T> GetDescendantsOf(T node) {
-    std::vector<T> vec{};
-    GetDescendantsOfInternal(node, &vec);
-    return vec;
+    return PlanRecalculation({node}).nodes;
   }
 
+  // The total number of recalculations saved across every plan so far.
+  int64_t RecalculationsSaved() const { return saved_; }
+
   // Returns a vector of nodes which are _direct_ parents of some input node.
   std::vector<T> GetParentsOf(T node) {
     return std::vector<T>(c2p_[node].begin(), c2p_[node].end());
@@ -86,6 +268,9 @@ public:
     for (const T &c : children) {
       RemoveEdge(node, c);
     }
+    p2c_.erase(node);
+    c2p_.erase(node);
+    ord_.erase(node);
     return descendants;
   }
 
@@ -134,26 +319,109 @@ public:
   }
 
 private:
-  // Returns true if a cycle is found.
-  bool IsCycle(T cand, T node) {
-    return cand == node || std::any_of(p2c_[node].begin(), p2c_[node].end(),
-                                       [&](const T &child) {
-                                         return (child == cand) ||
-                                                IsCycle(cand, child);
-                                       });
+  // Returns the position of |node| in the topological order. A node without
+  // one has no edges yet, so can go anywhere: it's put |first|, before every
+  // other node, or else after them all. The source of a new edge goes first
+  // and its target last, so that the edge agrees with the order as it is; the
+  // commonest edit, a formula starting to read a cell which has no edges yet,
+  // then needs no search.
+  int OrdOf(const T &node, bool first) {
+    const auto [it, inserted] =
+        ord_.try_emplace(node, first ? first_ord_ - 1 : next_ord_);
+    if (inserted && first) {
+      first_ord_--;
+    } else if (inserted) {
+      next_ord_++;
+    }
+    return it->second;
+  }
+
+  // Collects into |output| every node reachable from |start| whose position is
+  // below |ub|. Returns false if |target| is reachable, i.e. if an edge from
+  // |target| to |start| would close a cycle.
+  bool SearchForward(const T &start, int ub, const T &target,
+                     std::vector<T> *output) {
+    absl::flat_hash_set<T> seen{start};
+    std::vector<T> stack{start};
+    while (!stack.empty()) {
+      const T curr = stack.back();
+      stack.pop_back();
+      output->push_back(curr);
+      for (const T &child : p2c_[curr]) {
+        if (child == target) {
+          return false;
+        }
+        if (ord_.at(child) < ub && seen.insert(child).second) {
+          stack.push_back(child);
+        }
+      }
+    }
+    return true;
+  }
+
+  // Collects into |output| every node which reaches |start| and whose position
+  // is above |lb|.
+  void SearchBackward(const T &start, int lb, std::vector<T> *output) {
+    absl::flat_hash_set<T> seen{start};
+    std::vector<T> stack{start};
+    while (!stack.empty()) {
+      const T curr = stack.back();
+      stack.pop_back();
+      output->push_back(curr);
+      for (const T &parent : c2p_[curr]) {
+        if (ord_.at(parent) > lb && seen.insert(parent).second) {
+          stack.push_back(parent);
+        }
+      }
+    }
   }
 
-  void GetDescendantsOfInternal(T node, std::vector<T> *output) {
-    for (const T &child : p2c_[node]) {
-      output->push_back(child);
+  // Hands the positions held by the affected region back out, so that every
+  // node in |backward| comes before every node in |forward|, and each group
+  // keeps its relative order.
+  void Reorder(std::vector<T> *forward, std::vector<T> *backward) {
+    SortByOrd(forward);
+    SortByOrd(backward);
+    std::vector<int> pool{};
+    pool.reserve(forward->size() + backward->size());
+    for (const T &node : *backward) {
+      pool.push_back(ord_.at(node));
+    }
+    for (const T &node : *forward) {
+      pool.push_back(ord_.at(node));
+    }
+    std::sort(pool.begin(), pool.end());
+    auto it = pool.begin();
+    for (const T &node : *backward) {
+      ord_[node] = *it++;
     }
-    for (const T &child : p2c_[node]) {
-      GetDescendantsOfInternal(child, output);
+    for (const T &node : *forward) {
+      ord_[node] = *it++;
     }
   }
 
+  // Nodes without a position, i.e. without any edges, sort last.
+  void SortByOrd(std::vector<T> *nodes) const {
+    const auto ord_of = [this](const T &node) {
+      const auto it = ord_.find(node);
+      return it == ord_.end() ? std::numeric_limits<int>::max() : it->second;
+    };
+    std::sort(nodes->begin(), nodes->end(), [&](const T &a, const T &b) {
+      return ord_of(a) < ord_of(b);
+    });
+  }
+
   absl::flat_hash_map<T, absl::flat_hash_set<T>> p2c_;
   absl::flat_hash_map<T, absl::flat_hash_set<T>> c2p_;
+
+  // node => position in the topological order. Positions are unique, but not
+  // necessarily contiguous.
+  absl::flat_hash_map<T, int> ord_;
+  // The lowest position handed out so far, and one past the highest.
+  int first_ord_{0};
+  int next_ord_{0};
+
+  int64_t saved_{0};
 };
 
 } // namespace graph
@@ -27,6 +27,7 @@ using ::testing::ElementsAre;
 using ::testing::Eq;
 using ::testing::IsEmpty;
 using ::testing::Pointwise;
+using ::testing::SizeIs;
 using ::testing::UnorderedElementsAre;
 
 TEST(Graph, AddAndHas) {
@@ -63,6 +64,233 @@ TEST(Graph, Removal) {
   EXPECT_THAT(g.GetParentsOf(1), IsEmpty());
 }
 
+TEST(Graph, ReordersOnBackwardsEdge) {
+  Graph<int> g;
+
+  // Nodes are first seen in the order 3, 2, 1, 0, but must end up sorted
+  // 0, 1, 2, 3.
+  EXPECT_TRUE(g.AddEdge(2, 3));
+  EXPECT_TRUE(g.AddEdge(1, 2));
+  EXPECT_TRUE(g.AddEdge(0, 1));
+  EXPECT_THAT(g.GetDescendantsOf(0), ElementsAre(1, 2, 3));
+
+  EXPECT_FALSE(g.AddEdge(3, 0));
+  EXPECT_FALSE(g.AddEdge(3, 1));
+}
+
+TEST(Graph, ReordersWhenBothEndsAreKnown) {
+  Graph<int> g;
+
+  // 2 is new to the graph, so is placed before 0 and 1; until it turns out
+  // to come after them.
+  EXPECT_TRUE(g.AddEdge(0, 1));
+  EXPECT_TRUE(g.AddEdge(2, 3));
+  EXPECT_TRUE(g.AddEdge(1, 2));
+  EXPECT_THAT(g.GetDescendantsOf(0), ElementsAre(1, 2, 3));
+
+  EXPECT_FALSE(g.AddEdge(3, 0));
+}
+
+TEST(Graph, NewSourcesGoFirst) {
+  Graph<int> g;
+
+  // Each edge is from a node new to the graph into the head of a chain, so
+  // agrees with the order as it stands.
+  const int kLength = 1000;
+  for (int i = 0; i < kLength; ++i) {
+    EXPECT_TRUE(g.AddEdge(i, i + 1));
+  }
+  for (int i = 1; i <= kLength; ++i) {
+    EXPECT_TRUE(g.AddEdge(-i, 0));
+  }
+
+  const auto descendants = g.GetDescendantsOf(-kLength);
+  EXPECT_THAT(descendants.size(), Eq(kLength + 1));
+  EXPECT_THAT(descendants.front(), Eq(0));
+  EXPECT_THAT(descendants.back(), Eq(kLength));
+  EXPECT_FALSE(g.AddEdge(kLength, -1));
+}
+
+TEST(Graph, AddEdgesInBulk) {
+  Graph<int> g;
+  EXPECT_TRUE(g.AddEdge(4, 5));
+
+  // Given backwards, as for ReordersOnBackwardsEdge.
+  EXPECT_TRUE(g.AddEdges({{2, 3}, {1, 2}, {0, 1}, {3, 4}}));
+  EXPECT_THAT(g.GetDescendantsOf(0), ElementsAre(1, 2, 3, 4, 5));
+  EXPECT_THAT(g.GetParentsOf(4), UnorderedElementsAre(3));
+
+  // And edges added one by one afterwards still keep to the order.
+  EXPECT_FALSE(g.AddEdge(5, 0));
+  EXPECT_TRUE(g.AddEdge(0, 5));
+  EXPECT_TRUE(g.AddEdge(6, 0));
+  EXPECT_THAT(g.GetDescendantsOf(6), ElementsAre(0, 1, 2, 3, 4, 5));
+}
+
+TEST(Graph, AddEdgesIsAllOrNothing) {
+  Graph<int> g;
+  EXPECT_TRUE(g.AddEdge(0, 1));
+
+  EXPECT_FALSE(g.AddEdges({{1, 2}, {2, 3}, {3, 1}}));
+  EXPECT_FALSE(g.AddEdges({{1, 2}, {2, 2}}));
+  EXPECT_FALSE(g.HasEdge(1, 2));
+  EXPECT_FALSE(g.HasEdge(2, 3));
+  EXPECT_THAT(g.GetDescendantsOf(0), ElementsAre(1));
+
+  // An edge which was already there stays.
+  EXPECT_FALSE(g.AddEdges({{0, 1}, {1, 0}}));
+  EXPECT_TRUE(g.HasEdge(0, 1));
+}
+
+TEST(Graph, DiamondsAreDeduplicated) {
+  Graph<int> g;
+
+  //   1
+  //  / \
+  // 0   3
+  //  \ /
+  //   2
+  g.AddEdge(0, 1);
+  g.AddEdge(0, 2);
+  g.AddEdge(1, 3);
+  g.AddEdge(2, 3);
+
+  const auto descendants = g.GetDescendantsOf(0);
+  EXPECT_THAT(descendants, UnorderedElementsAre(1, 2, 3));
+  EXPECT_THAT(descendants.back(), Eq(3));
+}
+
+TEST(Graph, PlanRecalculationCountsSavings) {
+  Graph<int> g;
+
+  // Every one of 0, 1, 2 feeds every one of 3, 4, 5, which all feed 6.
+  for (int from = 0; from < 3; ++from) {
+    for (int to = 3; to < 6; ++to) {
+      g.AddEdge(from, to);
+    }
+  }
+  for (int from = 3; from < 6; ++from) {
+    g.AddEdge(from, 6);
+  }
+
+  const auto plan = g.PlanRecalculation({0, 1, 2});
+  EXPECT_THAT(plan.nodes, UnorderedElementsAre(3, 4, 5, 6));
+  EXPECT_THAT(plan.nodes.back(), Eq(6));
+  // 3, 4, 5 are reached three times each and 6 is reached three times, so
+  // 12 visits were made for 4 nodes.
+  EXPECT_THAT(plan.saved, Eq(8));
+  EXPECT_THAT(g.RecalculationsSaved(), Eq(8));
+}
+
+TEST(Graph, PlanRecalculationMarksLevels) {
+  Graph<int> g;
+
+  // 0 feeds 1, 2 and 3; 1 and 2 feed 4; 4 feeds 5.
+  g.AddEdge(0, 1);
+  g.AddEdge(0, 2);
+  g.AddEdge(0, 3);
+  g.AddEdge(1, 4);
+  g.AddEdge(2, 4);
+  g.AddEdge(4, 5);
+
+  const auto plan = g.PlanRecalculation({0});
+  ASSERT_THAT(plan.nodes, SizeIs(5));
+  EXPECT_THAT(plan.level_ends, ElementsAre(3, 4, 5));
+  EXPECT_THAT(std::vector<int>(plan.nodes.begin(), plan.nodes.begin() + 3),
+              UnorderedElementsAre(1, 2, 3));
+  EXPECT_THAT(plan.nodes[3], Eq(4));
+  EXPECT_THAT(plan.nodes[4], Eq(5));
+}
+
+TEST(Graph, PlanRecalculationIncludesDescendingRoots) {
+  Graph<int> g;
+  g.AddEdge(0, 1);
+  g.AddEdge(1, 2);
+
+  EXPECT_THAT(g.PlanRecalculation({0, 1}).nodes, ElementsAre(1, 2));
+  EXPECT_THAT(g.PlanRecalculation({1}).nodes, ElementsAre(2));
+}
+
+TEST(Graph, PlanRecalculationWithExtraChildren) {
+  Graph<int> g;
+  g.AddEdge(0, 1);
+  g.AddEdge(2, 3);
+
+  // 1 implicitly feeds 2.
+  const auto extra = [](const int &node, std::vector<int> *children) {
+    if (node == 1) {
+      children->push_back(2);
+    }
+  };
+  EXPECT_THAT(g.PlanRecalculation({0}, extra).nodes, ElementsAre(1, 2, 3));
+  EXPECT_THAT(g.PlanRecalculation({0}).nodes, ElementsAre(1));
+}
+
+TEST(Graph, PlanRecalculationReportsExtraCycles) {
+  Graph<int> g;
+  g.AddEdge(0, 1);
+  g.AddEdge(1, 2);
+
+  const auto extra = [](const int &node, std::vector<int> *children) {
+    if (node == 2) {
+      children->push_back(1);
+    }
+  };
+  const auto plan = g.PlanRecalculation({0}, extra);
+  EXPECT_THAT(plan.nodes, IsEmpty());
+  EXPECT_THAT(plan.cyclic, UnorderedElementsAre(1, 2));
+}
+
+TEST(Graph, PlanRecalculationWideFanOut) {
+  Graph<int> g;
+
+  // Discovering the root's children grows the walk's own maps many times
+  // over while they are being read.
+  const int kWidth = 10000;
+  for (int i = 1; i <= kWidth; ++i) {
+    g.AddEdge(0, i);
+    g.AddEdge(i, kWidth + 1);
+  }
+
+  const auto plan = g.PlanRecalculation({0});
+  EXPECT_THAT(plan.nodes, SizeIs(kWidth + 1));
+  EXPECT_THAT(plan.nodes.back(), Eq(kWidth + 1));
+  EXPECT_THAT(plan.level_ends, ElementsAre(kWidth, kWidth + 1));
+}
+
+TEST(Graph, StackedDiamondsAreCheap) {
+  Graph<int> g;
+
+  // 40 diamonds in a row. An exhaustive path search would visit 2^40 paths.
+  const int kDiamonds = 40;
+  for (int i = 0; i < kDiamonds; ++i) {
+    const int top = 3 * i;
+    g.AddEdge(top, top + 1);
+    g.AddEdge(top, top + 2);
+    g.AddEdge(top + 1, top + 3);
+    g.AddEdge(top + 2, top + 3);
+  }
+
+  EXPECT_FALSE(g.AddEdge(3 * kDiamonds, 0));
+  EXPECT_THAT(g.GetDescendantsOf(0).size(), Eq(3 * kDiamonds));
+  EXPECT_THAT(g.GetDescendantsOf(0).back(), Eq(3 * kDiamonds));
+}
+
+TEST(Graph, LongChainsDontRecurse) {
+  Graph<int> g;
+
+  const int kLength = 200000;
+  for (int i = 0; i < kLength; ++i) {
+    EXPECT_TRUE(g.AddEdge(i, i + 1));
+  }
+
+  EXPECT_FALSE(g.AddEdge(kLength, 0));
+  const auto descendants = g.GetDescendantsOf(0);
+  EXPECT_THAT(descendants.size(), Eq(kLength));
+  EXPECT_THAT(descendants.front(), Eq(1));
+  EXPECT_THAT(descendants.back(), Eq(kLength));
+}
+
 class GraphTest : public ::testing::Test {
 public:
   void SetUp() {
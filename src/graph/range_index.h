@@ -0,0 +1,270 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_GRAPH_RANGE_INDEX_H_
+#define SRC_GRAPH_RANGE_INDEX_H_
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/memory/memory.h"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <random>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace latis {
+namespace graph {
+
+// Indexes rectangular dependencies, so that a range reference costs one entry
+// rather than one edge per cell it covers.
+//
+// Each owner (i.e. the node holding the reference) may have any number of
+// rectangles [x0, x1] x [y0, y1], inclusive. Rectangles live in a segment tree
+// over x, built out only where it is used: each rectangle is split across the
+// O(log X) nodes whose columns it covers outright, and each of those nodes
+// keeps its share in an interval tree over y (a treap keyed on y0, augmented
+// with the largest y1 of each subtree). A stabbing query for (x, y) walks the
+// one path down to column x and asks each interval tree along it for rows
+// spanning y. Everything found contains (x, y), and nothing is found twice, so
+// the query is O(log X * log n) plus O(log n) per owner returned.
+//
+// Not thread-safe.
+template <typename T> //
+class RangeIndex {
+public:
+  RangeIndex() {}
+
+  // Records that |owner| depends on every point in [x0, x1] x [y0, y1].
+  void Insert(const T &owner, int x0, int y0, int x1, int y1) {
+    const Rect rect{std::min(x0, x1), std::max(x0, x1), std::min(y0, y1),
+                    std::max(y0, y1), next_id_++};
+    owners_[owner].push_back(rect);
+    Insert(&root_, kMinX, kMaxX, owner, rect);
+    size_++;
+  }
+
+  // Forgets every rectangle recorded for |owner|.
+  void Erase(const T &owner) {
+    const auto it = owners_.find(owner);
+    if (it == owners_.end()) {
+      return;
+    }
+    for (const Rect &rect : it->second) {
+      Erase(&root_, kMinX, kMaxX, rect);
+      size_--;
+    }
+    owners_.erase(it);
+  }
+
+  // Returns the owner of every rectangle containing (x, y). An owner with
+  // several such rectangles is returned once per rectangle.
+  std::vector<T> Stab(int x, int y) const {
+    std::vector<T> output{};
+    const Column *column = root_.get();
+    int64_t lo = kMinX;
+    int64_t hi = kMaxX;
+    while (column != nullptr) {
+      Stab(column->rows.get(), y, &output);
+      const int64_t mid = Mid(lo, hi);
+      if (x <= mid) {
+        column = column->left.get();
+        hi = mid;
+      } else {
+        column = column->right.get();
+        lo = mid + 1;
+      }
+    }
+    return output;
+  }
+
+  // Returns true if |owner| has any rectangles.
+  bool Contains(const T &owner) const { return owners_.contains(owner); }
+
+  // The number of rectangles in the index.
+  size_t size() const { return size_; }
+
+private:
+  static constexpr int64_t kMinX = std::numeric_limits<int>::min();
+  static constexpr int64_t kMaxX = std::numeric_limits<int>::max();
+
+  struct Rect {
+    int x0;
+    int x1;
+    int y0;
+    int y1;
+    uint64_t id;
+  };
+
+  // (y0, id). Unique per rectangle within a column.
+  using Key = std::tuple<int, uint64_t>;
+
+  // One rectangle's share of a Column.
+  struct Row {
+    int y0;
+    int y1;
+    T owner;
+    uint64_t id;
+    uint32_t priority;
+    // The largest y1 in this subtree.
+    int max_y1;
+    std::unique_ptr<Row> left;
+    std::unique_ptr<Row> right;
+  };
+
+  // A node of the segment tree over x, i.e. a span of columns.
+  struct Column {
+    // The rectangles covering every column of this span, but not of its
+    // parent's.
+    std::unique_ptr<Row> rows;
+    std::unique_ptr<Column> left;
+    std::unique_ptr<Column> right;
+  };
+
+  static int64_t Mid(int64_t lo, int64_t hi) { return lo + (hi - lo) / 2; }
+
+  void Insert(std::unique_ptr<Column> *column, int64_t lo, int64_t hi,
+              const T &owner, const Rect &rect) {
+    if (*column == nullptr) {
+      *column = absl::make_unique<Column>();
+    }
+    if (rect.x0 <= lo && hi <= rect.x1) {
+      auto row = absl::make_unique<Row>();
+      row->y0 = rect.y0;
+      row->y1 = rect.y1;
+      row->owner = owner;
+      row->id = rect.id;
+      row->priority = rng_();
+      row->max_y1 = rect.y1;
+      auto [lhs, rhs] = Split(std::move((*column)->rows), KeyOf(*row));
+      (*column)->rows =
+          Merge(Merge(std::move(lhs), std::move(row)), std::move(rhs));
+      return;
+    }
+    const int64_t mid = Mid(lo, hi);
+    if (rect.x0 <= mid) {
+      Insert(&(*column)->left, lo, mid, owner, rect);
+    }
+    if (rect.x1 > mid) {
+      Insert(&(*column)->right, mid + 1, hi, owner, rect);
+    }
+  }
+
+  // Undoes Insert(), and drops any spans of columns left with nothing in or
+  // under them.
+  static void Erase(std::unique_ptr<Column> *column, int64_t lo, int64_t hi,
+                    const Rect &rect) {
+    if (*column == nullptr) {
+      return;
+    }
+    if (rect.x0 <= lo && hi <= rect.x1) {
+      const Key key{rect.y0, rect.id};
+      auto [lhs, rest] = Split(std::move((*column)->rows), key);
+      auto [mid, rhs] =
+          Split(std::move(rest), Key{std::get<0>(key), std::get<1>(key) + 1});
+      (*column)->rows = Merge(std::move(lhs), std::move(rhs));
+    } else {
+      const int64_t mid = Mid(lo, hi);
+      if (rect.x0 <= mid) {
+        Erase(&(*column)->left, lo, mid, rect);
+      }
+      if (rect.x1 > mid) {
+        Erase(&(*column)->right, mid + 1, hi, rect);
+      }
+    }
+    if ((*column)->rows == nullptr && (*column)->left == nullptr &&
+        (*column)->right == nullptr) {
+      column->reset();
+    }
+  }
+
+  static Key KeyOf(const Row &row) { return Key{row.y0, row.id}; }
+
+  static void Pull(Row *row) {
+    row->max_y1 = row->y1;
+    if (row->left != nullptr) {
+      row->max_y1 = std::max(row->max_y1, row->left->max_y1);
+    }
+    if (row->right != nullptr) {
+      row->max_y1 = std::max(row->max_y1, row->right->max_y1);
+    }
+  }
+
+  // Splits |row| into the rows keyed below |key|, and the rest.
+  static std::pair<std::unique_ptr<Row>, std::unique_ptr<Row>>
+  Split(std::unique_ptr<Row> row, const Key &key) {
+    if (row == nullptr) {
+      return {nullptr, nullptr};
+    }
+    if (KeyOf(*row) < key) {
+      auto [lhs, rhs] = Split(std::move(row->right), key);
+      row->right = std::move(lhs);
+      Pull(row.get());
+      return {std::move(row), std::move(rhs)};
+    }
+    auto [lhs, rhs] = Split(std::move(row->left), key);
+    row->left = std::move(rhs);
+    Pull(row.get());
+    return {std::move(lhs), std::move(row)};
+  }
+
+  // Joins two treaps, where every key in |lhs| is below every key in |rhs|.
+  static std::unique_ptr<Row> Merge(std::unique_ptr<Row> lhs,
+                                    std::unique_ptr<Row> rhs) {
+    if (lhs == nullptr) {
+      return rhs;
+    }
+    if (rhs == nullptr) {
+      return lhs;
+    }
+    if (lhs->priority > rhs->priority) {
+      lhs->right = Merge(std::move(lhs->right), std::move(rhs));
+      Pull(lhs.get());
+      return lhs;
+    }
+    rhs->left = Merge(std::move(lhs), std::move(rhs->left));
+    Pull(rhs.get());
+    return rhs;
+  }
+
+  static void Stab(const Row *row, int y, std::vector<T> *output) {
+    if (row == nullptr || row->max_y1 < y) {
+      return;
+    }
+    Stab(row->left.get(), y, output);
+    if (y < row->y0) {
+      // Everything to the right starts even further along.
+      return;
+    }
+    if (y <= row->y1) {
+      output->push_back(row->owner);
+    }
+    Stab(row->right.get(), y, output);
+  }
+
+  std::unique_ptr<Column> root_;
+  absl::flat_hash_map<T, std::vector<Rect>> owners_;
+  size_t size_{0};
+  uint64_t next_id_{0};
+  std::mt19937 rng_{0};
+};
+
+} // namespace graph
+} // namespace latis
+
+#endif // SRC_GRAPH_RANGE_INDEX_H_
@@ -0,0 +1,151 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/graph/range_index.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace latis {
+namespace graph {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+using ::testing::UnorderedElementsAre;
+using ::testing::UnorderedElementsAreArray;
+
+TEST(RangeIndex, Empty) {
+  RangeIndex<int> index;
+  EXPECT_THAT(index.Stab(0, 0), IsEmpty());
+  EXPECT_EQ(index.size(), 0);
+}
+
+TEST(RangeIndex, StabsRectangles) {
+  RangeIndex<int> index;
+  index.Insert(1, 0, 0, 0, 99999); // A1:A100000
+  index.Insert(2, 0, 0, 5, 5);
+  index.Insert(3, 3, 3, 10, 10);
+
+  EXPECT_THAT(index.Stab(0, 50000), ElementsAre(1));
+  EXPECT_THAT(index.Stab(0, 0), UnorderedElementsAre(1, 2));
+  EXPECT_THAT(index.Stab(4, 4), UnorderedElementsAre(2, 3));
+  EXPECT_THAT(index.Stab(10, 10), ElementsAre(3));
+  EXPECT_THAT(index.Stab(11, 10), IsEmpty());
+  EXPECT_THAT(index.Stab(1, 6), IsEmpty());
+}
+
+TEST(RangeIndex, NormalizesCorners) {
+  RangeIndex<int> index;
+  index.Insert(1, 5, 5, 0, 0);
+  EXPECT_THAT(index.Stab(2, 3), ElementsAre(1));
+}
+
+TEST(RangeIndex, EraseRemovesEveryRectangleOfOwner) {
+  RangeIndex<int> index;
+  index.Insert(1, 0, 0, 1, 1);
+  index.Insert(1, 5, 5, 6, 6);
+  index.Insert(2, 0, 0, 6, 6);
+  EXPECT_EQ(index.size(), 3);
+  EXPECT_TRUE(index.Contains(1));
+
+  index.Erase(1);
+  EXPECT_EQ(index.size(), 1);
+  EXPECT_FALSE(index.Contains(1));
+  EXPECT_THAT(index.Stab(0, 0), ElementsAre(2));
+  EXPECT_THAT(index.Stab(5, 5), ElementsAre(2));
+
+  // Erasing twice is fine.
+  index.Erase(1);
+  EXPECT_EQ(index.size(), 1);
+}
+
+TEST(RangeIndex, ManyRectangles) {
+  RangeIndex<int> index;
+
+  // One column-wide rectangle per column.
+  const int kColumns = 10000;
+  for (int x = 0; x < kColumns; ++x) {
+    index.Insert(x, x, 0, x, 1000);
+  }
+  for (int x = 0; x < kColumns; x += 997) {
+    EXPECT_THAT(index.Stab(x, 500), ElementsAre(x));
+  }
+  for (int x = 0; x < kColumns; x += 2) {
+    index.Erase(x);
+  }
+  EXPECT_EQ(index.size(), kColumns / 2);
+  EXPECT_THAT(index.Stab(2, 500), IsEmpty());
+  EXPECT_THAT(index.Stab(3, 500), ElementsAre(3));
+}
+
+TEST(RangeIndex, RowsWithinAColumn) {
+  RangeIndex<int> index;
+
+  // SUM(Bi:Di) in every row, the usual layout for a column of totals.
+  const int kRows = 10000;
+  for (int y = 0; y < kRows; ++y) {
+    index.Insert(y, 1, y, 3, y);
+  }
+  for (int y = 0; y < kRows; y += 997) {
+    EXPECT_THAT(index.Stab(1, y), ElementsAre(y));
+    EXPECT_THAT(index.Stab(3, y), ElementsAre(y));
+    EXPECT_THAT(index.Stab(4, y), IsEmpty());
+  }
+}
+
+TEST(RangeIndex, MatchesBruteForce) {
+  struct Rect {
+    int owner, x0, y0, x1, y1;
+  };
+  std::mt19937 rng(7);
+  const auto coord = [&rng] { return static_cast<int>(rng() % 40) - 5; };
+
+  RangeIndex<int> index;
+  std::vector<Rect> rects;
+  for (int i = 0; i < 500; ++i) {
+    const Rect rect{i % 200, coord(), coord(), coord(), coord()};
+    rects.push_back(rect);
+    index.Insert(rect.owner, rect.x0, rect.y0, rect.x1, rect.y1);
+  }
+  for (int owner = 0; owner < 200; owner += 3) {
+    index.Erase(owner);
+  }
+  rects.erase(std::remove_if(rects.begin(), rects.end(),
+                             [](const Rect &r) { return r.owner % 3 == 0; }),
+              rects.end());
+  EXPECT_EQ(index.size(), rects.size());
+
+  for (int x = -6; x < 36; ++x) {
+    for (int y = -6; y < 36; ++y) {
+      std::vector<int> expected;
+      for (const Rect &r : rects) {
+        if (std::min(r.x0, r.x1) <= x && x <= std::max(r.x0, r.x1) &&
+            std::min(r.y0, r.y1) <= y && y <= std::max(r.y0, r.y1)) {
+          expected.push_back(r.owner);
+        }
+      }
+      EXPECT_THAT(index.Stab(x, y), UnorderedElementsAreArray(expected))
+          << x << ", " << y;
+    }
+  }
+}
+
+} // namespace
+} // namespace graph
+} // namespace latis
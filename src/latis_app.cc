@@ -33,6 +33,14 @@ LatisApp::LatisApp(LatisMsg msg)
   Layout();
 
   app_->RegisterResizeCallback([this]() -> void { Layout(); });
+
+  // Recalculation happens off the UI thread; its results are shown a frame
+  // at a time.
+  ssheet_->SetRecalculation(SSheet::Recalculation::kBackground);
+  app_->RegisterTickCallback([this]() -> void {
+    ssheet_->Poll();
+    ShowStatus();
+  });
 }
 
 void LatisApp::Run() { app_->Run(); }
@@ -52,13 +60,15 @@ void LatisApp::Layout() {
   const auto default_dims = ui::Dimensions{5, 5, 0, 0};
 
   auto dims_title =
-      layout_engine.Place(/*h=*/3, /*w=*/x / 4).value_or(default_dims);
+      layout_engine.Place(/*h=*/3, /*w=*/x / 5).value_or(default_dims);
   auto dims_author =
-      layout_engine.Place(/*h=*/3, /*w=*/x / 4).value_or(default_dims);
+      layout_engine.Place(/*h=*/3, /*w=*/x / 5).value_or(default_dims);
   auto dims_created =
-      layout_engine.Place(/*h=*/3, /*w=*/x / 4).value_or(default_dims);
+      layout_engine.Place(/*h=*/3, /*w=*/x / 5).value_or(default_dims);
   auto dims_edited =
-      layout_engine.Place(/*h=*/3, /*w=*/x / 4).value_or(default_dims);
+      layout_engine.Place(/*h=*/3, /*w=*/x / 5).value_or(default_dims);
+  auto dims_status =
+      layout_engine.Place(/*h=*/3, /*w=*/x / 5).value_or(default_dims);
 
   app_->Add<ui::TextWidget>(dims_title)
       ->WithTemplate(
@@ -92,46 +102,60 @@ void LatisApp::Layout() {
         absl::StrFormat("Date Edited: %s", absl::FormatTime(t)));
   });
 
+  status_ = app_->Add<ui::TextWidget>(dims_status);
+  ShowStatus();
+
   auto dims_gridbox = layout_engine.FillRest().value();
 
   auto gridbox_ptr = app_->Add<ui::GridWidget>(dims_gridbox);
   assert(gridbox_ptr != nullptr);
 
-  for (int y = 0; y <= ssheet_->Height(); ++y) {
-    for (int x = 0; x <= ssheet_->Width(); ++x) {
-      auto xy = XY(x, y);
-      const auto amt = ssheet_->Get(xy);
-      if (!amt.ok()) {
-        continue;
-      }
-      auto w = gridbox_ptr->AddCell<ui::TextWidget>(y, x);
-      if (w == nullptr) {
-        continue;
-      }
-      w->WithCb([this, xy](absl::string_view s) -> absl::optional<std::string> {
-        const auto maybe_amt = ssheet_->Set(xy, s);
+  // Only the cells on-screen are ever read.
+  gridbox_ptr
+      ->WithEditCb([this](int y, int x, absl::string_view s)
+                       -> absl::optional<std::string> {
+        const auto maybe_amt = ssheet_->Set(XY(x, y), s);
         if (!maybe_amt.ok()) {
           return absl::nullopt;
         }
         return PrintAmount(maybe_amt.ValueOrDie());
+      })
+      ->WithContent([this](int y, int x) -> std::string {
+        const auto amt = ssheet_->Get(XY(x, y));
+        if (!amt.ok()) {
+          return "";
+        }
+        return PrintAmount(amt.ValueOrDie());
+      })
+      ->WithEdgeFn([this](int y, int x, int dy, int dx) {
+        const XY edge = ssheet_->DataEdge(XY(x, y), dx, dy);
+        return std::make_pair(edge.Y(), edge.X());
       });
-      w->UpdateUnderlyingContent(PrintAmount(amt.ValueOrDie()));
-    }
-  }
   gridbox_ptr->SetActive(0, 0);
 
-  // promulgate updates
-  ssheet_->RegisterCallback([gridbox_ptr](const Cell &cell) -> void {
-    if (cell.formula().has_cached_amount()) {
-      auto w = gridbox_ptr->Get<ui::TextWidget>(cell.point_location().col(),
-                                                cell.point_location().row());
-      if (w != nullptr) {
-        w->UpdateDisplayContent(PrintAmount(cell.formula().cached_amount()));
-      }
-    }
-  });
+  // promulgate updates, once per change set. Off-screen cells are skipped, and
+  // on-screen ones are drawn at the next Window::Flush().
+  ssheet_->RegisterChangeSetCallback(
+      [this, gridbox_ptr](const ChangeSet &changes) -> void {
+        for (const XY &xy : changes.cells) {
+          auto w = gridbox_ptr->Get(xy.Y(), xy.X());
+          if (w == nullptr) {
+            continue;
+          }
+          if (const auto amt = ssheet_->Get(xy); amt.ok()) {
+            w->UpdateDisplayContent(PrintAmount(amt.ValueOrDie()));
+          }
+        }
+      });
 
   ui::Debug(absl::StrFormat("\tDone laying out: %dx%d", y, x));
 }
 
+void LatisApp::ShowStatus() {
+  const size_t backlog = ssheet_->Backlog();
+  status_->UpdateUnderlyingContent(
+      backlog == 0 ? "Up to date"
+                   : absl::StrFormat("Recalculating: %d left", backlog));
+}
+
 } // namespace latis
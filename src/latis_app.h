@@ -20,6 +20,7 @@
 #include "src/ssheet_impl.h"
 #include "src/ui/app.h"
 #include "src/ui/common.h"
+#include "src/ui/textwidget.h"
 
 namespace latis {
 
@@ -30,11 +31,18 @@ public:
 
   void Run();
 
+  // Writes out the sheet as it stands.
+  void WriteTo(LatisMsg *msg) const { ssheet_->WriteTo(msg); }
+
 private:
   void Layout();
 
+  // Shows whether the sheet is still being recalculated.
+  void ShowStatus();
+
   std::unique_ptr<SSheet> ssheet_;
   std::unique_ptr<ui::App> app_;
+  std::shared_ptr<ui::TextWidget> status_;
 };
 
 } // namespace latis
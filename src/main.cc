@@ -20,9 +20,13 @@
 #include "absl/flags/flag.h"
 #include "absl/flags/parse.h"
 #include "absl/strings/escaping.h"
+#include "absl/strings/match.h"
 
-ABSL_FLAG(std::string, textproto_input, "", "Path to input textproto");
+ABSL_FLAG(std::string, textproto_input, "",
+          "Path to input file, either a textproto or a binary .latis file");
 ABSL_FLAG(std::string, input, "", "Input textproto");
+ABSL_FLAG(std::string, output, "",
+          "Path to save to on exit; binary unless it ends in .textproto");
 
 int main(int argc, char *argv[]) {
   absl::ParseCommandLine(argc, argv);
@@ -31,7 +35,7 @@ int main(int argc, char *argv[]) {
 
   if (const auto path = absl::GetFlag(FLAGS_textproto_input); !path.empty()) {
     // If --textproto_input is set, read a file and load it in.
-    auto msg = latis::FromTextproto<LatisMsg>(path).ValueOrDie();
+    auto msg = latis::FromFile<LatisMsg>(path).ValueOrDie();
     latis_app = absl::make_unique<latis::LatisApp>(msg);
   } else if (const auto input = absl::GetFlag(FLAGS_input); !input.empty()) {
     std::string dest;
@@ -44,5 +48,17 @@ int main(int argc, char *argv[]) {
 
   latis_app->Run();
 
+  if (const auto path = absl::GetFlag(FLAGS_output); !path.empty()) {
+    LatisMsg msg;
+    latis_app->WriteTo(&msg);
+    const auto format = absl::EndsWith(path, ".textproto")
+                            ? latis::FileFormat::kTextproto
+                            : latis::FileFormat::kBinary;
+    if (const auto status = latis::ToFile(msg, path, format); !status.ok()) {
+      std::cerr << status << std::endl;
+      return 1;
+    }
+  }
+
   return 0;
 }
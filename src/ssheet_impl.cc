@@ -15,10 +15,10 @@
 #include "src/ssheet_impl.h"
 
 #include "src/display_utils.h"
-#include "src/formula/evaluator.h"
 #include "src/utils/status_macros.h"
 
 #include "absl/memory/memory.h"
+#include "absl/types/span.h"
 
 namespace latis {
 
@@ -27,6 +27,90 @@ using ::google::protobuf::util::StatusOr;
 using ::google::protobuf::util::error::INVALID_ARGUMENT;
 using ::google::protobuf::util::error::OK;
 
+namespace {
+
+// Levels, or batches, narrower than this aren't worth handing out to the
+// thread pool.
+constexpr size_t kMinParallelLevel = 256;
+
+// The value or error at |xy| in |cells|.
+StatusOr<Amount> ValueAt(const storage::TileStore &cells, XY xy) {
+  const auto maybe_formula = cells.GetValue(xy);
+  if (!maybe_formula.has_value()) {
+    return Status(INVALID_ARGUMENT,
+                  absl::StrFormat("No cell at %s", xy.ToA1()));
+  }
+  const Formula &formula = maybe_formula.value();
+  if (formula.has_error_msg()) {
+    return Status(INVALID_ARGUMENT, formula.error_msg());
+  }
+  return formula.cached_amount();
+}
+
+} // namespace
+
+class SSheet::Operation {
+public:
+  enum Access {
+    // Only reads cached values, alongside any other kRead.
+    kRead,
+    // Writes, or recalculates, and so has the sheet to itself.
+    kWrite,
+  };
+
+  explicit Operation(const SSheet *sheet, Access access = kWrite)
+      : sheet_(sheet), access_(access) {
+    // NB: A read only has to tell the background thread it's waiting if
+    // something holds the sheet exclusively, which it may be; otherwise it
+    // gets in without touching |waiting_|, which every reader would share.
+    if (access_ == kRead && sheet_->mu_.ReaderTryLock()) {
+      return;
+    }
+    sheet_->waiting_.fetch_add(1, std::memory_order_relaxed);
+    counted_ = true;
+    if (access_ == kRead) {
+      sheet_->mu_.ReaderLock();
+    } else {
+      sheet_->mu_.Lock();
+    }
+  }
+
+  ~Operation() {
+    if (access_ == kRead) {
+      if (counted_) {
+        sheet_->waiting_.fetch_sub(1, std::memory_order_relaxed);
+      }
+      sheet_->mu_.ReaderUnlock();
+      return;
+    }
+
+    ChangeSet changes;
+    std::swap(changes, sheet_->changes_);
+    // NB: Only ever filled in if there is a callback.
+    const ChangeSetCb change_set_cb =
+        changes.cells.empty() ? nullptr : sheet_->change_set_cb_.value();
+    sheet_->backlog_.store(sheet_->dirty_.size(), std::memory_order_relaxed);
+    // NB: Under the lock, so that the background thread sees it as soon as it
+    // is unlocked.
+    sheet_->waiting_.fetch_sub(1, std::memory_order_relaxed);
+    sheet_->mu_.Unlock();
+
+    // Outside the lock, so the callback can read the sheet.
+    if (change_set_cb != nullptr) {
+      change_set_cb(changes);
+    }
+  }
+
+  Operation(const Operation &) = delete;
+  Operation &operator=(const Operation &) = delete;
+
+private:
+  const SSheet *sheet_;
+  const Access access_;
+  // Whether this counts towards |waiting_|. Always, for a kWrite.
+  bool counted_{false};
+};
+
 SSheet::SSheet() : SSheet(LatisMsg()) {}
 
 SSheet::SSheet(const LatisMsg &sheet)
@@ -45,39 +129,144 @@ SSheet::SSheet(const LatisMsg &sheet)
               ? absl::FromUnixSeconds(sheet.metadata().edited_time().seconds())
               : absl::Now()) {
   for (const auto &cell : sheet.cells()) {
-    cells_[XY::From(cell.point_location())] = cell;
+    cells_.Set(XY::From(cell.point_location()), cell);
+  }
+  absl::MutexLock lock(&mu_);
+  Link(sheet);
+}
+
+SSheet::~SSheet() {
+  if (worker_.joinable()) {
+    StopBackground();
   }
 }
 
 StatusOr<Amount> SSheet::Get(XY xy) const {
-  const auto it = cells_.find(xy);
-  if (it == cells_.end()) {
-    return Status(INVALID_ARGUMENT,
-                  absl::StrFormat("No cell at %s", xy.ToA1()));
+  {
+    Operation op(this, Operation::kRead);
+    if (recalculation_ != Recalculation::kLazy || !dirty_.contains(xy)) {
+      return GetCached(xy);
+    }
   }
-  const auto &formula = it->second.formula();
-  if (formula.has_error_msg()) {
-    return Status(INVALID_ARGUMENT, formula.error_msg());
+  // NB: Someone else may have got to it in between, in which case this is a
+  // no-op.
+  Operation op(this);
+  Resolve(xy);
+  return GetCached(xy);
+}
+
+StatusOr<Amount> SSheet::GetCached(XY xy) const {
+  return ValueAt(cells_, xy);
+}
+
+int SSheet::Height() const {
+  Operation op(this, Operation::kRead);
+  return std::max(0, cells_.occupancy().MaxY().value_or(0));
+}
+
+int SSheet::Width() const {
+  Operation op(this, Operation::kRead);
+  return std::max(0, cells_.occupancy().MaxX().value_or(0));
+}
+
+XY SSheet::DataEdge(XY from, int dx, int dy) const {
+  Operation op(this, Operation::kRead);
+  const int height = std::max(0, cells_.occupancy().MaxY().value_or(0));
+  const int width = std::max(0, cells_.occupancy().MaxX().value_or(0));
+  const auto step = [dx, dy](XY xy, int n) {
+    return XY(xy.X() + (n * dx), xy.Y() + (n * dy));
+  };
+  // How many steps |xy| is from the edge of the sheet, if it's on it at all.
+  const auto room = [dx, dy, height, width](XY xy) {
+    if (xy.X() < 0 || xy.Y() < 0 || xy.X() > width || xy.Y() > height) {
+      return 0;
+    }
+    return dx > 0   ? width - xy.X()
+           : dx < 0 ? xy.X()
+           : dy > 0 ? height - xy.Y()
+                    : xy.Y();
+  };
+
+  const XY curr = step(from, 1);
+  if (curr.X() < 0 || curr.Y() < 0) {
+    return from;
   }
-  return formula.cached_amount();
+
+  // From inside a run, go to its far end.
+  if (cells_.Contains(from) && cells_.Contains(curr)) {
+    const int run =
+        cells_.RunLength(curr, dx, dy, /*occupied=*/true, room(curr) + 1);
+    return step(curr, run - 1);
+  }
+
+  // Otherwise, go to the start of the next run.
+  const int gap =
+      cells_.RunLength(curr, dx, dy, /*occupied=*/false, room(curr) + 1);
+  return step(curr, std::min(gap, room(curr)));
 }
 
 StatusOr<Amount> SSheet::Set(XY xy, std::string_view input) {
-  // Evaluate and store lookups.
+  Operation op(this);
+
+  Expression expression;
+  ASSIGN_OR_RETURN_(expression, formula::ParseExpression(input));
+
+  // Evaluate and store lookups. Literals read nothing, and aren't worth
+  // keeping a program for; ProgramFor() compiles one should it ever be needed.
   absl::flat_hash_set<XY> looked_up{};
+  absl::optional<formula::Program> program;
+  Amount amount;
+  if (expression.has_value()) {
+    amount = expression.value();
+  } else {
+    program = formula::Program::Compile(expression);
+    // Getter with logging cb.
+    formula::ValueLookupFn lookup_fn =
+        [&](XY xy) -> absl::optional<formula::Value> {
+      Resolve(xy);
+      const auto maybe_value = cells_.Lookup(xy);
+      if (maybe_value.has_value()) {
+        looked_up.insert(xy);
+      }
+      return maybe_value;
+    };
+    ASSIGN_OR_RETURN_(amount, program->Run(lookup_fn));
+  }
 
-  // Getter with logging cb.
-  LookupFn lookup_fn = [&](XY xy) -> absl::optional<Amount> {
-    if (const auto maybe = Get(xy); maybe.ok()) {
-      looked_up.insert(xy);
-      return maybe.ValueOrDie();
-    }
-    return absl::nullopt;
+  // Cells covered by a range are tracked as part of that range rather than
+  // with an edge each.
+  const std::vector<XYRange> ranges =
+      program.has_value() ? program->ranges() : std::vector<XYRange>{};
+  const auto in_ranges = [&ranges](XY cell) {
+    return std::any_of(ranges.begin(), ranges.end(),
+                       [cell](const XYRange &r) { return r.Contains(cell); });
   };
+  for (auto it = looked_up.begin(); it != looked_up.end();) {
+    if (in_ranges(*it)) {
+      looked_up.erase(it++);
+    } else {
+      ++it;
+    }
+  }
 
-  // Compute amount.
-  std::tuple<Expression, Amount> expression_and_amount;
-  ASSIGN_OR_RETURN_(expression_and_amount, formula::Parse(input, lookup_fn));
+  // Everything downstream of xy. Only edges into xy change below, and none of
+  // them can be reached from xy without a cycle, so this is also the plan to
+  // recalculate by afterwards.
+  const graph::Graph<XY>::Plan plan = PlanRecalculation({xy});
+
+  // |graph_| can only catch cycles made of direct references, so check the
+  // rest against everything downstream of xy.
+  if (!ranges.empty() || ranges_.size() > 0) {
+    bool is_cycle = in_ranges(xy);
+    for (const XY &descendant : plan.nodes) {
+      is_cycle |= looked_up.contains(descendant) || in_ranges(descendant);
+    }
+    if (is_cycle) {
+      return Status(INVALID_ARGUMENT,
+                    absl::StrFormat("Can't insert %s, it would cause a cycle.",
+                                    xy.ToA1()));
+    }
+  }
 
   // Remove old edges from old ancestors to xy.
   for (const XY &parent : graph_.GetParentsOf(xy)) {
@@ -100,32 +289,211 @@ StatusOr<Amount> SSheet::Set(XY xy, std::string_view input) {
     // Complete transaction.
   }
 
-  // Construct new cell in-place.
-  Cell *c = &cells_[xy];
-  *c->mutable_point_location() = xy.ToPointLocation();
-  *c->mutable_formula()->mutable_expression() =
-      std::get<0>(expression_and_amount);
-  *c->mutable_formula()->mutable_cached_amount() =
-      std::get<1>(expression_and_amount);
+  IndexRanges(xy, ranges);
 
-  for (const XY &descendant : graph_.GetDescendantsOf(xy)) {
-    Update(descendant);
+  // Store new cell.
+  Cell c;
+  *c.mutable_formula()->mutable_expression() = std::move(expression);
+  *c.mutable_formula()->mutable_cached_amount() = amount;
+  cells_.Set(xy, c);
+  if (program.has_value()) {
+    programs_[xy] = std::move(program).value();
+  } else {
+    programs_.erase(xy);
   }
+  dirty_.erase(xy);
+
+  Recalculate(plan);
 
   UpdateEditTime();
 
-  return std::get<1>(expression_and_amount);
+  return amount;
 }
 
-void SSheet::Clear(XY xy) {
-  cells_.erase(xy);
-  for (const XY &descendant : graph_.Delete(xy)) {
-    Update(descendant);
+Status SSheet::SetBatch(
+    absl::Span<const std::pair<XY, std::string_view>> batch) {
+  // Parse everything before touching the sheet, so that a bad input leaves it
+  // as it was. Later entries for the same cell win.
+  // NB: Before the Operation, so that readers and the background thread carry
+  // on meanwhile; hence |parse_pool_| rather than |pool_|.
+  std::vector<std::string_view> inputs;
+  inputs.reserve(batch.size());
+  for (const auto &[xy, input] : batch) {
+    inputs.push_back(input);
+  }
+  std::vector<StatusOr<Expression>> parsed;
+  if (num_threads_ > 1 && batch.size() >= kMinParallelLevel) {
+    absl::MutexLock lock(&parse_mu_);
+    if (parse_pool_ == nullptr) {
+      parse_pool_ = absl::make_unique<ThreadPool>(num_threads_ - 1);
+    }
+    parsed = formula::ParseMany(inputs, parse_pool_.get());
+  } else {
+    parsed = formula::ParseMany(inputs, nullptr);
   }
+
+  std::vector<XY> cells;
+  absl::flat_hash_map<XY, Expression> expressions;
+  for (size_t i = 0; i < batch.size(); ++i) {
+    const XY xy = batch[i].first;
+    if (!parsed[i].ok()) {
+      return Status(INVALID_ARGUMENT,
+                    absl::StrFormat("Can't parse %s: %s", xy.ToA1(),
+                                    parsed[i].status().error_message()));
+    }
+    if (!expressions.contains(xy)) {
+      cells.push_back(xy);
+    }
+    expressions[xy] = parsed[i].ValueOrDie();
+  }
+
+  Operation op(this);
+
+  // Once per cell, for the entry which won. As in Link(), literals read
+  // nothing, and aren't worth keeping a program for.
+  std::vector<formula::Program> programs(cells.size());
+  const auto compile = [&](size_t i) {
+    const Expression &expression = expressions.at(cells[i]);
+    if (!expression.has_value()) {
+      programs[i] = formula::Program::Compile(expression);
+    }
+  };
+  if (num_threads_ == 1 || cells.size() < kMinParallelLevel) {
+    for (size_t i = 0; i < cells.size(); ++i) {
+      compile(i);
+    }
+  } else {
+    if (pool_ == nullptr) {
+      pool_ = absl::make_unique<ThreadPool>(num_threads_ - 1);
+    }
+    pool_->ParallelFor(cells.size(), compile);
+  }
+
+  // Swap every cell's old edges and ranges for its new ones, all at once, so
+  // that cells of the batch can refer to one another: every old edge goes
+  // before any new one comes in, lest a new edge close a cycle with one the
+  // batch is replacing. Ranges are indexed rather than being edges, so
+  // |graph_| alone can't catch every cycle; but any cycle would have to pass
+  // through the batch, and so shows up when planning from it.
+  std::vector<std::pair<XY, XY>> removed;
+  for (const XY &xy : cells) {
+    for (const XY &parent : graph_.GetParentsOf(xy)) {
+      graph_.RemoveEdge(parent, xy);
+      removed.emplace_back(parent, xy);
+    }
+  }
+  std::vector<std::pair<XY, XY>> added;
+  bool is_cycle = false;
+  for (size_t i = 0; i < cells.size(); ++i) {
+    const XY xy = cells[i];
+    const formula::Program &program = programs[i];
+    IndexRanges(xy, program.ranges());
+    for (const XY &cell : program.cells()) {
+      if (std::any_of(
+              program.ranges().begin(), program.ranges().end(),
+              [cell](const XYRange &r) { return r.Contains(cell); })) {
+        continue;
+      }
+      if (!graph_.AddEdge(cell, xy)) {
+        is_cycle = true;
+        break;
+      }
+      added.emplace_back(cell, xy);
+    }
+    if (is_cycle) {
+      break;
+    }
+  }
+  const auto plan = PlanRecalculation(cells);
+  if (is_cycle || !plan.cyclic.empty()) {
+    for (const auto &[from, to] : added) {
+      graph_.RemoveEdge(from, to);
+    }
+    // NB: Not ProgramFor(), which would compile and keep an empty program
+    // for each cell new to the sheet.
+    for (const XY &xy : cells) {
+      if (const auto it = programs_.find(xy); it != programs_.end()) {
+        IndexRanges(xy, it->second.ranges());
+      } else {
+        ranges_.Erase(xy);
+      }
+    }
+    for (const auto &[from, to] : removed) {
+      graph_.AddEdge(from, to);
+    }
+    return Status(INVALID_ARGUMENT,
+                  "Can't insert the batch, it would cause a cycle.");
+  }
+
+  // Literals read nothing, so can be stored as they are. Of the rest, those
+  // which don't read anything else in the batch are calculated first; |plan|
+  // has everything downstream of them, including the rest of the batch.
+  absl::flat_hash_set<XY> planned(plan.nodes.begin(), plan.nodes.end());
+  std::vector<XY> roots;
+  for (size_t i = 0; i < cells.size(); ++i) {
+    const XY xy = cells[i];
+    const Expression &expression = expressions.at(xy);
+    Cell c;
+    *c.mutable_formula()->mutable_expression() = expression;
+    cells_.Set(xy, c);
+    if (expression.has_value()) {
+      programs_.erase(xy);
+      Store(xy, expression.value());
+    } else {
+      programs_[xy] = std::move(programs[i]);
+      dirty_.insert(xy);
+      if (!planned.contains(xy)) {
+        roots.push_back(xy);
+      }
+    }
+  }
+  for (const XY &xy : roots) {
+    Resolve(xy);
+  }
+  Recalculate(plan);
+
+  UpdateEditTime();
+
+  return Status();
+}
+
+void SSheet::Clear(XY xy) {
+  Operation op(this);
+  const auto plan = PlanRecalculation({xy});
+  cells_.Erase(xy);
+  programs_.erase(xy);
+  dirty_.erase(xy);
+  ranges_.Erase(xy);
+  graph_.Delete(xy);
+  Recalculate(plan);
   UpdateEditTime();
 }
 
 Status SSheet::WriteTo(LatisMsg *latis_msg) const {
+  return TakeSnapshot().WriteTo(latis_msg);
+}
+
+SSheet::Snapshot SSheet::TakeSnapshot() const {
+  {
+    Operation op(this, Operation::kRead);
+    if (dirty_.empty()) {
+      return Snapshot(*this);
+    }
+  }
+  Operation op(this);
+  ResolveAll();
+  return Snapshot(*this);
+}
+
+SSheet::Snapshot::Snapshot(const SSheet &sheet)
+    : cells_(sheet.cells_), title_(sheet.title_), author_(sheet.author_),
+      created_time_(sheet.created_time_), edited_time_(sheet.edited_time_) {}
+
+StatusOr<Amount> SSheet::Snapshot::Get(XY xy) const {
+  return ValueAt(cells_, xy);
+}
+
+Status SSheet::Snapshot::WriteTo(LatisMsg *latis_msg) const {
   if (title_.has_value()) {
     latis_msg->mutable_metadata()->set_title(title_.value());
   }
@@ -137,43 +505,341 @@ Status SSheet::WriteTo(LatisMsg *latis_msg) const {
   latis_msg->mutable_metadata()->mutable_edited_time()->set_seconds(
       absl::ToUnixSeconds(edited_time_));
 
-  for (const auto &[pt, cell] : cells_) {
-    *latis_msg->add_cells() = cell;
-  }
+  cells_.ForEach(
+      [&](XY, const Cell &cell) { *latis_msg->add_cells() = cell; });
 
   return Status(OK, "");
 }
 
-void SSheet::Update(XY xy) {
-  LookupFn lookup_fn = [&](XY xy) -> absl::optional<Amount> {
-    if (const auto maybe = Get(xy); maybe.ok()) {
-      return maybe.ValueOrDie();
+void SSheet::SetRecalculation(Recalculation recalculation) {
+  if (worker_.joinable() && recalculation != Recalculation::kBackground) {
+    StopBackground();
+  }
+  {
+    Operation op(this);
+    if (recalculation == Recalculation::kEager) {
+      ResolveAll();
+    }
+    recalculation_ = recalculation;
+  }
+  if (!worker_.joinable() && recalculation == Recalculation::kBackground) {
+    worker_ = std::thread(&SSheet::RecalculateInBackground, this);
+  }
+}
+
+void SSheet::RecalculateAll() {
+  Operation op(this);
+  ResolveAll();
+}
+
+void SSheet::Poll() {
+  ChangeSet changes;
+  for (const ChangeSet &published : published_.Drain()) {
+    changes.cells.insert(changes.cells.end(), published.cells.begin(),
+                         published.cells.end());
+  }
+  if (changes.cells.empty()) {
+    return;
+  }
+  // Copied under the lock, and called outside it so that it can read the
+  // sheet.
+  absl::optional<ChangeSetCb> change_set_cb;
+  {
+    Operation op(this, Operation::kRead);
+    change_set_cb = change_set_cb_;
+  }
+  if (change_set_cb.has_value()) {
+    change_set_cb.value()(changes);
+  }
+}
+
+void SSheet::AwaitRecalculation() const {
+  if (!worker_.joinable()) {
+    return;
+  }
+  mu_.LockWhen(absl::Condition(this, &SSheet::NothingDirty));
+  mu_.Unlock();
+}
+
+void SSheet::RecalculateInBackground() {
+  absl::MutexLock lock(&mu_);
+  while (true) {
+    mu_.Await(absl::Condition(this, &SSheet::HasBackgroundWork));
+    if (stop_worker_) {
+      return;
+    }
+    // A cell at a time, so that anything waiting on the sheet gets it almost
+    // at once. What a newer edit leaves dirty is picked up next time round.
+    // NB: Walks a copy, as each begin() of a draining |dirty_| would have to
+    // scan past every slot emptied so far.
+    const std::vector<XY> dirty(dirty_.begin(), dirty_.end());
+    for (size_t i = 0;
+         i < dirty.size() && waiting_.load(std::memory_order_relaxed) == 0;
+         ++i) {
+      Resolve(dirty[i], &waiting_);
+    }
+    if (!changes_.cells.empty()) {
+      ChangeSet changes;
+      std::swap(changes, changes_);
+      published_.Push(std::move(changes));
+    }
+    backlog_.store(dirty_.size(), std::memory_order_relaxed);
+  }
+}
+
+bool SSheet::NothingDirty() const { return dirty_.empty(); }
+
+bool SSheet::HasBackgroundWork() const {
+  return stop_worker_ ||
+         (!dirty_.empty() && waiting_.load(std::memory_order_relaxed) == 0);
+}
+
+void SSheet::StopBackground() {
+  // NB: Counts as waiting, as an Operation does, so that the background thread
+  // gives way mid-recalculation rather than finishing its pass first.
+  waiting_.fetch_add(1, std::memory_order_relaxed);
+  {
+    absl::MutexLock lock(&mu_);
+    stop_worker_ = true;
+    waiting_.fetch_sub(1, std::memory_order_relaxed);
+  }
+  worker_.join();
+  absl::MutexLock lock(&mu_);
+  stop_worker_ = false;
+}
+
+void SSheet::Link(const LatisMsg &sheet) {
+  const auto &cells = sheet.cells();
+
+  // Compiling is where the references come from, and each cell's is
+  // independent of the rest.
+  // Literals read nothing, and aren't worth keeping a program for.
+  std::vector<formula::Program> programs(cells.size());
+  const auto compile = [&](size_t i) {
+    const Expression &expression = cells[i].formula().expression();
+    if (!expression.has_value()) {
+      programs[i] = formula::Program::Compile(expression);
+    }
+  };
+  if (num_threads_ == 1 || programs.size() < kMinParallelLevel) {
+    for (size_t i = 0; i < programs.size(); ++i) {
+      compile(i);
+    }
+  } else {
+    if (pool_ == nullptr) {
+      pool_ = absl::make_unique<ThreadPool>(num_threads_ - 1);
+    }
+    pool_->ParallelFor(programs.size(), compile);
+  }
+
+  // As in Set(), cells covered by a range are tracked as part of that range
+  // rather than with an edge each.
+  std::vector<std::pair<XY, XY>> edges;
+  programs_.reserve(
+      std::count_if(cells.begin(), cells.end(), [](const Cell &cell) {
+        return !cell.formula().expression().has_value();
+      }));
+  for (size_t i = 0; i < programs.size(); ++i) {
+    if (cells[i].formula().expression().has_value()) {
+      continue;
+    }
+    const XY xy = XY::From(cells[i].point_location());
+    const formula::Program &program = programs[i];
+    for (const XY &cell : program.cells()) {
+      if (std::none_of(
+              program.ranges().begin(), program.ranges().end(),
+              [cell](const XYRange &r) { return r.Contains(cell); })) {
+        edges.emplace_back(cell, xy);
+      }
+    }
+    IndexRanges(xy, program.ranges());
+    programs_[xy] = std::move(programs[i]);
+  }
+
+  // The file came from a sheet which wouldn't have let in a cycle, so this
+  // should always succeed. If it was edited by hand and doesn't, fall back to
+  // adding the edges one by one and leaving out any which close a cycle;
+  // Resolve() breaks whatever cycles are left when it runs into them.
+  if (!graph_.AddEdges(edges)) {
+    for (const auto &[from, to] : edges) {
+      graph_.AddEdge(from, to);
+    }
+  }
+}
+
+void SSheet::IndexRanges(XY xy, const std::vector<XYRange> &ranges) {
+  ranges_.Erase(xy);
+  for (const XYRange &range : ranges) {
+    ranges_.Insert(xy, range.Min().X(), range.Min().Y(), range.Max().X(),
+                   range.Max().Y());
+  }
+}
+
+graph::Graph<XY>::Plan
+SSheet::PlanRecalculation(const std::vector<XY> &xys) {
+  return graph_.PlanRecalculation(
+      xys, [this](const XY &node, std::vector<XY> *children) {
+        const std::vector<XY> dependents = ranges_.Stab(node.X(), node.Y());
+        children->insert(children->end(), dependents.begin(), dependents.end());
+      });
+}
+
+void SSheet::Resolve(XY xy, const std::atomic<int> *interrupt) const {
+  if (!dirty_.contains(xy)) {
+    return;
+  }
+  // Depth-first, but with an explicit stack: a long chain of dirty cells would
+  // otherwise overflow the call stack.
+  std::vector<XY> stack{xy};
+  // The cells on the way down to |stack.back()|, each waiting on those after
+  // it. One of them being asked for again means a cycle, which only a file
+  // edited by hand can have let in (see Link()); rather than loop forever, the
+  // cell which closes it is given an error.
+  absl::flat_hash_set<XY> waiting;
+  while (!stack.empty()) {
+    if (interrupt != nullptr &&
+        interrupt->load(std::memory_order_relaxed) != 0) {
+      return;
+    }
+    const XY top = stack.back();
+    const size_t size = stack.size();
+    if (!dirty_.contains(top) || Evaluate(top, &stack)) {
+      // NB: Evaluate() only appends to |stack| when it fails, so on success
+      // |top| is still at the back.
+      waiting.erase(top);
+      stack.pop_back();
+      continue;
+    }
+    if (std::any_of(stack.begin() + size, stack.end(), [&](const XY &cell) {
+          return cell == top || waiting.contains(cell);
+        })) {
+      stack.resize(size - 1);
+      waiting.erase(top);
+      Store(top, Status(INVALID_ARGUMENT,
+                        absl::StrFormat("%s is part of a cycle.", top.ToA1())));
+      continue;
     }
-    return absl::nullopt;
+    waiting.insert(top);
+  }
+}
+
+void SSheet::ResolveAll() const {
+  const std::vector<XY> dirty(dirty_.begin(), dirty_.end());
+  for (const XY &xy : dirty) {
+    Resolve(xy);
+  }
+}
+
+const formula::Program &SSheet::ProgramFor(XY xy) const {
+  auto it = programs_.find(xy);
+  if (it == programs_.end()) {
+    it = programs_
+             .emplace(xy, formula::Program::Compile(
+                              cells_.GetExpression(xy).value_or(Expression())))
+             .first;
+  }
+  return it->second;
+}
+
+bool SSheet::Evaluate(XY xy, std::vector<XY> *pending) const {
+  const formula::Program &program = ProgramFor(xy);
+
+  // Direct references are known up front; anything dirty in a range is found
+  // while running.
+  const size_t size = pending->size();
+  for (const XY &cell : program.cells()) {
+    if (dirty_.contains(cell)) {
+      pending->push_back(cell);
+    }
+  }
+  if (pending->size() != size) {
+    return false;
+  }
+
+  formula::ValueLookupFn lookup_fn =
+      [&](XY xy) -> absl::optional<formula::Value> {
+    if (dirty_.contains(xy)) {
+      pending->push_back(xy);
+      return absl::nullopt;
+    }
+    return cells_.Lookup(xy);
   };
 
-  Cell *cell = &cells_[xy];
-  Formula *formula = cell->mutable_formula();
+  const auto amt = program.Run(lookup_fn);
+  if (pending->size() != size) {
+    return false;
+  }
+  Store(xy, amt);
+  return true;
+}
 
-  if (const auto amt =
-          formula::Evaluator(lookup_fn).CrunchExpression(formula->expression());
-      amt.ok()) {
-    *formula->mutable_cached_amount() = amt.ValueOrDie();
+void SSheet::Store(XY xy, const StatusOr<Amount> &amt) const {
+  if (amt.ok()) {
+    cells_.SetAmount(xy, amt.ValueOrDie());
   } else {
-    formula->clear_cached_amount();
-    *formula->mutable_error_msg() =
-        absl::StrFormat("Can't eval: %s", amt.status().error_message());
+    cells_.SetErrorMsg(
+        xy, absl::StrFormat("Can't eval: %s", amt.status().error_message()));
   }
+  dirty_.erase(xy);
 
+  if (change_set_cb_.has_value()) {
+    changes_.cells.push_back(xy);
+  }
   if (has_changed_cb_.has_value()) {
-    has_changed_cb_.value()(*cell);
+    has_changed_cb_.value()(cells_.Get(xy).value());
   }
+}
 
-  UpdateEditTime();
+void SSheet::SetRecalculationThreads(int num_threads) {
+  num_threads_ = std::max(1, num_threads);
+  pool_.reset();
+  absl::MutexLock lock(&parse_mu_);
+  parse_pool_.reset();
+}
+
+void SSheet::Recalculate(const graph::Graph<XY>::Plan &plan) {
+  if (recalculation_ != Recalculation::kEager) {
+    dirty_.insert(plan.nodes.begin(), plan.nodes.end());
+    return;
+  }
+
+  size_t begin = 0;
+  for (const size_t end : plan.level_ends) {
+    const absl::Span<const XY> level(plan.nodes.data() + begin, end - begin);
+    begin = end;
+
+    if (num_threads_ == 1 || level.size() < kMinParallelLevel) {
+      for (const XY &xy : level) {
+        std::vector<XY> pending;
+        Evaluate(xy, &pending);
+      }
+      continue;
+    }
+
+    // Nothing in a level reads anything else in it, so its cells can all be
+    // run at once against the cache as it stands. Everything they might
+    // write to is done beforehand, or afterwards in plan order, so the
+    // result is exactly that of running them one by one.
+    for (const XY &xy : level) {
+      ProgramFor(xy);
+    }
+    if (pool_ == nullptr) {
+      pool_ = absl::make_unique<ThreadPool>(num_threads_ - 1);
+    }
+    std::vector<StatusOr<Amount>> amts(level.size());
+    pool_->ParallelFor(level.size(), [&](size_t i) {
+      formula::ValueLookupFn lookup_fn = [this](XY xy) {
+        return cells_.Lookup(xy);
+      };
+      amts[i] = programs_.find(level[i])->second.Run(lookup_fn);
+    });
+    for (size_t i = 0; i < level.size(); ++i) {
+      Store(level[i], amts[i]);
+    }
+  }
 }
 
 void SSheet::UpdateEditTime() {
-  absl::MutexLock l(&mu_);
   edited_time_ = absl::Now();
   if (edited_time_cb_.has_value()) {
     edited_time_cb_.value()(edited_time_);
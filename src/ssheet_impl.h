@@ -23,85 +23,258 @@
 #include "src/display_utils.h"
 #include "src/formula/common.h"
 #include "src/formula/formula.h"
+#include "src/formula/program.h"
 #include "src/graph/graph.h"
+#include "src/graph/range_index.h"
+#include "src/storage/tile_store.h"
+#include "src/utils/mpsc_queue.h"
+#include "src/utils/thread_pool.h"
 #include "src/xy.h"
 
 #include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
 
+#include <atomic>
+#include <memory>
+#include <thread>
+
 namespace latis {
 
 class SSheet : public SSheetInterface {
 public:
+  enum class Recalculation {
+    // Set() and Clear() recalculate every dependent cell before returning.
+    kEager,
+    // Set() and Clear() only mark dependent cells dirty. A dirty cell is
+    // recalculated when it is next read, by Get() or WriteTo(), or by
+    // RecalculateAll(); its callback fires then.
+    kLazy,
+    // Set() and Clear() mark dependent cells dirty as under kLazy, and a
+    // background thread recalculates them whenever nothing else is using the
+    // sheet. Get() returns the last value calculated, dirty or not, so it never
+    // waits on a long recalculation; Poll() reports what has changed since.
+    kBackground,
+  };
+
+  // A read-only view of a sheet's cells and metadata as they were at one
+  // point in time. Shares storage with the sheet, tile by tile, until the
+  // sheet writes over it; and can be read from any thread without waiting on
+  // the sheet, or outlive it.
+  class Snapshot {
+  public:
+    ::google::protobuf::util::StatusOr<Amount> Get(XY xy) const;
+    ::google::protobuf::util::Status WriteTo(LatisMsg *latis_msg) const;
+
+  private:
+    friend class SSheet;
+    explicit Snapshot(const SSheet &sheet);
+
+    storage::TileStore cells_;
+    absl::optional<std::string> title_;
+    absl::optional<std::string> author_;
+    absl::Time created_time_;
+    absl::Time edited_time_;
+  };
+
   // Create new.
   SSheet();
 
   // Create from sheet.
   SSheet(const LatisMsg &sheet);
 
+  ~SSheet();
+
+  // Any number of threads may Get() at once, alongside one another and only
+  // waiting on writes. Under kLazy, reading a dirty cell counts as a write.
   ::google::protobuf::util::StatusOr<Amount> Get(XY xy) const override;
 
   ::google::protobuf::util::StatusOr<Amount>
   Set(XY xy, std::string_view input) override;
 
+  // Unlike Set(), a cell of the batch which can't be evaluated is stored with
+  // its error, as a dependent would be.
+  ::google::protobuf::util::Status
+  SetBatch(absl::Span<const std::pair<XY, std::string_view>> batch) override;
+
   void Clear(XY xy) override;
 
+  // Exports a snapshot, so only waits on the sheet as long as TakeSnapshot().
   ::google::protobuf::util::Status WriteTo(LatisMsg *latis_msg) const override;
 
+  // O(1), once anything dirty has been recalculated, so that the snapshot is
+  // consistent. The sheet's next write pays for the rest of the copy, block by
+  // block: see storage::TileStore.
+  Snapshot TakeSnapshot() const;
+
+  // Switching back to kEager recalculates whatever is dirty first.
+  void SetRecalculation(Recalculation recalculation);
+  Recalculation GetRecalculation() const { return recalculation_; }
+
+  // Recalculates every dirty cell. A no-op under kEager.
+  void RecalculateAll();
+
+  // Reports everything recalculated in the background since the last call as
+  // one ChangeSet. Call it once per frame from the thread which draws.
+  void Poll();
+
+  // Roughly how many cells are left to recalculate. Doesn't wait on the sheet.
+  size_t Backlog() const { return backlog_.load(std::memory_order_relaxed); }
+
+  // Under kBackground, blocks until there's nothing left to recalculate.
+  void AwaitRecalculation() const;
+
+  // The number of threads, including the caller's, to recalculate with under
+  // kEager. Wide levels of a recalculation are spread across them; the
+  // results are the same as with one. Defaults to the number of cores.
+  void SetRecalculationThreads(int num_threads);
+
   // NB: This only returns out-of-bound updates, i.e. cells _other_ than the
-  // cell just set.
+  // cell just set. Called once per cell, with the sheet locked and, under
+  // kBackground, perhaps from the background thread; prefer
+  // RegisterChangeSetCallback().
   void RegisterCallback(HasChangedCb has_changed_cb) override {
+    absl::MutexLock lock(&mu_);
     has_changed_cb_ = has_changed_cb;
   }
+  // Called once per Set(), Clear(), etc. which recalculates anything, and by
+  // Poll().
+  void RegisterChangeSetCallback(ChangeSetCb change_set_cb) override {
+    absl::MutexLock lock(&mu_);
+    change_set_cb_ = change_set_cb;
+  }
   void RegisterEditedTimeCallback(EditedTimeCb edited_time_cb) override {
+    absl::MutexLock lock(&mu_);
     edited_time_cb_ = edited_time_cb;
   }
 
-  int Height() {
-    // TODO cache this
-    int height = 0;
-    for (const auto &[xy, _] : cells_) {
-      height = std::max(height, xy.Y());
-    }
-    return height;
-  }
+  // Where a Ctrl-arrow from |from| in direction (dx, dy) lands: the far end of
+  // a run of cells, the start of the next run, or failing that the edge of the
+  // sheet.
+  XY DataEdge(XY from, int dx, int dy) const;
 
-  int Width() {
-    // TODO cache this
-    int width = 0;
-    for (const auto &[xy, _] : cells_) {
-      width = std::max(width, xy.X());
-    }
-    return width;
-  }
+  // The largest row / column index holding a cell, or 0 if there are none.
+  int Height() const;
+  int Width() const;
 
-  absl::optional<std::string> Title() const override { return title_; }
+  absl::optional<std::string> Title() const override {
+    absl::ReaderMutexLock lock(&mu_);
+    return title_;
+  }
   void SetTitle(absl::string_view title) override {
+    absl::MutexLock lock(&mu_);
     UpdateEditTime();
     title_ = title;
   }
-  absl::optional<std::string> Author() const override { return author_; }
+  absl::optional<std::string> Author() const override {
+    absl::ReaderMutexLock lock(&mu_);
+    return author_;
+  }
   void SetAuthor(absl::string_view author) override {
+    absl::MutexLock lock(&mu_);
     UpdateEditTime();
     author_ = author;
   }
   absl::Time CreatedTime() const override { return created_time_; }
-  absl::Time EditedTime() const override { return edited_time_; }
+  absl::Time EditedTime() const override {
+    absl::ReaderMutexLock lock(&mu_);
+    return edited_time_;
+  }
 
 private:
-  void Update(XY xy);
-  void UpdateEditTime();
+  // Locks the sheet for the length of a public method: shared by those which
+  // only read cached values, so that any number of them run at once, and
+  // exclusive for the rest. An exclusive one reports the cells recalculated
+  // meanwhile as one ChangeSet on its way out. The background thread gives
+  // way as soon as either is waiting.
+  class Operation;
+
+  // Plans the recalculation of everything downstream of |xys|, whether they
+  // are referred to directly or as part of a range.
+  graph::Graph<XY>::Plan PlanRecalculation(const std::vector<XY> &xys);
+
+  // Compiles every cell of |sheet|, which has just been read in, and links
+  // them up: direct references into |graph_|, all at once, and ranges into
+  // |ranges_|.
+  void Link(const LatisMsg &sheet) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Replaces whatever ranges |xy| was indexed under with |ranges|.
+  void IndexRanges(XY xy, const std::vector<XYRange> &ranges);
+
+  // The cell's value or error as last calculated, even if it is dirty.
+  ::google::protobuf::util::StatusOr<Amount> GetCached(XY xy) const;
+
+  // Recalculates |xy| if it is dirty, and any dirty cells it reads before it.
+  // Gives up, leaving what's left dirty, as soon as |*interrupt| isn't 0.
+  void Resolve(XY xy, const std::atomic<int> *interrupt = nullptr) const;
+  void ResolveAll() const;
+
+  // Compiles the program for |xy| if it isn't already.
+  const formula::Program &ProgramFor(XY xy) const;
+
+  // Recalculates |xy| from the cached values of the cells it reads. If any of
+  // those are dirty, instead appends them to |pending| and returns false.
+  bool Evaluate(XY xy, std::vector<XY> *pending) const;
+
+  // Caches a freshly calculated value for |xy| and notifies the callback.
+  void Store(XY xy,
+             const ::google::protobuf::util::StatusOr<Amount> &amt) const;
+
+  // Recalculates, or unless kEager marks dirty, each cell of |plan|.
+  void Recalculate(const graph::Graph<XY>::Plan &plan);
+
+  // The body of |worker_|: recalculates dirty cells while no Operation is
+  // waiting, until told to stop.
+  void RecalculateInBackground();
+  bool NothingDirty() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  bool HasBackgroundWork() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+  void StopBackground();
+
+  void UpdateEditTime() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_);
 
   mutable absl::Mutex mu_;
 
-  absl::flat_hash_map<XY, Cell> cells_ ABSL_GUARDED_BY(mu_);
+  // The cache of calculated values is filled in by reads under kLazy, hence
+  // mutable.
+  mutable storage::TileStore cells_ ABSL_GUARDED_BY(mu_);
+  // Each cell's expression, compiled. Filled in by Set(), or on load for cells
+  // read from a file.
+  mutable absl::flat_hash_map<XY, formula::Program> programs_;
+  // Cells whose cached value is out of date. Always empty under kEager.
+  mutable absl::flat_hash_set<XY> dirty_;
+  Recalculation recalculation_{Recalculation::kEager};
+
+  int num_threads_{
+      std::max(1, static_cast<int>(std::thread::hardware_concurrency()))};
+  // Started on the first level wide enough to need it.
+  std::unique_ptr<ThreadPool> pool_;
+  // For parsing a wide batch, which happens outside any Operation. One batch
+  // at a time, as ThreadPool only runs one ParallelFor() at once.
+  absl::Mutex parse_mu_;
+  std::unique_ptr<ThreadPool> parse_pool_ ABSL_GUARDED_BY(parse_mu_);
+  // Direct references, i.e. A1, are edges in |graph_|. Range references, i.e.
+  // SUM(A1:A100), are a single entry in |ranges_|.
   graph::Graph<XY> graph_;
+  graph::RangeIndex<XY> ranges_;
 
   absl::optional<HasChangedCb> has_changed_cb_;
+  absl::optional<ChangeSetCb> change_set_cb_;
+  // The cells recalculated by the current Operation or background batch.
+  mutable ChangeSet changes_;
   absl::optional<EditedTimeCb> edited_time_cb_;
 
+  std::thread worker_;
+  bool stop_worker_ ABSL_GUARDED_BY(mu_){false};
+  // Operations waiting on, or holding, |mu_|: every kWrite, and those reads
+  // which found it held exclusively.
+  mutable std::atomic<int> waiting_{0};
+  // Batches recalculated in the background, for Poll().
+  MpscQueue<ChangeSet> published_;
+  // The size of |dirty_| when last unlocked.
+  mutable std::atomic<size_t> backlog_{0};
+
   // Metadata
   absl::optional<std::string> title_{std::nullopt};
   absl::optional<std::string> author_{std::nullopt};
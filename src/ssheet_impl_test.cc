@@ -14,6 +14,8 @@
 
 #include "src/ssheet_impl.h"
 
+#include "absl/memory/memory.h"
+#include "absl/strings/str_format.h"
 #include "absl/time/time.h"
 #include "google/protobuf/text_format.h"
 #include "src/display_utils.h"
@@ -21,18 +23,28 @@
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 
+#include <atomic>
+#include <thread>
+
 namespace latis {
 namespace {
 
 using ::google::protobuf::TextFormat;
 using ::google::protobuf::util::StatusOr;
+using ::testing::AnyNumber;
 using ::testing::DoubleEq;
+using ::testing::ElementsAre;
 using ::testing::Eq;
+using ::testing::Field;
+using ::testing::Gt;
 using ::testing::Le;
+using ::testing::Lt;
 using ::testing::MockFunction;
 using ::testing::Not;
 using ::testing::Property;
+using ::testing::SizeIs;
 using ::testing::StrictMock;
+using ::testing::UnorderedElementsAre;
 
 // metadata
 TEST(Metadata, TitleAndAuthor) {
@@ -198,5 +210,754 @@ TEST_F(LatisTest, DependencyTwoHops) {
               IsOkAndHolds(Property(&Amount::double_amount, DoubleEq(6.8))));
 }
 
+TEST_F(LatisTest, FanInUpdatesEachCellOnce) {
+  latis_.Set(A1, "1");
+  latis_.Set(B2, "A1");
+  latis_.Set(C3, "A1");
+  latis_.Set(D4, "A1+B2+C3");
+
+  // D4 is reachable along three paths, but is only updated once.
+  EXPECT_CALL(update_cb_, Call).Times(3);
+  latis_.Set(A1, "2");
+  EXPECT_THAT(latis_.Get(D4),
+              IsOkAndHolds(EqualsProto(ToProto<Amount>("int_amount: 6"))));
+}
+
+TEST_F(LatisTest, RangeDependency) {
+  const XY A2 = XY::From("A2").ValueOrDie();
+  const XY A3 = XY::From("A3").ValueOrDie();
+  latis_.Set(A1, "1");
+  latis_.Set(A2, "2");
+  EXPECT_THAT(latis_.Set(B2, "SUM(A1:A3)"),
+              IsOkAndHolds(EqualsProto(ToProto<Amount>("int_amount: 3"))));
+  EXPECT_THAT(latis_.Set(C3, "B2 * 2"),
+              IsOkAndHolds(EqualsProto(ToProto<Amount>("int_amount: 6"))));
+
+  // Writing anywhere in the range updates B2, and then C3.
+  EXPECT_CALL(update_cb_, Call).Times(2);
+  latis_.Set(A3, "3");
+  EXPECT_THAT(latis_.Get(B2),
+              IsOkAndHolds(EqualsProto(ToProto<Amount>("int_amount: 6"))));
+  EXPECT_THAT(latis_.Get(C3),
+              IsOkAndHolds(EqualsProto(ToProto<Amount>("int_amount: 12"))));
+}
+
+TEST_F(LatisTest, RangeCycles) {
+  latis_.Set(A1, "1");
+  EXPECT_THAT(latis_.Set(B2, "SUM(A1:B2)"), Not(IsOk()));
+
+  EXPECT_THAT(latis_.Set(B2, "SUM(A1:A3)"), IsOk());
+  EXPECT_THAT(latis_.Set(A1, "B2"), Not(IsOk()));
+  EXPECT_THAT(latis_.Set(C3, "B2"), IsOk());
+  EXPECT_THAT(latis_.Set(A1, "SUM(C1:C3)"), Not(IsOk()));
+}
+
+TEST_F(LatisTest, SetBatch) {
+  EXPECT_CALL(update_cb_, Call).Times(AnyNumber());
+  latis_.Set(A1, "1");
+  latis_.Set(B2, "0");
+  latis_.Set(D4, "SUM(B2:C3)");
+
+  // C3 reads B2, which comes later in the batch.
+  const std::pair<XY, std::string_view> batch[] = {
+      {C3, "B2 * 10"}, {B2, "A1 + 1"}, {A1, "2"}};
+  EXPECT_THAT(latis_.SetBatch(batch), IsOk());
+
+  EXPECT_THAT(latis_.Get(A1),
+              IsOkAndHolds(EqualsProto(ToProto<Amount>("int_amount: 2"))));
+  EXPECT_THAT(latis_.Get(B2),
+              IsOkAndHolds(EqualsProto(ToProto<Amount>("int_amount: 3"))));
+  EXPECT_THAT(latis_.Get(C3),
+              IsOkAndHolds(EqualsProto(ToProto<Amount>("int_amount: 30"))));
+  EXPECT_THAT(latis_.Get(D4),
+              IsOkAndHolds(EqualsProto(ToProto<Amount>("int_amount: 33"))));
+
+  // And later edits propagate through the batch's edges as through Set()'s.
+  latis_.Set(A1, "5");
+  EXPECT_THAT(latis_.Get(D4),
+              IsOkAndHolds(EqualsProto(ToProto<Amount>("int_amount: 66"))));
+}
+
+TEST_F(LatisTest, SetBatchUpdatesSharedDependentsOnce) {
+  latis_.Set(A1, "1");
+  latis_.Set(B2, "1");
+  latis_.Set(C3, "A1+B2");
+  latis_.Set(D4, "C3");
+
+  // Two calls for A1 and B2 themselves, then one each for C3 and D4.
+  EXPECT_CALL(update_cb_, Call).Times(4);
+  const std::pair<XY, std::string_view> batch[] = {{A1, "2"}, {B2, "3"}};
+  EXPECT_THAT(latis_.SetBatch(batch), IsOk());
+  EXPECT_THAT(latis_.Get(D4),
+              IsOkAndHolds(EqualsProto(ToProto<Amount>("int_amount: 5"))));
+}
+
+TEST_F(LatisTest, SetBatchLaterEntriesWin) {
+  EXPECT_CALL(update_cb_, Call).Times(AnyNumber());
+  const std::pair<XY, std::string_view> batch[] = {
+      {A1, "1"}, {B2, "A1"}, {A1, "2"}};
+  EXPECT_THAT(latis_.SetBatch(batch), IsOk());
+  EXPECT_THAT(latis_.Get(B2),
+              IsOkAndHolds(EqualsProto(ToProto<Amount>("int_amount: 2"))));
+}
+
+TEST_F(LatisTest, SetBatchLiteralOverFormulaReadsNothing) {
+  EXPECT_CALL(update_cb_, Call).Times(AnyNumber());
+  const std::pair<XY, std::string_view> batch[] = {
+      {A1, "1"}, {B2, "A1"}, {B2, "3"}};
+  EXPECT_THAT(latis_.SetBatch(batch), IsOk());
+  EXPECT_THAT(latis_.Set(A1, "5"), IsOk());
+  EXPECT_THAT(latis_.Get(B2),
+              IsOkAndHolds(EqualsProto(ToProto<Amount>("int_amount: 3"))));
+}
+
+TEST_F(LatisTest, SetBatchIsAllOrNothing) {
+  latis_.Set(A1, "1");
+  latis_.Set(B2, "A1");
+
+  EXPECT_CALL(update_cb_, Call).Times(0);
+  const std::pair<XY, std::string_view> unparseable[] = {{A1, "2"},
+                                                          {C3, "(1 +"}};
+  EXPECT_THAT(latis_.SetBatch(unparseable), Not(IsOk()));
+  const std::pair<XY, std::string_view> cyclic[] = {{A1, "2"}, {C3, "D4"},
+                                                    {D4, "SUM(B2:C3)"}};
+  EXPECT_THAT(latis_.SetBatch(cyclic), Not(IsOk()));
+
+  EXPECT_THAT(latis_.Get(B2),
+              IsOkAndHolds(EqualsProto(ToProto<Amount>("int_amount: 1"))));
+  EXPECT_THAT(latis_.Get(C3), Not(IsOk()));
+  EXPECT_THAT(latis_.Get(D4), Not(IsOk()));
+
+  // Nothing of the failed batches lingers in the graph or range index.
+  EXPECT_CALL(update_cb_, Call).Times(1);
+  latis_.Set(A1, "3");
+  EXPECT_THAT(latis_.Set(C3, "B2"), IsOk());
+}
+
+TEST_F(LatisTest, SetBatchCanReverseAnEdge) {
+  EXPECT_CALL(update_cb_, Call).Times(AnyNumber());
+  latis_.Set(A1, "1");
+  latis_.Set(B2, "A1");
+
+  // B2 stops reading A1 in the same batch as A1 starts reading B2, so there
+  // is no cycle, whichever comes first.
+  const std::pair<XY, std::string_view> batch[] = {{A1, "B2"}, {B2, "5"}};
+  EXPECT_THAT(latis_.SetBatch(batch), IsOk());
+  EXPECT_THAT(latis_.Get(A1),
+              IsOkAndHolds(EqualsProto(ToProto<Amount>("int_amount: 5"))));
+
+  latis_.Set(B2, "6");
+  EXPECT_THAT(latis_.Get(A1),
+              IsOkAndHolds(EqualsProto(ToProto<Amount>("int_amount: 6"))));
+}
+
+TEST_F(LatisTest, Bounds) {
+  EXPECT_EQ(latis_.Height(), 0);
+  EXPECT_EQ(latis_.Width(), 0);
+
+  latis_.Set(B2, "1");
+  latis_.Set(D4, "2");
+  EXPECT_EQ(latis_.Height(), 3);
+  EXPECT_EQ(latis_.Width(), 3);
+
+  latis_.Clear(D4);
+  EXPECT_EQ(latis_.Height(), 1);
+  EXPECT_EQ(latis_.Width(), 1);
+}
+
+TEST_F(LatisTest, LazySetOnlyMarksDirty) {
+  latis_.SetRecalculation(SSheet::Recalculation::kLazy);
+  latis_.Set(A1, "1");
+  latis_.Set(B2, "A1");
+  latis_.Set(C3, "B2*2");
+
+  // Nothing downstream is recalculated until it is read.
+  EXPECT_CALL(update_cb_, Call).Times(0);
+  latis_.Set(A1, "2");
+
+  // Reading C3 recalculates B2 first, then C3. Reading again is free.
+  EXPECT_CALL(update_cb_, Call).Times(2);
+  EXPECT_THAT(latis_.Get(C3),
+              IsOkAndHolds(EqualsProto(ToProto<Amount>("int_amount: 4"))));
+  EXPECT_THAT(latis_.Get(C3),
+              IsOkAndHolds(EqualsProto(ToProto<Amount>("int_amount: 4"))));
+  EXPECT_THAT(latis_.Get(B2),
+              IsOkAndHolds(EqualsProto(ToProto<Amount>("int_amount: 2"))));
+}
+
+TEST_F(LatisTest, LazySetReadsThroughDirtyCells) {
+  latis_.SetRecalculation(SSheet::Recalculation::kLazy);
+  latis_.Set(A1, "1");
+  latis_.Set(B2, "A1");
+  latis_.Set(A1, "5");
+
+  // D4 reads B2, which is dirty.
+  EXPECT_CALL(update_cb_, Call).Times(1);
+  EXPECT_THAT(latis_.Set(D4, "B2+1"),
+              IsOkAndHolds(EqualsProto(ToProto<Amount>("int_amount: 6"))));
+}
+
+TEST_F(LatisTest, LazyRange) {
+  const XY A2 = XY::From("A2").ValueOrDie();
+  latis_.SetRecalculation(SSheet::Recalculation::kLazy);
+  latis_.Set(A1, "1");
+  latis_.Set(A2, "A1");
+  latis_.Set(B2, "SUM(A1:A3)");
+  latis_.Set(C3, "B2");
+
+  EXPECT_CALL(update_cb_, Call).Times(0);
+  latis_.Set(A1, "10");
+
+  // C3 reads B2, which reads A2 as part of a range.
+  EXPECT_CALL(update_cb_, Call).Times(3);
+  EXPECT_THAT(latis_.Get(C3),
+              IsOkAndHolds(EqualsProto(ToProto<Amount>("int_amount: 20"))));
+}
+
+TEST_F(LatisTest, LazyClear) {
+  latis_.SetRecalculation(SSheet::Recalculation::kLazy);
+  latis_.Set(A1, "2");
+  latis_.Set(B2, "A1");
+
+  EXPECT_CALL(update_cb_, Call).Times(0);
+  latis_.Clear(A1);
+
+  EXPECT_CALL(update_cb_, Call).Times(1);
+  EXPECT_THAT(latis_.Get(B2), Not(IsOk()));
+}
+
+TEST_F(LatisTest, RecalculateAll) {
+  latis_.SetRecalculation(SSheet::Recalculation::kLazy);
+  latis_.Set(A1, "1");
+  latis_.Set(B2, "A1");
+  latis_.Set(C3, "A1");
+
+  EXPECT_CALL(update_cb_, Call).Times(0);
+  latis_.Set(A1, "2");
+
+  EXPECT_CALL(update_cb_, Call).Times(2);
+  latis_.RecalculateAll();
+  latis_.RecalculateAll();
+}
+
+TEST_F(LatisTest, LazyWriteToIsUpToDate) {
+  latis_.SetRecalculation(SSheet::Recalculation::kLazy);
+  latis_.Set(A1, "1");
+  latis_.Set(B2, "A1");
+
+  EXPECT_CALL(update_cb_, Call).Times(1);
+  latis_.Set(A1, "3");
+
+  LatisMsg msg;
+  ASSERT_THAT(latis_.WriteTo(&msg), IsOk());
+  for (const Cell &cell : msg.cells()) {
+    EXPECT_THAT(cell.formula().cached_amount(),
+                EqualsProto(ToProto<Amount>("int_amount: 3")));
+  }
+}
+
+TEST_F(LatisTest, BackToEagerRecalculates) {
+  latis_.SetRecalculation(SSheet::Recalculation::kLazy);
+  latis_.Set(A1, "1");
+  latis_.Set(B2, "A1");
+
+  EXPECT_CALL(update_cb_, Call).Times(0);
+  latis_.Set(A1, "2");
+
+  EXPECT_CALL(update_cb_, Call).Times(1);
+  latis_.SetRecalculation(SSheet::Recalculation::kEager);
+}
+
+class ChangeSetTest : public ::testing::Test {
+public:
+  void SetUp() {
+    latis_.RegisterChangeSetCallback(change_set_cb_.AsStdFunction());
+    latis_.RegisterEditedTimeCallback(edited_time_cb_.AsStdFunction());
+  }
+
+protected:
+  const XY A1 = XY::From("A1").ValueOrDie();
+  const XY B2 = XY::From("B2").ValueOrDie();
+  const XY C3 = XY::From("C3").ValueOrDie();
+  const XY D4 = XY::From("D4").ValueOrDie();
+  SSheet latis_;
+  MockFunction<void(const ChangeSet &)> change_set_cb_;
+  MockFunction<void(absl::Time)> edited_time_cb_;
+};
+
+TEST_F(ChangeSetTest, OnePerSet) {
+  latis_.Set(A1, "1");
+  latis_.Set(B2, "A1");
+  latis_.Set(C3, "A1");
+  latis_.Set(D4, "A1+B2+C3");
+
+  EXPECT_CALL(change_set_cb_, Call(Field(&ChangeSet::cells,
+                                         UnorderedElementsAre(B2, C3, D4))))
+      .Times(1);
+  EXPECT_CALL(edited_time_cb_, Call).Times(1);
+  latis_.Set(A1, "2");
+}
+
+TEST_F(ChangeSetTest, NoneWithoutDependents) {
+  EXPECT_CALL(change_set_cb_, Call).Times(0);
+  EXPECT_CALL(edited_time_cb_, Call).Times(2);
+  latis_.Set(A1, "1");
+  latis_.Clear(A1);
+}
+
+TEST_F(ChangeSetTest, OnePerClear) {
+  latis_.Set(A1, "1");
+  latis_.Set(B2, "A1");
+  latis_.Set(C3, "B2");
+
+  EXPECT_CALL(change_set_cb_,
+              Call(Field(&ChangeSet::cells, ElementsAre(B2, C3))))
+      .Times(1);
+  latis_.Clear(A1);
+}
+
+TEST_F(ChangeSetTest, LazySetReadingDirtyCells) {
+  latis_.SetRecalculation(SSheet::Recalculation::kLazy);
+  latis_.Set(A1, "1");
+  latis_.Set(B2, "A1");
+  latis_.Set(C3, "B2");
+  latis_.Set(A1, "5");
+
+  // D4 reads C3, which reads B2; both are reported together.
+  EXPECT_CALL(change_set_cb_,
+              Call(Field(&ChangeSet::cells, ElementsAre(B2, C3))))
+      .Times(1);
+  latis_.Set(D4, "C3+1");
+}
+
+TEST_F(ChangeSetTest, OnePerRecalculateAll) {
+  latis_.SetRecalculation(SSheet::Recalculation::kLazy);
+  latis_.Set(A1, "1");
+  latis_.Set(B2, "A1");
+  latis_.Set(C3, "A1");
+  latis_.Set(A1, "2");
+
+  EXPECT_CALL(change_set_cb_, Call(Field(&ChangeSet::cells,
+                                         UnorderedElementsAre(B2, C3))))
+      .Times(1);
+  latis_.RecalculateAll();
+}
+
+TEST_F(ChangeSetTest, OnePerBatch) {
+  latis_.Set(A1, "1");
+  latis_.Set(B2, "A1");
+
+  EXPECT_CALL(change_set_cb_,
+              Call(Field(&ChangeSet::cells, ElementsAre(A1, B2, C3))))
+      .Times(1);
+  EXPECT_CALL(edited_time_cb_, Call).Times(1);
+  const std::pair<XY, std::string_view> batch[] = {{A1, "2"}, {C3, "B2"}};
+  EXPECT_THAT(latis_.SetBatch(batch), IsOk());
+}
+
+// A1 feeds every cell of rows 0..|height| in column B, each of which feeds
+// the corresponding cell of column C, which all feed D1.
+void FillWide(SSheet *latis, int height) {
+  latis->Set(XY(0, 0), "1");
+  for (int y = 0; y < height; ++y) {
+    const std::string b = XY(1, y).ToA1();
+    latis->Set(XY(1, y), absl::StrFormat("A1 * %d", y));
+    latis->Set(XY(2, y), absl::StrFormat("%s / 2 + %d", b, y));
+  }
+  latis->Set(XY(3, 0), absl::StrFormat("SUM(C1:C%d)", height));
+}
+
+TEST(Parallel, MatchesSerial) {
+  constexpr int kHeight = 1000;
+  SSheet serial;
+  serial.SetRecalculationThreads(1);
+  FillWide(&serial, kHeight);
+  SSheet parallel;
+  parallel.SetRecalculationThreads(4);
+  FillWide(&parallel, kHeight);
+
+  std::vector<XY> serial_order;
+  serial.RegisterCallback([&serial_order](const Cell &cell) {
+    serial_order.push_back(XY::From(cell.point_location()));
+  });
+  std::vector<XY> parallel_order;
+  parallel.RegisterCallback([&parallel_order](const Cell &cell) {
+    parallel_order.push_back(XY::From(cell.point_location()));
+  });
+
+  for (const std::string &input : {"2", "3.5", "\"x\""}) {
+    serial.Set(XY(0, 0), input);
+    parallel.Set(XY(0, 0), input);
+
+    // Cells come out of WriteTo() in no particular order.
+    LatisMsg serial_msg;
+    ASSERT_THAT(serial.WriteTo(&serial_msg), IsOk());
+    LatisMsg parallel_msg;
+    ASSERT_THAT(parallel.WriteTo(&parallel_msg), IsOk());
+    ASSERT_THAT(parallel_msg.cells_size(), Eq(serial_msg.cells_size()));
+    for (const Cell &cell : serial_msg.cells()) {
+      const XY xy = XY::From(cell.point_location());
+      EXPECT_THAT(parallel.Get(xy).ok(), Eq(serial.Get(xy).ok()));
+      if (serial.Get(xy).ok()) {
+        EXPECT_THAT(parallel.Get(xy).ValueOrDie(),
+                    EqualsProto(serial.Get(xy).ValueOrDie()));
+      }
+    }
+  }
+  // Every cell but A1, each time, and in the same order.
+  EXPECT_THAT(parallel_order, SizeIs(3 * (2 * kHeight + 1)));
+  EXPECT_THAT(parallel_order, Eq(serial_order));
+}
+
+// Expects every cell of |expected| to read the same from |actual|.
+void ExpectSameCells(const SSheet &expected, const SSheet &actual) {
+  LatisMsg msg;
+  ASSERT_THAT(expected.WriteTo(&msg), IsOk());
+  for (const Cell &cell : msg.cells()) {
+    const XY xy = XY::From(cell.point_location());
+    EXPECT_THAT(actual.Get(xy).ok(), Eq(expected.Get(xy).ok())) << xy;
+    if (expected.Get(xy).ok()) {
+      EXPECT_THAT(actual.Get(xy).ValueOrDie(),
+                  EqualsProto(expected.Get(xy).ValueOrDie()))
+          << xy;
+    }
+  }
+}
+
+TEST(Parallel, SetBatchMatchesSerial) {
+  // Wide enough to be parsed across the pool.
+  constexpr int kHeight = 1000;
+  std::vector<std::string> inputs = {"1"};
+  for (int y = 1; y < kHeight; ++y) {
+    inputs.push_back(absl::StrFormat("A%d + %d", y, y));
+  }
+  std::vector<std::pair<XY, std::string_view>> batch;
+  for (int y = 0; y < kHeight; ++y) {
+    batch.emplace_back(XY(0, y), inputs[y]);
+  }
+
+  SSheet serial;
+  serial.SetRecalculationThreads(1);
+  ASSERT_THAT(serial.SetBatch(batch), IsOk());
+  SSheet parallel;
+  parallel.SetRecalculationThreads(4);
+  ASSERT_THAT(parallel.SetBatch(batch), IsOk());
+  ExpectSameCells(serial, parallel);
+
+  // And a bad input anywhere still sinks the whole batch.
+  batch[kHeight / 2].second = "(";
+  EXPECT_THAT(parallel.SetBatch(batch), Not(IsOk()));
+  ExpectSameCells(serial, parallel);
+}
+
+TEST(Load, LinksDependencies) {
+  constexpr int kHeight = 300;
+  SSheet original;
+  FillWide(&original, kHeight);
+  LatisMsg msg;
+  ASSERT_THAT(original.WriteTo(&msg), IsOk());
+
+  // Edits to a loaded sheet reach everything downstream, through both edges
+  // and ranges, exactly as they do in the sheet it was saved from.
+  SSheet loaded(msg);
+  int updates = 0;
+  loaded.RegisterCallback([&updates](const Cell &) { updates++; });
+  for (const std::string &input : {"2", "\"x\""}) {
+    original.Set(XY(0, 0), input);
+    loaded.Set(XY(0, 0), input);
+    ExpectSameCells(original, loaded);
+  }
+  EXPECT_THAT(updates, Eq(2 * (2 * kHeight + 1)));
+
+  // Including catching cycles.
+  EXPECT_THAT(loaded.Set(XY(0, 0), "D1"), Not(IsOk()));
+  EXPECT_THAT(loaded.Set(XY(0, 0), "SUM(B1:B3)"), Not(IsOk()));
+}
+
+// A1 = B1 + C1 and B1 = A1, as a file edited by hand might have them. B1
+// comes first, so that Link() keeps the edge from A1 to B1 and drops the one
+// back: an edit to C1 then dirties both.
+LatisMsg CyclicSheet() {
+  SSheet sheet;
+  sheet.Set(XY(2, 0), "1");
+  sheet.Set(XY(1, 0), "1");
+  sheet.Set(XY(0, 0), "B1 + C1");
+  LatisMsg written;
+  sheet.WriteTo(&written);
+
+  SSheet other;
+  other.Set(XY(0, 0), "1");
+  other.Set(XY(1, 0), "A1");
+  LatisMsg other_msg;
+  other.WriteTo(&other_msg);
+
+  LatisMsg msg = written;
+  msg.clear_cells();
+  for (const Cell &cell : other_msg.cells()) {
+    if (XY::From(cell.point_location()) == XY(1, 0)) {
+      *msg.add_cells() = cell;
+    }
+  }
+  for (const Cell &cell : written.cells()) {
+    if (!(XY::From(cell.point_location()) == XY(1, 0))) {
+      *msg.add_cells() = cell;
+    }
+  }
+  return msg;
+}
+
+TEST(Load, LazyBreaksCycles) {
+  SSheet loaded(CyclicSheet());
+  loaded.SetRecalculation(SSheet::Recalculation::kLazy);
+  loaded.Set(XY(2, 0), "2");
+
+  // Reading through the cycle finishes, with an error somewhere on it.
+  const auto a1 = loaded.Get(XY(0, 0));
+  const auto b1 = loaded.Get(XY(1, 0));
+  EXPECT_FALSE(a1.ok() && b1.ok());
+}
+
+TEST(Load, BackgroundBreaksCycles) {
+  SSheet loaded(CyclicSheet());
+  loaded.SetRecalculation(SSheet::Recalculation::kBackground);
+  loaded.Set(XY(2, 0), "2");
+
+  loaded.AwaitRecalculation();
+  EXPECT_THAT(loaded.Backlog(), Eq(0));
+  LatisMsg msg;
+  EXPECT_THAT(loaded.TakeSnapshot().WriteTo(&msg), IsOk());
+}
+
+TEST(Background, CatchesUp) {
+  constexpr int kHeight = 300;
+  SSheet eager;
+  FillWide(&eager, kHeight);
+  SSheet background;
+  background.SetRecalculation(SSheet::Recalculation::kBackground);
+  FillWide(&background, kHeight);
+  background.AwaitRecalculation();
+
+  std::vector<XY> changed;
+  background.RegisterChangeSetCallback([&changed](const ChangeSet &changes) {
+    changed.insert(changed.end(), changes.cells.begin(), changes.cells.end());
+  });
+
+  eager.Set(XY(0, 0), "2");
+  background.Set(XY(0, 0), "2");
+  background.AwaitRecalculation();
+  EXPECT_THAT(background.Backlog(), Eq(0));
+
+  // Get() doesn't recalculate under kBackground, so these were all done by
+  // the background thread.
+  ExpectSameCells(eager, background);
+
+  // Everything but A1, reported by Poll().
+  EXPECT_THAT(changed, SizeIs(0));
+  background.Poll();
+  EXPECT_THAT(changed, SizeIs(2 * kHeight + 1));
+  background.Poll();
+  EXPECT_THAT(changed, SizeIs(2 * kHeight + 1));
+}
+
+TEST(Background, NewerEditsSupersede) {
+  constexpr int kHeight = 300;
+  SSheet eager;
+  FillWide(&eager, kHeight);
+  SSheet background;
+  background.SetRecalculation(SSheet::Recalculation::kBackground);
+  FillWide(&background, kHeight);
+
+  // Most of these land while the one before is still being recalculated.
+  for (int i = 0; i < 50; ++i) {
+    background.Set(XY(0, 0), absl::StrFormat("%d", i));
+    background.Set(XY(4, 0), "D1 + 1");
+  }
+  eager.Set(XY(0, 0), "49");
+  eager.Set(XY(4, 0), "D1 + 1");
+  background.AwaitRecalculation();
+
+  ExpectSameCells(eager, background);
+}
+
+TEST(Background, BackToEager) {
+  SSheet eager;
+  FillWide(&eager, 100);
+  eager.Set(XY(0, 0), "3");
+  SSheet latis;
+  latis.SetRecalculation(SSheet::Recalculation::kBackground);
+  FillWide(&latis, 100);
+  latis.Set(XY(0, 0), "3");
+
+  // Whatever the background thread hadn't got to is done at once.
+  latis.SetRecalculation(SSheet::Recalculation::kEager);
+  EXPECT_THAT(latis.Backlog(), Eq(0));
+  ExpectSameCells(eager, latis);
+}
+
+TEST(Background, StopsMidRecalculation) {
+  // A chain long enough that recalculating all of it takes a while.
+  constexpr int kHeight = 50000;
+  std::vector<std::string> inputs = {"1"};
+  for (int y = 1; y < kHeight; ++y) {
+    inputs.push_back(absl::StrFormat("A%d + 1", y));
+  }
+  std::vector<std::pair<XY, std::string_view>> batch;
+  for (int y = 0; y < kHeight; ++y) {
+    batch.emplace_back(XY(0, y), inputs[y]);
+  }
+  SSheet latis;
+  ASSERT_THAT(latis.SetBatch(batch), IsOk());
+
+  std::atomic<int> recalculated{0};
+  latis.RegisterCallback([&recalculated](const Cell &) { recalculated++; });
+  latis.SetRecalculation(SSheet::Recalculation::kBackground);
+  latis.Set(XY(0, 0), "2");
+  while (recalculated.load() == 0) {
+    std::this_thread::yield();
+  }
+
+  // Stopping the background thread doesn't wait for it to get to the end.
+  latis.SetRecalculation(SSheet::Recalculation::kLazy);
+  EXPECT_THAT(recalculated.load(), Lt(kHeight - 1));
+  EXPECT_THAT(latis.Backlog(), Gt(0));
+
+  // And what it left is still dirty, to be picked up by a read.
+  EXPECT_THAT(latis.Get(XY(0, kHeight - 1)),
+              IsOkAndHolds(Property(&Amount::int_amount, Eq(kHeight + 1))));
+}
+
+TEST(Snapshot, PointInTime) {
+  SSheet latis;
+  latis.SetTitle("before");
+  latis.Set(XY(0, 0), "1");
+  latis.Set(XY(1, 0), "A1 * 2");
+  const SSheet::Snapshot snapshot = latis.TakeSnapshot();
+
+  latis.SetTitle("after");
+  latis.Set(XY(0, 0), "5");
+  latis.Set(XY(2, 0), "3");
+  latis.Clear(XY(1, 0));
+
+  EXPECT_THAT(snapshot.Get(XY(1, 0)),
+              IsOkAndHolds(EqualsProto(ToProto<Amount>("int_amount: 2"))));
+  EXPECT_THAT(snapshot.Get(XY(2, 0)), Not(IsOk()));
+  LatisMsg msg;
+  ASSERT_THAT(snapshot.WriteTo(&msg), IsOk());
+  EXPECT_THAT(msg.metadata().title(), Eq("before"));
+  EXPECT_THAT(msg.cells(), SizeIs(2));
+}
+
+TEST(Snapshot, RecalculatesDirtyCellsFirst) {
+  SSheet latis;
+  latis.SetRecalculation(SSheet::Recalculation::kLazy);
+  latis.Set(XY(0, 0), "1");
+  latis.Set(XY(1, 0), "A1 * 2");
+  latis.Set(XY(0, 0), "4");
+
+  EXPECT_THAT(latis.TakeSnapshot().Get(XY(1, 0)),
+              IsOkAndHolds(EqualsProto(ToProto<Amount>("int_amount: 8"))));
+}
+
+TEST(Snapshot, OutlivesTheSheet) {
+  auto latis = absl::make_unique<SSheet>();
+  latis->Set(XY(0, 0), "\"kept\"");
+  const SSheet::Snapshot snapshot = latis->TakeSnapshot();
+  latis.reset();
+
+  EXPECT_THAT(snapshot.Get(XY(0, 0)),
+              IsOkAndHolds(EqualsProto(ToProto<Amount>("str_amount: 'kept'"))));
+}
+
+TEST(Snapshot, ConsistentWhileEditing) {
+  constexpr int kHeight = 200;
+  SSheet latis;
+  FillWide(&latis, kHeight);
+
+  // Every snapshot should see B and C as recalculated from one value of A1,
+  // however the edits and snapshots interleave.
+  std::thread writer([&latis] {
+    for (int i = 2; i < 40; ++i) {
+      latis.Set(XY(0, 0), absl::StrFormat("%d", i));
+    }
+  });
+  for (int i = 0; i < 40; ++i) {
+    const SSheet::Snapshot snapshot = latis.TakeSnapshot();
+    const int64_t a1 = snapshot.Get(XY(0, 0)).ValueOrDie().int_amount();
+    for (int y = 0; y < kHeight; ++y) {
+      ASSERT_THAT(snapshot.Get(XY(1, y)),
+                  IsOkAndHolds(Property(&Amount::int_amount, Eq(a1 * y))))
+          << "y=" << y;
+    }
+  }
+  writer.join();
+}
+
+TEST(DataEdge, Column) {
+  SSheet latis;
+  // Column A holds rows 3-5 and 9; the sheet reaches down to row 11.
+  for (const char *a1 : {"A3", "A4", "A5", "A9", "B11"}) {
+    latis.Set(XY::From(a1).ValueOrDie(), "1");
+  }
+  const auto down = [&latis](const char *a1) {
+    return latis.DataEdge(XY::From(a1).ValueOrDie(), 0, 1).ToA1();
+  };
+  const auto up = [&latis](const char *a1) {
+    return latis.DataEdge(XY::From(a1).ValueOrDie(), 0, -1).ToA1();
+  };
+
+  // Into the first run, along it, then on to the next.
+  EXPECT_THAT(down("A1"), Eq("A3"));
+  EXPECT_THAT(down("A3"), Eq("A5"));
+  EXPECT_THAT(down("A5"), Eq("A9"));
+  // Past the last run, to the edge of the sheet.
+  EXPECT_THAT(down("A9"), Eq("A11"));
+  // Beyond the edge of the sheet, one step at a time.
+  EXPECT_THAT(down("A11"), Eq("A12"));
+
+  EXPECT_THAT(up("A9"), Eq("A5"));
+  EXPECT_THAT(up("A5"), Eq("A3"));
+  EXPECT_THAT(up("A3"), Eq("A1"));
+  EXPECT_THAT(up("A1"), Eq("A1"));
+}
+
+TEST(DataEdge, Row) {
+  SSheet latis;
+  for (const char *a1 : {"B1", "C1", "F1"}) {
+    latis.Set(XY::From(a1).ValueOrDie(), "1");
+  }
+  const auto right = [&latis](const char *a1) {
+    return latis.DataEdge(XY::From(a1).ValueOrDie(), 1, 0).ToA1();
+  };
+  const auto left = [&latis](const char *a1) {
+    return latis.DataEdge(XY::From(a1).ValueOrDie(), -1, 0).ToA1();
+  };
+
+  EXPECT_THAT(right("A1"), Eq("B1"));
+  EXPECT_THAT(right("B1"), Eq("C1"));
+  EXPECT_THAT(right("C1"), Eq("F1"));
+  EXPECT_THAT(right("F1"), Eq("G1"));
+  EXPECT_THAT(left("F1"), Eq("C1"));
+  EXPECT_THAT(left("C1"), Eq("B1"));
+  EXPECT_THAT(left("B1"), Eq("A1"));
+}
+
+TEST(DataEdge, FarApart) {
+  SSheet latis;
+  for (const char *a1 : {"A1", "A2", "A100000", "ZZ1"}) {
+    latis.Set(XY::From(a1).ValueOrDie(), "1");
+  }
+
+  EXPECT_THAT(latis.DataEdge(XY::From("A1").ValueOrDie(), 0, 1).ToA1(),
+              Eq("A2"));
+  EXPECT_THAT(latis.DataEdge(XY::From("A2").ValueOrDie(), 0, 1).ToA1(),
+              Eq("A100000"));
+  EXPECT_THAT(latis.DataEdge(XY::From("A100000").ValueOrDie(), 0, -1).ToA1(),
+              Eq("A2"));
+  EXPECT_THAT(latis.DataEdge(XY::From("A1").ValueOrDie(), 1, 0).ToA1(),
+              Eq("ZZ1"));
+  EXPECT_THAT(latis.DataEdge(XY::From("B2").ValueOrDie(), 1, 0).ToA1(),
+              Eq("ZZ2"));
+}
+
 } // namespace
 } // namespace latis
@@ -21,13 +21,27 @@
 #include "src/xy.h"
 
 #include "absl/time/time.h"
+#include "absl/types/span.h"
 #include "google/protobuf/stubs/status.h"
 #include "google/protobuf/stubs/status_macros.h"
 #include "google/protobuf/stubs/statusor.h"
 
+#include <functional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
 namespace latis {
 
+// The cells recalculated by one call into the sheet, in the order they were
+// recalculated. Doesn't include the cell a Set() or Clear() is for, though
+// does include those of a SetBatch().
+struct ChangeSet {
+  std::vector<XY> cells;
+};
+
 using HasChangedCb = std::function<void(const Cell &)>;
+using ChangeSetCb = std::function<void(const ChangeSet &)>;
 using EditedTimeCb = std::function<void(absl::Time)>;
 
 // SSheetInterface is the spreadsheet engine. It doesn't know anything about
@@ -39,12 +53,19 @@ public:
   virtual ::google::protobuf::util::StatusOr<Amount>
   Set(XY xy, std::string_view input) = 0;
 
+  // Sets every cell of |batch| in one go: all of them or, if any can't be
+  // parsed or together they would make a cycle, none. Cells of the batch may
+  // refer to one another, and whatever depends on them is recalculated once.
+  virtual ::google::protobuf::util::Status
+  SetBatch(absl::Span<const std::pair<XY, std::string_view>> batch) = 0;
+
   virtual void Clear(XY xy) = 0;
 
   virtual ::google::protobuf::util::Status
   WriteTo(LatisMsg *latis_msg) const = 0;
 
   virtual void RegisterCallback(HasChangedCb has_changed_cb) = 0;
+  virtual void RegisterChangeSetCallback(ChangeSetCb change_set_cb) = 0;
   virtual void RegisterEditedTimeCallback(EditedTimeCb edited_time_cb) = 0;
 
   virtual absl::optional<std::string> Title() const = 0;
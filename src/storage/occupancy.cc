@@ -0,0 +1,136 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/storage/occupancy.h"
+
+#include <atomic>
+#include <cassert>
+
+namespace latis {
+namespace storage {
+
+namespace {
+
+constexpr int kChunkSize = Occupancy::kChunkSize;
+
+// Floor division, so that negative indices land in the right chunk too.
+int ChunkOf(int i) {
+  return i >= 0 ? i / kChunkSize : -((-i - 1) / kChunkSize) - 1;
+}
+int OffsetOf(int i) { return i - (ChunkOf(i) * kChunkSize); }
+
+int CountTrailingZeros(uint64_t word) { return __builtin_ctzll(word); }
+int CountLeadingZeros(uint64_t word) { return __builtin_clzll(word); }
+
+// As in tile_store.cc: true if |p| may be written to without a copy of the
+// Occupancy seeing.
+template <typename T> //
+bool Unshared(const std::shared_ptr<T> &p) {
+  if (p.use_count() != 1) {
+    return false;
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return true;
+}
+
+} // namespace
+
+void Occupancy::Counts::Increment(int i) {
+  std::shared_ptr<Chunk> &chunk = chunks_[ChunkOf(i)];
+  if (chunk == nullptr) {
+    chunk = std::make_shared<Chunk>();
+  } else if (!Unshared(chunk)) {
+    // Shared with a copy, which keeps the original.
+    chunk = std::make_shared<Chunk>(*chunk);
+  }
+  const int offset = OffsetOf(i);
+  if (chunk->counts[offset]++ == 0) {
+    chunk->nonzero[offset / 64] |= uint64_t{1} << (offset % 64);
+    chunk->size++;
+  }
+}
+
+void Occupancy::Counts::Decrement(int i) {
+  const auto it = chunks_.find(ChunkOf(i));
+  assert(it != chunks_.end());
+  std::shared_ptr<Chunk> &chunk = it->second;
+  const int offset = OffsetOf(i);
+  assert(chunk->counts[offset] > 0);
+  if (chunk->counts[offset] == 1 && chunk->size == 1) {
+    chunks_.erase(it);
+    return;
+  }
+  if (!Unshared(chunk)) {
+    chunk = std::make_shared<Chunk>(*chunk);
+  }
+  if (--chunk->counts[offset] == 0) {
+    chunk->nonzero[offset / 64] &= ~(uint64_t{1} << (offset % 64));
+    chunk->size--;
+  }
+}
+
+absl::optional<int> Occupancy::Counts::Lowest() const {
+  if (chunks_.empty()) {
+    return absl::nullopt;
+  }
+  const auto &entry = *chunks_.begin();
+  for (int w = 0; w < kChunkSize / 64; ++w) {
+    if (const uint64_t word = entry.second->nonzero[w]; word != 0) {
+      return (entry.first * kChunkSize) + (w * 64) + CountTrailingZeros(word);
+    }
+  }
+  assert(false);
+  return absl::nullopt;
+}
+
+absl::optional<int> Occupancy::Counts::Highest() const {
+  if (chunks_.empty()) {
+    return absl::nullopt;
+  }
+  const auto &entry = *chunks_.rbegin();
+  for (int w = (kChunkSize / 64) - 1; w >= 0; --w) {
+    if (const uint64_t word = entry.second->nonzero[w]; word != 0) {
+      return (entry.first * kChunkSize) + (w * 64) + 63 -
+             CountLeadingZeros(word);
+    }
+  }
+  assert(false);
+  return absl::nullopt;
+}
+
+int Occupancy::Counts::CountOf(int i) const {
+  const auto it = chunks_.find(ChunkOf(i));
+  return it == chunks_.end() ? 0 : it->second->counts[OffsetOf(i)];
+}
+
+void Occupancy::Add(XY xy) {
+  rows_.Increment(xy.Y());
+  cols_.Increment(xy.X());
+}
+
+void Occupancy::Remove(XY xy) {
+  rows_.Decrement(xy.Y());
+  cols_.Decrement(xy.X());
+}
+
+absl::optional<int> Occupancy::MinY() const { return rows_.Lowest(); }
+absl::optional<int> Occupancy::MaxY() const { return rows_.Highest(); }
+absl::optional<int> Occupancy::MinX() const { return cols_.Lowest(); }
+absl::optional<int> Occupancy::MaxX() const { return cols_.Highest(); }
+
+int Occupancy::CountInRow(int y) const { return rows_.CountOf(y); }
+int Occupancy::CountInColumn(int x) const { return cols_.CountOf(x); }
+
+} // namespace storage
+} // namespace latis
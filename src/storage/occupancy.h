@@ -0,0 +1,97 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_STORAGE_OCCUPANCY_H_
+#define SRC_STORAGE_OCCUPANCY_H_
+
+#include "src/xy.h"
+
+#include "absl/types/optional.h"
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+
+namespace latis {
+namespace storage {
+
+// Occupancy counts the cells in every row and column, so that the extent of a
+// sheet is known without scanning it. The counts are kept in chunks of
+// kChunkSize rows / columns, only for chunks with a cell in them. Add() and
+// Remove() are O(log n) in the number of chunks; the Min*() / Max*() queries
+// are O(kChunkSize / 64) at worst.
+//
+// A copy shares every chunk with the original until one of them writes to it,
+// at which point the writer takes a private copy of just that chunk. So a copy
+// costs O(number of chunks), not O(number of rows and columns).
+//
+// Not thread-safe, but separate copies may be used from separate threads.
+class Occupancy {
+public:
+  // Records a cell at |xy|. Must be called once per new cell.
+  void Add(XY xy);
+  // Forgets a cell at |xy|. Must be balanced with a prior Add(xy).
+  void Remove(XY xy);
+
+  bool empty() const { return rows_.empty(); }
+
+  static constexpr int kChunkSize = 1024;
+
+  // The smallest / largest row (y) or column (x) with a cell in it, if any.
+  absl::optional<int> MinY() const;
+  absl::optional<int> MaxY() const;
+  absl::optional<int> MinX() const;
+  absl::optional<int> MaxX() const;
+
+  // The number of cells in row |y| / column |x|.
+  int CountInRow(int y) const;
+  int CountInColumn(int x) const;
+
+private:
+  // Cell counts along one axis, i.e. per row or per column.
+  class Counts {
+  public:
+    void Increment(int i);
+    void Decrement(int i);
+
+    bool empty() const { return chunks_.empty(); }
+    absl::optional<int> Lowest() const;
+    absl::optional<int> Highest() const;
+    int CountOf(int i) const;
+
+  private:
+    struct Chunk {
+      std::array<int, kChunkSize> counts{};
+      // Which of |counts| are nonzero, so the lowest / highest is a bit scan.
+      std::array<uint64_t, kChunkSize / 64> nonzero{};
+      int size{0};
+    };
+
+    // i / kChunkSize => that chunk, if any i in it has a count.
+    std::map<int, std::shared_ptr<Chunk>> chunks_;
+  };
+
+  // y => # of cells in that row.
+  Counts rows_;
+  // x => # of cells in that column.
+  Counts cols_;
+};
+
+} // namespace storage
+} // namespace latis
+
+#endif // SRC_STORAGE_OCCUPANCY_H_
@@ -0,0 +1,103 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/storage/occupancy.h"
+
+#include "src/xy.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace latis {
+namespace storage {
+namespace {
+
+using ::testing::Eq;
+using ::testing::Optional;
+
+TEST(Occupancy, Empty) {
+  Occupancy occupancy;
+  EXPECT_TRUE(occupancy.empty());
+  EXPECT_EQ(occupancy.MaxX(), absl::nullopt);
+  EXPECT_EQ(occupancy.MaxY(), absl::nullopt);
+  EXPECT_EQ(occupancy.CountInRow(0), 0);
+}
+
+TEST(Occupancy, TracksExtent) {
+  Occupancy occupancy;
+  occupancy.Add(XY(2, 5));
+  occupancy.Add(XY(7, 1));
+  occupancy.Add(XY(3, 5));
+
+  EXPECT_THAT(occupancy.MinX(), Optional(Eq(2)));
+  EXPECT_THAT(occupancy.MaxX(), Optional(Eq(7)));
+  EXPECT_THAT(occupancy.MinY(), Optional(Eq(1)));
+  EXPECT_THAT(occupancy.MaxY(), Optional(Eq(5)));
+  EXPECT_EQ(occupancy.CountInRow(5), 2);
+  EXPECT_EQ(occupancy.CountInColumn(7), 1);
+}
+
+TEST(Occupancy, ShrinksOnRemove) {
+  Occupancy occupancy;
+  occupancy.Add(XY(2, 5));
+  occupancy.Add(XY(7, 1));
+  occupancy.Add(XY(3, 5));
+
+  occupancy.Remove(XY(7, 1));
+  EXPECT_THAT(occupancy.MaxX(), Optional(Eq(3)));
+  EXPECT_THAT(occupancy.MinY(), Optional(Eq(5)));
+
+  occupancy.Remove(XY(2, 5));
+  EXPECT_EQ(occupancy.CountInRow(5), 1);
+  occupancy.Remove(XY(3, 5));
+  EXPECT_TRUE(occupancy.empty());
+}
+
+TEST(Occupancy, SpansChunks) {
+  Occupancy occupancy;
+  occupancy.Add(XY(-1, 3 * Occupancy::kChunkSize));
+  occupancy.Add(XY(Occupancy::kChunkSize - 1, -5000));
+
+  EXPECT_THAT(occupancy.MinX(), Optional(Eq(-1)));
+  EXPECT_THAT(occupancy.MaxX(), Optional(Eq(Occupancy::kChunkSize - 1)));
+  EXPECT_THAT(occupancy.MinY(), Optional(Eq(-5000)));
+  EXPECT_THAT(occupancy.MaxY(), Optional(Eq(3 * Occupancy::kChunkSize)));
+
+  occupancy.Remove(XY(-1, 3 * Occupancy::kChunkSize));
+  EXPECT_THAT(occupancy.MinX(), Optional(Eq(Occupancy::kChunkSize - 1)));
+  EXPECT_THAT(occupancy.MaxY(), Optional(Eq(-5000)));
+}
+
+TEST(Occupancy, CopiesAreIndependent) {
+  Occupancy occupancy;
+  occupancy.Add(XY(2, 5));
+  occupancy.Add(XY(3, 5000));
+
+  Occupancy copy = occupancy;
+  occupancy.Add(XY(4, 5));
+  occupancy.Remove(XY(3, 5000));
+
+  EXPECT_EQ(copy.CountInRow(5), 1);
+  EXPECT_EQ(copy.CountInRow(5000), 1);
+  EXPECT_THAT(copy.MaxX(), Optional(Eq(3)));
+  EXPECT_THAT(copy.MaxY(), Optional(Eq(5000)));
+
+  copy.Remove(XY(2, 5));
+  EXPECT_EQ(occupancy.CountInRow(5), 2);
+  EXPECT_THAT(occupancy.MaxY(), Optional(Eq(5)));
+}
+
+} // namespace
+} // namespace storage
+} // namespace latis
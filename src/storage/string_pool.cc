@@ -0,0 +1,66 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/storage/string_pool.h"
+
+#include "absl/memory/memory.h"
+
+#include <cassert>
+
+namespace latis {
+namespace storage {
+
+StringPool::Id StringPool::Intern(absl::string_view s) {
+  absl::MutexLock lock(&mu_);
+  if (const auto it = ids_.find(s); it != ids_.end()) {
+    entries_[it->second].refcount++;
+    return it->second;
+  }
+
+  Id id;
+  if (!free_ids_.empty()) {
+    id = free_ids_.back();
+    free_ids_.pop_back();
+  } else {
+    id = static_cast<Id>(entries_.size());
+    entries_.emplace_back();
+  }
+
+  Entry *entry = &entries_[id];
+  entry->value = absl::make_unique<std::string>(s);
+  entry->refcount = 1;
+  ids_[*entry->value] = id;
+  return id;
+}
+
+void StringPool::Retain(Id id) {
+  absl::MutexLock lock(&mu_);
+  assert(entries_[id].refcount > 0);
+  entries_[id].refcount++;
+}
+
+void StringPool::Release(Id id) {
+  absl::MutexLock lock(&mu_);
+  Entry *entry = &entries_[id];
+  assert(entry->refcount > 0);
+  if (--entry->refcount > 0) {
+    return;
+  }
+  ids_.erase(*entry->value);
+  entry->value.reset();
+  free_ids_.push_back(id);
+}
+
+} // namespace storage
+} // namespace latis
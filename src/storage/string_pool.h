@@ -0,0 +1,87 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_STORAGE_STRING_POOL_H_
+#define SRC_STORAGE_STRING_POOL_H_
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace latis {
+namespace storage {
+
+// Interns strings behind small integer ids, so that columns of string values
+// can hold four bytes per cell instead of a heap-allocated std::string.
+//
+// Ids are reference counted. Every Intern() must be matched by exactly one
+// Release() of the returned id; once an id's count falls to zero it may be
+// handed out again for a different string.
+//
+// Thread-safe, so that copies of a TileStore sharing one pool can be used from
+// different threads.
+class StringPool {
+public:
+  using Id = uint32_t;
+
+  StringPool() {}
+
+  // Returns the id for |s|, adding it to the pool if necessary.
+  Id Intern(absl::string_view s);
+
+  // Takes one more reference on an already-interned |id|.
+  void Retain(Id id);
+
+  // Drops a reference on |id|.
+  void Release(Id id);
+
+  // Returns the string behind |id|. |id| must be live, and the string stays
+  // put for as long as it is.
+  const std::string &Get(Id id) const {
+    absl::ReaderMutexLock lock(&mu_);
+    return *entries_[id].value;
+  }
+
+  // The number of distinct live strings.
+  size_t size() const {
+    absl::ReaderMutexLock lock(&mu_);
+    return ids_.size();
+  }
+
+private:
+  struct Entry {
+    // Heap-allocated so that the string_view keys in |ids_| stay valid while
+    // |entries_| grows.
+    std::unique_ptr<std::string> value;
+    uint32_t refcount{0};
+  };
+
+  mutable absl::Mutex mu_;
+  std::vector<Entry> entries_ ABSL_GUARDED_BY(mu_);
+  std::vector<Id> free_ids_ ABSL_GUARDED_BY(mu_);
+  absl::flat_hash_map<absl::string_view, Id> ids_ ABSL_GUARDED_BY(mu_);
+};
+
+} // namespace storage
+} // namespace latis
+
+#endif // SRC_STORAGE_STRING_POOL_H_
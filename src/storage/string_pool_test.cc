@@ -0,0 +1,64 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/storage/string_pool.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace latis {
+namespace storage {
+namespace {
+
+TEST(StringPool, InternsOnce) {
+  StringPool pool;
+  const StringPool::Id a = pool.Intern("foo");
+  const StringPool::Id b = pool.Intern("foo");
+  EXPECT_EQ(a, b);
+  EXPECT_EQ(pool.Get(a), "foo");
+  EXPECT_EQ(pool.size(), 1);
+}
+
+TEST(StringPool, DistinctStrings) {
+  StringPool pool;
+  const StringPool::Id a = pool.Intern("foo");
+  const StringPool::Id b = pool.Intern("bar");
+  EXPECT_NE(a, b);
+  EXPECT_EQ(pool.Get(a), "foo");
+  EXPECT_EQ(pool.Get(b), "bar");
+  EXPECT_EQ(pool.size(), 2);
+}
+
+TEST(StringPool, ReleaseFreesAtZero) {
+  StringPool pool;
+  const StringPool::Id a = pool.Intern("foo");
+  pool.Retain(a);
+  pool.Release(a);
+  EXPECT_EQ(pool.size(), 1);
+  pool.Release(a);
+  EXPECT_EQ(pool.size(), 0);
+}
+
+TEST(StringPool, ReusesFreedIds) {
+  StringPool pool;
+  const StringPool::Id a = pool.Intern("foo");
+  pool.Release(a);
+  const StringPool::Id b = pool.Intern("bar");
+  EXPECT_EQ(a, b);
+  EXPECT_EQ(pool.Get(b), "bar");
+}
+
+} // namespace
+} // namespace storage
+} // namespace latis
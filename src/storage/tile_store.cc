@@ -0,0 +1,679 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/storage/tile_store.h"
+
+#include "absl/memory/memory.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <google/protobuf/util/message_differencer.h>
+
+namespace latis {
+namespace storage {
+
+namespace {
+
+constexpr int kTileSize = TileStore::kTileSize;
+constexpr int kTileArea = kTileSize * kTileSize;
+
+// Floor division, so that negative coordinates land in the right tile too.
+int TileIndexOf(int v) {
+  return v >= 0 ? v / kTileSize : -((-v - 1) / kTileSize) - 1;
+}
+int OffsetOf(int v) { return v - (TileIndexOf(v) * kTileSize); }
+
+XY TileKeyOf(XY xy) { return XY(TileIndexOf(xy.X()), TileIndexOf(xy.Y())); }
+int SlotOf(XY xy) { return (OffsetOf(xy.Y()) * kTileSize) + OffsetOf(xy.X()); }
+
+constexpr int kBlockSize = TileStore::kBlockSize;
+constexpr int kBlockWidth = kBlockSize * kTileSize;
+
+// As above, one level up: tile indices to blocks.
+int BlockIndexOf(int t) {
+  return t >= 0 ? t / kBlockSize : -((-t - 1) / kBlockSize) - 1;
+}
+XY BlockKeyOf(XY xy) {
+  const XY tile = TileKeyOf(xy);
+  return XY(BlockIndexOf(tile.X()), BlockIndexOf(tile.Y()));
+}
+int TileSlotOf(XY xy) {
+  const XY tile = TileKeyOf(xy);
+  const XY block = BlockKeyOf(xy);
+  return ((tile.Y() - (block.Y() * kBlockSize)) * kBlockSize) +
+         (tile.X() - (block.X() * kBlockSize));
+}
+
+// The number of steps of |step|, +-1, from |v| up to and including the last
+// in its span of |width|, i.e. its tile or block.
+int StepsToEdge(int v, int step, int width) {
+  const int offset = v >= 0 ? v % width : (width - 1) - ((-v - 1) % width);
+  return step > 0 ? width - offset : offset + 1;
+}
+
+// A dense column of kTileArea values, allocated on first write.
+template <typename T> //
+class Column {
+public:
+  Column() = default;
+  Column(const Column &other)
+      : values_(other.values_ == nullptr
+                    ? nullptr
+                    : absl::make_unique<std::array<T, kTileArea>>(
+                          *other.values_)) {}
+  Column &operator=(const Column &) = delete;
+
+  const T &Get(int slot) const {
+    assert(values_ != nullptr);
+    return (*values_)[slot];
+  }
+  T *Mutable(int slot) {
+    if (values_ == nullptr) {
+      values_ = absl::make_unique<std::array<T, kTileArea>>();
+    }
+    return &(*values_)[slot];
+  }
+
+private:
+  std::unique_ptr<std::array<T, kTileArea>> values_;
+};
+
+struct MoneyValue {
+  int32_t dollars;
+  int32_t cents;
+  Money::Currency currency;
+};
+
+struct TimestampValue {
+  int64_t seconds;
+  int32_t nanos;
+};
+
+// True if |p| is the only reference to what it points at, so that it can be
+// written to without anyone else seeing.
+template <typename T> //
+bool Unshared(const std::shared_ptr<T> &p) {
+  if (p.use_count() != 1) {
+    return false;
+  }
+  // Pairs with the release by whichever other owner let go last, so that
+  // their reads happen before our writes.
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return true;
+}
+
+} // namespace
+
+class Tile {
+public:
+  explicit Tile(StringPool *strings) : strings_(strings) {}
+
+  ~Tile() {
+    ForEachSlot([this](int, int, int slot) { ClearValue(slot); });
+  }
+
+  // A copy of this tile, with its own references on the strings it holds.
+  std::shared_ptr<Tile> Clone() const {
+    std::shared_ptr<Tile> clone(new Tile(*this));
+    ForEachSlot([this](int, int, int slot) {
+      if (kinds_[slot] == Kind::kString || kinds_[slot] == Kind::kError) {
+        strings_->Retain(strings_column_.Get(slot));
+      }
+    });
+    return clone;
+  }
+
+  Tile &operator=(const Tile &) = delete;
+
+  int count() const { return count_; }
+
+  bool Contains(int slot) const {
+    return (occupied_[slot / kTileSize] >> (slot % kTileSize)) & 1;
+  }
+
+  // The number of slots from |slot| by steps of (dx, dy), up to the edge of
+  // the tile, which all are, or all aren't, |occupied|.
+  int RunLength(int slot, int dx, int dy, bool occupied) const {
+    const int x = slot % kTileSize;
+    const int y = slot / kTileSize;
+    if (dy == 0) {
+      // NB: A row is one word of the bitmap, so this is a bit scan for the
+      // first slot which differs.
+      const uint64_t differs = occupied ? ~occupied_[y] : occupied_[y];
+      if (dx > 0) {
+        const uint64_t ahead = differs >> x;
+        return ahead == 0 ? kTileSize - x : __builtin_ctzll(ahead);
+      }
+      const uint64_t ahead = differs << (kTileSize - 1 - x);
+      return ahead == 0 ? x + 1 : __builtin_clzll(ahead);
+    }
+    int n = 0;
+    for (int row = y; row >= 0 && row < kTileSize &&
+                      Contains((row * kTileSize) + x) == occupied;
+         row += dy) {
+      n++;
+    }
+    return n;
+  }
+
+  // Marks |slot| as occupied, if it isn't already. Returns true if it wasn't.
+  bool Occupy(int slot) {
+    if (Contains(slot)) {
+      return false;
+    }
+    occupied_[slot / kTileSize] |= uint64_t{1} << (slot % kTileSize);
+    count_++;
+    return true;
+  }
+
+  // Empties |slot|. Returns true if it was occupied.
+  bool Vacate(int slot) {
+    if (!Contains(slot)) {
+      return false;
+    }
+    ClearValue(slot);
+    ClearExpression(slot);
+    occupied_[slot / kTileSize] &= ~(uint64_t{1} << (slot % kTileSize));
+    count_--;
+    return true;
+  }
+
+  void SetCell(int slot, const Cell &cell) {
+    const Formula &formula = cell.formula();
+
+    ClearExpression(slot);
+    if (formula.has_cached_amount()) {
+      SetAmount(slot, formula.cached_amount());
+    } else if (formula.has_error_msg()) {
+      SetErrorMsg(slot, formula.error_msg());
+    } else {
+      ClearValue(slot);
+    }
+
+    if (!formula.has_expression()) {
+      return;
+    }
+    // Most cells are literals, whose expression is just a copy of their value.
+    // Don't store those twice.
+    if (formula.expression().has_value() && formula.has_cached_amount() &&
+        ::google::protobuf::util::MessageDifferencer::Equals(
+            formula.expression().value(), formula.cached_amount())) {
+      expression_kinds_[slot] = ExpressionKind::kLiteral;
+    } else {
+      expression_kinds_[slot] = ExpressionKind::kStored;
+      expressions_[slot] = formula.expression();
+    }
+  }
+
+  void SetAmount(int slot, const Amount &amount) {
+    PinLiteral(slot);
+    ClearValue(slot);
+    switch (amount.amount_demux_case()) {
+    case Amount::AMOUNT_DEMUX_NOT_SET: {
+      kinds_[slot] = Kind::kEmpty;
+      break;
+    }
+    case Amount::kStrAmount: {
+      kinds_[slot] = Kind::kString;
+      *strings_column_.Mutable(slot) = strings_->Intern(amount.str_amount());
+      break;
+    }
+    case Amount::kIntAmount: {
+      kinds_[slot] = Kind::kInt;
+      *ints_.Mutable(slot) = amount.int_amount();
+      break;
+    }
+    case Amount::kDoubleAmount: {
+      kinds_[slot] = Kind::kDouble;
+      *doubles_.Mutable(slot) = amount.double_amount();
+      break;
+    }
+    case Amount::kTimestampAmount: {
+      kinds_[slot] = Kind::kTimestamp;
+      *timestamps_.Mutable(slot) = {amount.timestamp_amount().seconds(),
+                                    amount.timestamp_amount().nanos()};
+      break;
+    }
+    case Amount::kMoneyAmount: {
+      kinds_[slot] = Kind::kMoney;
+      *moneys_.Mutable(slot) = {amount.money_amount().dollars(),
+                                amount.money_amount().cents(),
+                                amount.money_amount().currency()};
+      break;
+    }
+    case Amount::kBoolAmount: {
+      kinds_[slot] = Kind::kBool;
+      if (amount.bool_amount()) {
+        bools_[slot / kTileSize] |= uint64_t{1} << (slot % kTileSize);
+      } else {
+        bools_[slot / kTileSize] &= ~(uint64_t{1} << (slot % kTileSize));
+      }
+      break;
+    }
+    }
+  }
+
+  void SetErrorMsg(int slot, absl::string_view error_msg) {
+    PinLiteral(slot);
+    ClearValue(slot);
+    kinds_[slot] = Kind::kError;
+    *strings_column_.Mutable(slot) = strings_->Intern(error_msg);
+  }
+
+  // Writes the cached_amount or error_msg of |slot| into |formula|.
+  void GetValue(int slot, Formula *formula) const {
+    switch (kinds_[slot]) {
+    case Kind::kNone: {
+      break;
+    }
+    case Kind::kError: {
+      formula->set_error_msg(strings_->Get(strings_column_.Get(slot)));
+      break;
+    }
+    default: {
+      GetAmount(slot, formula->mutable_cached_amount());
+      break;
+    }
+    }
+  }
+
+  // The cached amount of |slot|, or nothing if it holds an error.
+  absl::optional<formula::Value> Lookup(int slot) const {
+    using formula::Value;
+    switch (kinds_[slot]) {
+    case Kind::kError: {
+      return absl::nullopt;
+    }
+    case Kind::kString: {
+      return Value::String(strings_->Get(strings_column_.Get(slot)));
+    }
+    case Kind::kInt: {
+      return Value::Int(ints_.Get(slot));
+    }
+    case Kind::kDouble: {
+      return Value::Double(doubles_.Get(slot));
+    }
+    case Kind::kTimestamp: {
+      const TimestampValue &t = timestamps_.Get(slot);
+      return Value::OfTimestamp(t.seconds, t.nanos);
+    }
+    case Kind::kMoney: {
+      const MoneyValue &m = moneys_.Get(slot);
+      return Value::OfMoney(m.dollars, m.cents, m.currency);
+    }
+    case Kind::kBool: {
+      return Value::Bool((bools_[slot / kTileSize] >> (slot % kTileSize)) & 1);
+    }
+    default: {
+      return Value();
+    }
+    }
+  }
+
+  // Writes the expression of |slot| into |formula|, if it has one.
+  void GetExpression(int slot, Formula *formula) const {
+    switch (expression_kinds_[slot]) {
+    case ExpressionKind::kNone: {
+      break;
+    }
+    case ExpressionKind::kLiteral: {
+      GetAmount(slot, formula->mutable_expression()->mutable_value());
+      break;
+    }
+    case ExpressionKind::kStored: {
+      *formula->mutable_expression() = expressions_.at(slot);
+      break;
+    }
+    }
+  }
+
+  // Visits every occupied slot as fn(x, y, slot), where x and y are offsets
+  // within the tile.
+  template <typename Fn> //
+  void ForEachSlot(const Fn &fn) const {
+    for (int y = 0; y < kTileSize; ++y) {
+      uint64_t row = occupied_[y];
+      while (row != 0) {
+        const int x = __builtin_ctzll(row);
+        row &= row - 1;
+        fn(x, y, (y * kTileSize) + x);
+      }
+    }
+  }
+
+private:
+  // Only for Clone(), which sorts out the strings.
+  Tile(const Tile &) = default;
+
+  enum class Kind : uint8_t {
+    kNone,  // No cached_amount nor error_msg.
+    kEmpty, // A cached_amount with nothing in it.
+    kInt,
+    kDouble,
+    kBool,
+    kMoney,
+    kTimestamp,
+    kString,
+    kError,
+  };
+
+  enum class ExpressionKind : uint8_t {
+    kNone,    // No expression.
+    kLiteral, // The expression is `value { <cached amount> }`.
+    kStored,  // The expression lives in |expressions_|.
+  };
+
+  void GetAmount(int slot, Amount *amount) const {
+    switch (kinds_[slot]) {
+    case Kind::kString: {
+      amount->set_str_amount(strings_->Get(strings_column_.Get(slot)));
+      break;
+    }
+    case Kind::kInt: {
+      amount->set_int_amount(ints_.Get(slot));
+      break;
+    }
+    case Kind::kDouble: {
+      amount->set_double_amount(doubles_.Get(slot));
+      break;
+    }
+    case Kind::kTimestamp: {
+      const TimestampValue &t = timestamps_.Get(slot);
+      amount->mutable_timestamp_amount()->set_seconds(t.seconds);
+      amount->mutable_timestamp_amount()->set_nanos(t.nanos);
+      break;
+    }
+    case Kind::kMoney: {
+      const MoneyValue &m = moneys_.Get(slot);
+      Money *money = amount->mutable_money_amount();
+      money->set_dollars(m.dollars);
+      money->set_cents(m.cents);
+      money->set_currency(m.currency);
+      break;
+    }
+    case Kind::kBool: {
+      amount->set_bool_amount((bools_[slot / kTileSize] >> (slot % kTileSize)) &
+                              1);
+      break;
+    }
+    default: {
+      break;
+    }
+    }
+  }
+
+  // A literal expression is implied by the cached value, so before that value
+  // changes the expression has to be written down for real.
+  void PinLiteral(int slot) {
+    if (expression_kinds_[slot] != ExpressionKind::kLiteral) {
+      return;
+    }
+    Formula formula;
+    GetExpression(slot, &formula);
+    expression_kinds_[slot] = ExpressionKind::kStored;
+    expressions_[slot] = formula.expression();
+  }
+
+  void ClearValue(int slot) {
+    if (kinds_[slot] == Kind::kString || kinds_[slot] == Kind::kError) {
+      strings_->Release(strings_column_.Get(slot));
+    }
+    kinds_[slot] = Kind::kNone;
+  }
+
+  void ClearExpression(int slot) {
+    if (expression_kinds_[slot] == ExpressionKind::kStored) {
+      expressions_.erase(slot);
+    }
+    expression_kinds_[slot] = ExpressionKind::kNone;
+  }
+
+  StringPool *strings_;
+
+  int count_{0};
+  std::array<uint64_t, kTileSize> occupied_{};
+
+  std::array<Kind, kTileArea> kinds_{};
+  std::array<ExpressionKind, kTileArea> expression_kinds_{};
+
+  // Typed value columns.
+  Column<int32_t> ints_;
+  Column<double> doubles_;
+  Column<MoneyValue> moneys_;
+  Column<TimestampValue> timestamps_;
+  Column<StringPool::Id> strings_column_;
+  std::array<uint64_t, kTileSize> bools_{};
+
+  // Only the non-literal expressions.
+  absl::flat_hash_map<uint16_t, Expression> expressions_;
+};
+
+struct TileStore::Block {
+  std::array<std::shared_ptr<Tile>, kBlockSize * kBlockSize> tiles;
+  // The number of non-null |tiles|.
+  int size{0};
+};
+
+TileStore::TileStore()
+    : strings_(std::make_shared<StringPool>()),
+      tiles_(std::make_shared<Tiles>()),
+      occupancy_(std::make_shared<Occupancy>()) {}
+
+TileStore::~TileStore() {}
+
+TileStore::TileStore(const TileStore &other) = default;
+
+TileStore &TileStore::operator=(const TileStore &other) = default;
+
+bool TileStore::Contains(XY xy) const {
+  const Tile *tile = FindTile(xy);
+  return tile != nullptr && tile->Contains(SlotOf(xy));
+}
+
+absl::optional<Cell> TileStore::Get(XY xy) const {
+  const Tile *tile = FindTile(xy);
+  const int slot = SlotOf(xy);
+  if (tile == nullptr || !tile->Contains(slot)) {
+    return absl::nullopt;
+  }
+  Cell cell;
+  *cell.mutable_point_location() = xy.ToPointLocation();
+  tile->GetExpression(slot, cell.mutable_formula());
+  tile->GetValue(slot, cell.mutable_formula());
+  return cell;
+}
+
+absl::optional<Formula> TileStore::GetValue(XY xy) const {
+  const Tile *tile = FindTile(xy);
+  const int slot = SlotOf(xy);
+  if (tile == nullptr || !tile->Contains(slot)) {
+    return absl::nullopt;
+  }
+  Formula formula;
+  tile->GetValue(slot, &formula);
+  return formula;
+}
+
+absl::optional<formula::Value> TileStore::Lookup(XY xy) const {
+  const Tile *tile = FindTile(xy);
+  const int slot = SlotOf(xy);
+  if (tile == nullptr || !tile->Contains(slot)) {
+    return absl::nullopt;
+  }
+  return tile->Lookup(slot);
+}
+
+absl::optional<Expression> TileStore::GetExpression(XY xy) const {
+  const Tile *tile = FindTile(xy);
+  const int slot = SlotOf(xy);
+  if (tile == nullptr || !tile->Contains(slot)) {
+    return absl::nullopt;
+  }
+  Formula formula;
+  tile->GetExpression(slot, &formula);
+  if (!formula.has_expression()) {
+    return absl::nullopt;
+  }
+  return formula.expression();
+}
+
+void TileStore::Set(XY xy, const Cell &cell) {
+  Tile *tile = MutableTile(xy);
+  const int slot = SlotOf(xy);
+  if (tile->Occupy(slot)) {
+    size_++;
+    MutableOccupancy()->Add(xy);
+  }
+  tile->SetCell(slot, cell);
+}
+
+void TileStore::SetAmount(XY xy, const Amount &amount) {
+  Tile *tile = MutableTile(xy);
+  const int slot = SlotOf(xy);
+  if (tile->Occupy(slot)) {
+    size_++;
+    MutableOccupancy()->Add(xy);
+  }
+  tile->SetAmount(slot, amount);
+}
+
+void TileStore::SetErrorMsg(XY xy, absl::string_view error_msg) {
+  Tile *tile = MutableTile(xy);
+  const int slot = SlotOf(xy);
+  if (tile->Occupy(slot)) {
+    size_++;
+    MutableOccupancy()->Add(xy);
+  }
+  tile->SetErrorMsg(slot, error_msg);
+}
+
+void TileStore::Erase(XY xy) {
+  if (!Contains(xy)) {
+    return;
+  }
+  MutableTile(xy)->Vacate(SlotOf(xy));
+  size_--;
+  MutableOccupancy()->Remove(xy);
+
+  Block *block = MutableBlock(xy);
+  if (std::shared_ptr<Tile> &tile = block->tiles[TileSlotOf(xy)];
+      tile->count() == 0) {
+    tile.reset();
+    if (--block->size == 0) {
+      MutableTiles()->erase(BlockKeyOf(xy));
+    }
+  }
+}
+
+int TileStore::RunLength(XY xy, int dx, int dy, bool occupied,
+                         int limit) const {
+  assert(std::abs(dx) + std::abs(dy) == 1);
+  int n = 0;
+  while (n < limit) {
+    const XY curr(xy.X() + (n * dx), xy.Y() + (n * dy));
+    // Along the line.
+    const int v = dx != 0 ? curr.X() : curr.Y();
+    const auto it = tiles_->find(BlockKeyOf(curr));
+    const Tile *tile = it == tiles_->end()
+                           ? nullptr
+                           : it->second->tiles[TileSlotOf(curr)].get();
+    if (tile != nullptr) {
+      const int run = tile->RunLength(SlotOf(curr), dx, dy, occupied);
+      n += run;
+      if (run < StepsToEdge(v, dx + dy, kTileSize)) {
+        break;
+      }
+    } else if (occupied) {
+      break;
+    } else {
+      // Nothing there, so skip the whole tile, or block.
+      n += StepsToEdge(v, dx + dy,
+                       it == tiles_->end() ? kBlockWidth : kTileSize);
+    }
+  }
+  return std::min(n, limit);
+}
+
+void TileStore::ForEach(
+    const std::function<void(XY, const Cell &)> &fn) const {
+  for (const auto &entry : *tiles_) {
+    for (int t = 0; t < kBlockSize * kBlockSize; ++t) {
+      const Tile *tile = entry.second->tiles[t].get();
+      if (tile == nullptr) {
+        continue;
+      }
+      const int x0 = ((entry.first.X() * kBlockSize) + (t % kBlockSize)) *
+                     kTileSize;
+      const int y0 = ((entry.first.Y() * kBlockSize) + (t / kBlockSize)) *
+                     kTileSize;
+      tile->ForEachSlot([&](int x, int y, int slot) {
+        const XY xy(x0 + x, y0 + y);
+        Cell cell;
+        *cell.mutable_point_location() = xy.ToPointLocation();
+        tile->GetExpression(slot, cell.mutable_formula());
+        tile->GetValue(slot, cell.mutable_formula());
+        fn(xy, cell);
+      });
+    }
+  }
+}
+
+const Tile *TileStore::FindTile(XY xy) const {
+  const auto it = tiles_->find(BlockKeyOf(xy));
+  return it == tiles_->end() ? nullptr
+                             : it->second->tiles[TileSlotOf(xy)].get();
+}
+
+Tile *TileStore::MutableTile(XY xy) {
+  Block *block = MutableBlock(xy);
+  std::shared_ptr<Tile> &tile = block->tiles[TileSlotOf(xy)];
+  if (tile == nullptr) {
+    tile = std::make_shared<Tile>(strings_.get());
+    block->size++;
+  } else if (!Unshared(tile)) {
+    tile = tile->Clone();
+  }
+  return tile.get();
+}
+
+TileStore::Block *TileStore::MutableBlock(XY xy) {
+  std::shared_ptr<Block> &block = (*MutableTiles())[BlockKeyOf(xy)];
+  if (block == nullptr) {
+    block = std::make_shared<Block>();
+  } else if (!Unshared(block)) {
+    block = std::make_shared<Block>(*block);
+  }
+  return block.get();
+}
+
+TileStore::Tiles *TileStore::MutableTiles() {
+  if (!Unshared(tiles_)) {
+    tiles_ = std::make_shared<Tiles>(*tiles_);
+  }
+  return tiles_.get();
+}
+
+Occupancy *TileStore::MutableOccupancy() {
+  if (!Unshared(occupancy_)) {
+    occupancy_ = std::make_shared<Occupancy>(*occupancy_);
+  }
+  return occupancy_.get();
+}
+
+} // namespace storage
+} // namespace latis
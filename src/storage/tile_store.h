@@ -0,0 +1,152 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_STORAGE_TILE_STORE_H_
+#define SRC_STORAGE_TILE_STORE_H_
+
+#include "proto/latis_msg.pb.h"
+#include "src/formula/value.h"
+#include "src/storage/occupancy.h"
+#include "src/storage/string_pool.h"
+#include "src/xy.h"
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+
+#include <functional>
+#include <memory>
+
+namespace latis {
+namespace storage {
+
+class Tile;
+
+// TileStore is the backing store for the cells of a spreadsheet.
+//
+// Rather than keeping a whole Cell proto per coordinate, the sheet is cut into
+// kTileSize x kTileSize tiles. Each tile holds an occupancy bitmap plus typed
+// columns (int, double, bool, money, timestamp, interned string id) for the
+// cached values of its cells. A column is only allocated once some cell in the
+// tile needs it. Expressions are only kept for cells whose expression is more
+// than a literal copy of their value.
+//
+// Cell protos are only ever built at the edges, i.e. in Get() / ForEach().
+// Lookup() reads a value without building anything.
+//
+// Copies are O(1) and copy-on-write: a copy shares every tile with the
+// original until one of them writes to it, at which point the writer takes a
+// private copy of just that tile. So a copy is a cheap point-in-time snapshot.
+// The index of tiles, and the Occupancy, are shared the same way, which
+// defers some of the copy to the first write after it: that write copies
+// the top level of each, i.e. one pointer per kBlockSize x kBlockSize tiles
+// and one per Occupancy::kChunkSize rows and columns, plus the block and
+// chunks it lands in.
+//
+// Not thread-safe, but separate copies may be used from separate threads.
+class TileStore {
+public:
+  static constexpr int kTileSize = 64;
+  static constexpr int kBlockSize = 16;
+
+  TileStore();
+  ~TileStore();
+
+  TileStore(const TileStore &other);
+  TileStore &operator=(const TileStore &other);
+
+  // Returns true if there is a cell at |xy|.
+  bool Contains(XY xy) const;
+
+  // Reconstitutes the cell at |xy|, if there is one.
+  absl::optional<Cell> Get(XY xy) const;
+
+  // Returns the value half of the formula at |xy|, i.e. its cached_amount or
+  // error_msg, without its expression. Cheaper than Get().
+  absl::optional<Formula> GetValue(XY xy) const;
+
+  // Returns the cached amount at |xy| as a formula::Value, straight from the
+  // columns, for evaluating with. Empty if there is no cell, or it holds an
+  // error. A string names the store's own copy, which stays put until the
+  // cell is next written to.
+  absl::optional<formula::Value> Lookup(XY xy) const;
+
+  // Returns the expression at |xy|, if there is a cell with one.
+  absl::optional<Expression> GetExpression(XY xy) const;
+
+  // Overwrites the cell at |xy| with |cell|. The point_location of |cell| is
+  // ignored in favor of |xy|.
+  void Set(XY xy, const Cell &cell);
+
+  // Sets the cached amount at |xy| and clears any error message. Leaves the
+  // expression untouched. Creates the cell if necessary.
+  void SetAmount(XY xy, const Amount &amount);
+
+  // Sets the error message at |xy| and clears any cached amount. Leaves the
+  // expression untouched. Creates the cell if necessary.
+  void SetErrorMsg(XY xy, absl::string_view error_msg);
+
+  // Removes the cell at |xy|, if any.
+  void Erase(XY xy);
+
+  // The number of cells, up to |limit|, along the line from |xy| by steps of
+  // (dx, dy), one of which is +-1 and the other 0, which all are, or all
+  // aren't, |occupied|. Skips empty tiles and blocks whole, and reads each
+  // row of a tile as one word of its bitmap.
+  int RunLength(XY xy, int dx, int dy, bool occupied, int limit) const;
+
+  // The number of cells in the store.
+  size_t size() const { return size_; }
+
+  // Per-row and per-column cell counts, kept up to date on every write.
+  const Occupancy &occupancy() const { return *occupancy_; }
+
+  // Invokes |fn| once for every cell in the store, in no particular order.
+  void ForEach(const std::function<void(XY, const Cell &)> &fn) const;
+
+private:
+  // kBlockSize x kBlockSize tiles, so that the index is copied a block at a
+  // time rather than a tile at a time.
+  struct Block;
+  // Only blocks with a tile in them.
+  using Tiles = absl::flat_hash_map<XY, std::shared_ptr<Block>>;
+
+  // Returns the tile containing |xy|, or nullptr if there is none.
+  const Tile *FindTile(XY xy) const;
+  // Returns the tile containing |xy|, creating it if necessary, and copying it
+  // first if it's shared with a copy of this store.
+  Tile *MutableTile(XY xy);
+
+  // Returns the block containing |xy|, creating it if necessary, and copying
+  // it first if it's shared with a copy of this store.
+  Block *MutableBlock(XY xy);
+
+  // Copies |tiles_| / |occupancy_| first if they're shared with a copy of this
+  // store.
+  Tiles *MutableTiles();
+  Occupancy *MutableOccupancy();
+
+  // Shared by every copy. Declared before |tiles_|, which point into it.
+  std::shared_ptr<StringPool> strings_;
+  std::shared_ptr<Tiles> tiles_;
+  size_t size_{0};
+  std::shared_ptr<Occupancy> occupancy_;
+};
+
+} // namespace storage
+} // namespace latis
+
+#endif // SRC_STORAGE_TILE_STORE_H_
@@ -0,0 +1,309 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/storage/tile_store.h"
+
+#include "proto/latis_msg.pb.h"
+#include "src/test_utils/test_utils.h"
+#include "src/xy.h"
+
+#include "absl/strings/str_format.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace latis {
+namespace storage {
+namespace {
+
+using ::testing::UnorderedElementsAre;
+
+Cell CellAt(XY xy, const std::string &formula) {
+  Cell cell = ToProto<Cell>(formula);
+  *cell.mutable_point_location() = xy.ToPointLocation();
+  return cell;
+}
+
+TEST(TileStore, EmptyStore) {
+  TileStore store;
+  EXPECT_EQ(store.size(), 0);
+  EXPECT_FALSE(store.Contains(XY(0, 0)));
+  EXPECT_FALSE(store.Get(XY(0, 0)).has_value());
+  EXPECT_FALSE(store.GetValue(XY(0, 0)).has_value());
+  EXPECT_FALSE(store.GetExpression(XY(0, 0)).has_value());
+}
+
+TEST(TileStore, RoundTripsEveryAmountKind) {
+  const std::vector<std::string> amounts = {
+      "",
+      "str_amount: 'hello'",
+      "int_amount: 7",
+      "double_amount: 2.5",
+      "bool_amount: true",
+      "bool_amount: false",
+      "money_amount { dollars: 3 cents: 50 currency: USD }",
+      "timestamp_amount { seconds: 100 nanos: 5 }",
+  };
+
+  TileStore store;
+  int i = 0;
+  for (const auto &amount : amounts) {
+    const XY xy(i, i * 3);
+    const Cell cell = CellAt(
+        xy, absl::StrFormat("formula { expression { value { %s } } "
+                            "cached_amount { %s } }",
+                            amount, amount));
+    store.Set(xy, cell);
+    EXPECT_THAT(store.Get(xy).value(), EqualsProto(cell)) << amount;
+    i++;
+  }
+  EXPECT_EQ(store.size(), amounts.size());
+}
+
+TEST(TileStore, LookupReadsValuesStraightFromTheColumns) {
+  const std::vector<std::string> amounts = {
+      "",
+      "str_amount: 'hello'",
+      "int_amount: 7",
+      "double_amount: 2.5",
+      "bool_amount: true",
+      "money_amount { dollars: 3 cents: 50 currency: USD }",
+      "timestamp_amount { seconds: 100 nanos: 5 }",
+  };
+
+  TileStore store;
+  for (const auto &amount : amounts) {
+    const XY xy(1, 1);
+    store.SetAmount(xy, ToProto<Amount>(amount));
+    EXPECT_THAT(store.Lookup(xy).value().ToAmount(),
+                EqualsProto(ToProto<Amount>(amount)))
+        << amount;
+  }
+
+  store.SetErrorMsg(XY(1, 1), "oops");
+  EXPECT_FALSE(store.Lookup(XY(1, 1)).has_value());
+  EXPECT_FALSE(store.Lookup(XY(2, 2)).has_value());
+}
+
+TEST(TileStore, StoresNonLiteralExpressions) {
+  TileStore store;
+  const XY xy(1, 2);
+  const Cell cell = CellAt(xy, R"(formula {
+    expression { lookup { col: 0 row: 0 } }
+    cached_amount { int_amount: 4 }
+  })");
+  store.Set(xy, cell);
+  EXPECT_THAT(store.Get(xy).value(), EqualsProto(cell));
+  EXPECT_THAT(store.GetExpression(xy).value(),
+              EqualsProto(cell.formula().expression()));
+  EXPECT_THAT(store.GetValue(xy).value(),
+              EqualsProto(ToProto<Formula>("cached_amount { int_amount: 4 }")));
+}
+
+TEST(TileStore, CellWithoutExpression) {
+  TileStore store;
+  const XY xy(3, 3);
+  const Cell cell = CellAt(xy, "formula { cached_amount { int_amount: 4 } }");
+  store.Set(xy, cell);
+  EXPECT_THAT(store.Get(xy).value(), EqualsProto(cell));
+  EXPECT_FALSE(store.GetExpression(xy).has_value());
+}
+
+TEST(TileStore, SetAmountKeepsLiteralExpression) {
+  TileStore store;
+  const XY xy(0, 0);
+  store.Set(xy, CellAt(xy, R"(formula {
+    expression { value { int_amount: 1 } }
+    cached_amount { int_amount: 1 }
+  })"));
+  store.SetAmount(xy, ToProto<Amount>("int_amount: 2"));
+  EXPECT_THAT(store.Get(xy).value(), EqualsProto(CellAt(xy, R"(formula {
+    expression { value { int_amount: 1 } }
+    cached_amount { int_amount: 2 }
+  })")));
+}
+
+TEST(TileStore, SetErrorMsgReplacesAmount) {
+  TileStore store;
+  const XY xy(0, 0);
+  store.Set(xy, CellAt(xy, R"(formula {
+    expression { lookup { col: 1 row: 1 } }
+    cached_amount { str_amount: "foo" }
+  })"));
+  store.SetErrorMsg(xy, "oops");
+  EXPECT_THAT(store.Get(xy).value(), EqualsProto(CellAt(xy, R"(formula {
+    expression { lookup { col: 1 row: 1 } }
+    error_msg: "oops"
+  })")));
+}
+
+TEST(TileStore, SetAmountCreatesCell) {
+  TileStore store;
+  store.SetAmount(XY(5, 5), ToProto<Amount>("int_amount: 2"));
+  EXPECT_EQ(store.size(), 1);
+  EXPECT_THAT(store.GetValue(XY(5, 5)).value(),
+              EqualsProto(ToProto<Formula>("cached_amount { int_amount: 2 }")));
+}
+
+TEST(TileStore, OverwriteAndErase) {
+  TileStore store;
+  const XY xy(70, 130);
+  store.Set(xy, CellAt(xy, "formula { cached_amount { str_amount: 'a' } }"));
+  store.Set(xy, CellAt(xy, "formula { cached_amount { int_amount: 1 } }"));
+  EXPECT_EQ(store.size(), 1);
+  EXPECT_THAT(
+      store.Get(xy).value(),
+      EqualsProto(CellAt(xy, "formula { cached_amount { int_amount: 1 } }")));
+
+  store.Erase(xy);
+  EXPECT_EQ(store.size(), 0);
+  EXPECT_FALSE(store.Contains(xy));
+
+  // Erasing twice is fine.
+  store.Erase(xy);
+  EXPECT_EQ(store.size(), 0);
+}
+
+TEST(TileStore, ForEachVisitsAcrossTiles) {
+  TileStore store;
+  const std::vector<XY> xys = {XY(0, 0), XY(63, 63), XY(64, 0), XY(0, 64),
+                               XY(1000, 2000), XY(-1, -1)};
+  for (const XY &xy : xys) {
+    store.Set(xy, CellAt(xy, "formula { cached_amount { int_amount: 1 } }"));
+  }
+
+  std::vector<XY> seen;
+  store.ForEach([&](XY xy, const Cell &cell) {
+    EXPECT_EQ(XY::From(cell.point_location()), xy);
+    seen.push_back(xy);
+  });
+  EXPECT_THAT(seen, UnorderedElementsAre(XY(0, 0), XY(63, 63), XY(64, 0),
+                                         XY(0, 64), XY(1000, 2000),
+                                         XY(-1, -1)));
+}
+
+TEST(TileStore, RunLengthMatchesContains) {
+  TileStore store;
+  // Runs within a tile, across tile and block edges, and either side of 0.
+  const std::vector<XY> xys = {
+      XY(0, 0),     XY(1, 0),    XY(2, 0),     XY(62, 0),    XY(63, 0),
+      XY(64, 0),    XY(65, 0),   XY(1023, 0),  XY(1024, 0),  XY(3000, 0),
+      XY(-1, 0),    XY(-64, 0),  XY(-65, 0),   XY(0, 1),     XY(0, 63),
+      XY(0, 64),    XY(0, 1024), XY(0, -1),    XY(0, -2000), XY(5, 5)};
+  for (const XY &xy : xys) {
+    store.SetAmount(xy, ToProto<Amount>("int_amount: 1"));
+  }
+
+  // Walks cell by cell instead.
+  const auto expected = [&store](XY xy, int dx, int dy, bool occupied,
+                                 int limit) {
+    int n = 0;
+    while (n < limit &&
+           store.Contains(XY(xy.X() + (n * dx), xy.Y() + (n * dy))) ==
+               occupied) {
+      n++;
+    }
+    return n;
+  };
+  for (const auto &[dx, dy] :
+       std::vector<std::pair<int, int>>{{1, 0}, {-1, 0}, {0, 1}, {0, -1}}) {
+    for (int v = -2100; v <= 3100; v += 7) {
+      for (const XY &xy : {XY(v, 0), XY(0, v)}) {
+        for (const bool occupied : {true, false}) {
+          EXPECT_EQ(store.RunLength(xy, dx, dy, occupied, 5000),
+                    expected(xy, dx, dy, occupied, 5000))
+              << xy.ToA1() << " " << dx << "," << dy << " " << occupied;
+        }
+      }
+    }
+  }
+
+  // Stops at |limit|.
+  EXPECT_EQ(store.RunLength(XY(70, 0), 1, 0, false, 10), 10);
+  EXPECT_EQ(store.RunLength(XY(0, 0), 1, 0, true, 2), 2);
+}
+
+TEST(TileStore, CopiesAreIndependent) {
+  TileStore store;
+  const XY a(0, 0);
+  const XY b(100, 100);
+  store.SetAmount(a, ToProto<Amount>("int_amount: 1"));
+  store.SetAmount(b, ToProto<Amount>("str_amount: 'b'"));
+
+  TileStore copy = store;
+  store.SetAmount(a, ToProto<Amount>("int_amount: 2"));
+  store.Erase(b);
+  store.SetAmount(XY(200, 0), ToProto<Amount>("int_amount: 3"));
+
+  EXPECT_EQ(copy.size(), 2);
+  EXPECT_EQ(copy.occupancy().MaxX(), 100);
+  EXPECT_THAT(copy.GetValue(a).value(),
+              EqualsProto(ToProto<Formula>("cached_amount { int_amount: 1 }")));
+  EXPECT_THAT(
+      copy.GetValue(b).value(),
+      EqualsProto(ToProto<Formula>("cached_amount { str_amount: 'b' }")));
+  EXPECT_FALSE(copy.Contains(XY(200, 0)));
+
+  // And the other way round.
+  copy.SetErrorMsg(a, "oops");
+  EXPECT_THAT(store.GetValue(a).value(),
+              EqualsProto(ToProto<Formula>("cached_amount { int_amount: 2 }")));
+  EXPECT_EQ(store.size(), 2);
+  EXPECT_EQ(store.occupancy().MaxX(), 200);
+}
+
+TEST(TileStore, CopiesAreIndependentAcrossBlocks) {
+  constexpr int kBlockWidth = TileStore::kBlockSize * TileStore::kTileSize;
+  TileStore store;
+  const XY a(0, 0);
+  const XY b(kBlockWidth, 3 * kBlockWidth);
+  store.SetAmount(a, ToProto<Amount>("int_amount: 1"));
+  store.SetAmount(b, ToProto<Amount>("int_amount: 2"));
+
+  TileStore copy = store;
+  store.Erase(b);
+  store.SetAmount(XY(-1, 0), ToProto<Amount>("int_amount: 3"));
+
+  EXPECT_EQ(copy.size(), 2);
+  EXPECT_THAT(copy.GetValue(b).value(),
+              EqualsProto(ToProto<Formula>("cached_amount { int_amount: 2 }")));
+  EXPECT_FALSE(copy.Contains(XY(-1, 0)));
+  EXPECT_EQ(copy.occupancy().MaxY(), 3 * kBlockWidth);
+
+  EXPECT_EQ(store.size(), 2);
+  EXPECT_FALSE(store.Contains(b));
+  EXPECT_EQ(store.occupancy().MinX(), -1);
+}
+
+TEST(TileStore, CopiesKeepTheirStrings) {
+  TileStore store;
+  const XY xy(1, 1);
+  store.SetAmount(xy, ToProto<Amount>("str_amount: 'old'"));
+  TileStore copy = store;
+
+  // If the copy didn't hold its own reference, 'old' would be released here
+  // and its id handed out again for 'new'.
+  store.SetAmount(xy, ToProto<Amount>("str_amount: 'new'"));
+  store.SetAmount(XY(2, 2), ToProto<Amount>("str_amount: 'newer'"));
+
+  EXPECT_THAT(
+      copy.GetValue(xy).value(),
+      EqualsProto(ToProto<Formula>("cached_amount { str_amount: 'old' }")));
+  EXPECT_THAT(
+      store.GetValue(xy).value(),
+      EqualsProto(ToProto<Formula>("cached_amount { str_amount: 'new' }")));
+}
+
+} // namespace
+} // namespace storage
+} // namespace latis
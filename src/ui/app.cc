@@ -34,7 +34,6 @@ App::App() {
 
   InitColors(); // see color.h
 
-  halfdelay(1000 / 60);    // 60 FPS
   notimeout(stdscr, true); // no timeout, esc persists immediately
 
   keypad(stdscr, TRUE); // arrow key
@@ -46,6 +45,9 @@ App::App() {
   assert(noecho() == OK);
   assert(clear() == OK);
 
+  // getch() gives up after a frame, 60 FPS, so that ticks happen regardless.
+  timeout(1000 / 60);
+
   assert(refresh() == OK);
 }
 
@@ -60,7 +62,17 @@ void App::Run() {
   bool should_run = true;
   int ch;
   do {
+    if (tick_cb_.has_value()) {
+      tick_cb_.value()();
+    }
+
+    // Everything drawn since the last key is written out in one go.
+    Window::Flush();
+
     ch = getch();
+    if (ch == ERR) {
+      continue;
+    }
     ui::Debug(absl::StrFormat("Handling '%c'", ch));
 
     if (ch == KEY_RESIZE && resize_cb_.has_value()) {
@@ -81,5 +93,7 @@ void App::Run() {
 
 void App::RegisterResizeCallback(ResizeCb cb) { resize_cb_ = cb; }
 
+void App::RegisterTickCallback(TickCb cb) { tick_cb_ = cb; }
+
 } // namespace ui
 } // namespace latis
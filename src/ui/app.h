@@ -29,6 +29,7 @@ namespace ui {
 class App {
 public:
   using ResizeCb = std::function<void(void)>;
+  using TickCb = std::function<void(void)>;
 
   explicit App();
   ~App();
@@ -50,6 +51,10 @@ public:
   // Registers a callback to be invoked when the window resized.
   void RegisterResizeCallback(ResizeCb cb);
 
+  // Registers a callback to be invoked once a frame, keypress or not, before
+  // anything is drawn.
+  void RegisterTickCallback(TickCb cb);
+
 private:
   // Will never be nullptr.
   std::unique_ptr<ActiveWidget> active_;
@@ -57,6 +62,7 @@ private:
   absl::flat_hash_set<std::shared_ptr<Widget>> widgets_;
 
   absl::optional<ResizeCb> resize_cb_;
+  absl::optional<TickCb> tick_cb_;
 };
 
 } // namespace ui
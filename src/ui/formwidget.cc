@@ -17,6 +17,8 @@
 
 #include "absl/strings/ascii.h"
 
+#include <cerrno>
+
 namespace latis {
 namespace ui {
 
@@ -28,6 +30,9 @@ FormWidget::FormWidget(std::unique_ptr<Window> window,
   // The general flow of control of a form program looks like this:
   //   1. Create the form fields, using new_field().
 
+  // new_field() only sets errno on failure, so clear out whatever was left
+  // behind by earlier calls.
+  errno = E_OK;
   fields_[0] =
       new_field(/*height=*/1, /*width=*/window_->GetDimensions().Width() - 4,
                 /*toprow=*/1,
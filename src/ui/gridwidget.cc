@@ -15,6 +15,8 @@
 
 #include "src/ui/gridwidget.h"
 
+#include <algorithm>
+
 namespace latis {
 namespace ui {
 
@@ -30,23 +32,57 @@ std::string IntegerToColumnLetter(int i) {
   v.push_back((char)(kCapitalLetterA + (i % 26)));
   return v;
 }
+
+// Ctrl-arrows don't have fixed key codes, so look up what the terminal sends
+// for each and what ncurses turns that into.
+int KeyCode(const char *capability) {
+  const char *sequence = tigetstr(capability);
+  if (sequence == nullptr || sequence == (char *)-1) {
+    return -1;
+  }
+  return key_defined(sequence);
+}
+
+// Returns {dy, dx} if |ch| is a Ctrl-arrow.
+absl::optional<std::pair<int, int>> CtrlArrowDirection(int ch) {
+  static const int kCtrlUp = KeyCode("kUP5");
+  static const int kCtrlDown = KeyCode("kDN5");
+  static const int kCtrlLeft = KeyCode("kLFT5");
+  static const int kCtrlRight = KeyCode("kRIT5");
+  if (ch <= 0) {
+    return absl::nullopt;
+  } else if (ch == kCtrlUp) {
+    return std::make_pair(-1, 0);
+  } else if (ch == kCtrlDown) {
+    return std::make_pair(1, 0);
+  } else if (ch == kCtrlLeft) {
+    return std::make_pair(0, -1);
+  } else if (ch == kCtrlRight) {
+    return std::make_pair(0, 1);
+  }
+  return absl::nullopt;
+}
 } // namespace
 
 GridWidget::GridWidget(Dimensions dimensions)
     : Widget(absl::make_unique<Window>(
           dimensions, Style{.border_style = BorderStyle::kBorderStyleNone})), //
-      height_(dimensions.nlines - 2), width_(dimensions.ncols - 3),           //
       cell_width_(15), cell_height_(3),                                       //
-      coordinate_markers_() {
+      rows_(std::max(0, (dimensions.nlines - col_header_height_ - 1) /
+                            (cell_height_ - 1))),
+      cols_(std::max(0, (dimensions.ncols - row_header_width_ - 1) /
+                            (cell_width_ - 1))),
+      viewport_(rows_, cols_) {
   Debug(absl::StrFormat("GridWidget::GridWidget(%s)", dimensions.ToString()));
 
   // Column headers
-  for (int i = 0; i < width_ / (cell_width_ - 1); i++) {
+  for (int i = 0; i < cols_; i++) {
     auto w = absl::make_unique<TextWidget>(
         window_->GetDerwin(Dimensions{.nlines = col_header_height_,
                                       .ncols = cell_width_,
                                       .begin_y = 0,
-                                      .begin_x = ((cell_width_ - 1) * i) + 1},
+                                      .begin_x = ((cell_width_ - 1) * i) +
+                                                 row_header_width_ - 2},
                            Style{
                                .border_style = BorderStyle::kBorderStyleNone,
                                .corner_style = CornerStyle::kCornerStyleNone,
@@ -55,12 +91,11 @@ GridWidget::GridWidget(Dimensions dimensions)
                                .halign = HorizontalAlignment::kLeft,
                                .color = Color::RED,
                            }));
-    w->UpdateUnderlyingContent(IntegerToColumnLetter(i));
-    coordinate_markers_.push_back(std::move(w));
+    col_markers_.push_back(std::move(w));
   }
 
   //  Row headers
-  for (int i = 0; i < height_ / (cell_height_ - 1); i++) {
+  for (int i = 0; i < rows_; i++) {
     auto w = absl::make_unique<TextWidget>(window_->GetDerwin(
         Dimensions{
             .nlines = cell_height_,
@@ -75,9 +110,109 @@ GridWidget::GridWidget(Dimensions dimensions)
             .ypad = 1,
             .color = Color::RED,
         }));
-    w->UpdateUnderlyingContent(std::to_string(i + 1));
-    coordinate_markers_.push_back(std::move(w));
+    row_markers_.push_back(std::move(w));
+  }
+  Relabel();
+
+  // Cells
+  cells_.resize(rows_);
+  for (int row = 0; row < rows_; ++row) {
+    for (int col = 0; col < cols_; ++col) {
+      auto w = std::make_shared<TextWidget>(window_->GetDerwin(
+          Dimensions{
+              .nlines = cell_height_,
+              .ncols = cell_width_,
+              .begin_y = (cell_height_ - 1) * row + col_header_height_,
+              .begin_x = (cell_width_ - 1) * col + row_header_width_,
+          },
+          Style{
+              .border_style = BorderStyle::kThin,
+              .corner_style = CornerStyle::kPlus,
+          }));
+      // The widget stays put while the cells under it change, so look up
+      // which one it is showing at the time of the edit.
+      w->WithCb([this, row, col](absl::string_view s) {
+        if (!edit_cb_.has_value()) {
+          return absl::optional<std::string>();
+        }
+        return edit_cb_.value()(viewport_.origin_y() + row,
+                                viewport_.origin_x() + col, s);
+      });
+      cells_[row].push_back(std::move(w));
+    }
+  }
+}
+
+GridWidget *GridWidget::WithContent(ContentFn content_fn) {
+  content_fn_ = content_fn;
+  Refresh();
+  return this;
+}
+
+GridWidget *GridWidget::WithEditCb(EditCb edit_cb) {
+  edit_cb_ = edit_cb;
+  return this;
+}
+
+GridWidget *GridWidget::WithEdgeFn(EdgeFn edge_fn) {
+  edge_fn_ = edge_fn;
+  return this;
+}
+
+void GridWidget::Refresh() {
+  for (int row = 0; row < rows_; ++row) {
+    for (int col = 0; col < cols_; ++col) {
+      Bind(row, col);
+    }
+  }
+}
+
+void GridWidget::Bind(int row, int col) {
+  // NB: TextWidget skips the redraw if this cell shows the same as the last.
+  cells_[row][col]->UpdateUnderlyingContent(
+      content_fn_.has_value()
+          ? content_fn_.value()(viewport_.origin_y() + row,
+                                viewport_.origin_x() + col)
+          : "");
+}
+
+void GridWidget::Relabel() {
+  for (int i = 0; i < cols_; ++i) {
+    col_markers_[i]->UpdateUnderlyingContent(
+        IntegerToColumnLetter(viewport_.origin_x() + i));
+  }
+  for (int i = 0; i < rows_; ++i) {
+    row_markers_[i]->UpdateUnderlyingContent(
+        std::to_string(viewport_.origin_y() + i + 1));
+  }
+}
+
+std::shared_ptr<TextWidget> GridWidget::Get(int y, int x) {
+  if (!viewport_.Contains(y, x)) {
+    return nullptr;
+  }
+  return cells_[y - viewport_.origin_y()][x - viewport_.origin_x()];
+}
+
+bool GridWidget::SetActive(int y, int x) {
+  const auto w = Get(y, x);
+  if (w == nullptr) {
+    return false;
   }
+  active_.reset();
+  active_ = std::make_unique<ActiveWidget>(w, y, x);
+  return true;
+}
+
+bool GridWidget::MoveTo(int y, int x) {
+  if (y < 0 || x < 0) {
+    return false;
+  }
+  if (viewport_.Reveal(y, x)) {
+    Relabel();
+    Refresh();
+  }
+  return SetActive(y, x);
 }
 
 bool GridWidget::Process(int ch) {
@@ -89,33 +224,38 @@ bool GridWidget::Process(int ch) {
     return true;
   }
 
-  // if our active cell didn't swallow the ch, maybe it's an arrow key
-  if (ch == KEY_LEFT || ch == KEY_RIGHT || ch == KEY_DOWN || ch == KEY_UP) {
-
-    int new_y = active_->y();
-    int new_x = active_->x();
-
-    if (ch == KEY_LEFT) {
-      new_x -= 1;
-    } else if (ch == KEY_RIGHT) {
-      new_x += 1;
-    } else if (ch == KEY_DOWN) {
-      new_y += 1;
-    } else if (ch == KEY_UP) {
-      new_y -= 1;
-    } else {
-      return false;
-    }
+  const int y = active_->y();
+  const int x = active_->x();
 
-    const auto w = Get<TextWidget>(new_y, new_x);
-    if (w == nullptr) {
-      // TODO(ambuc): Spawn new cell here if applicable
-      return false;
+  // if our active cell didn't swallow the ch, maybe it's an arrow key
+  switch (ch) {
+  case KEY_LEFT:
+    return MoveTo(y, x - 1);
+  case KEY_RIGHT:
+    return MoveTo(y, x + 1);
+  case KEY_DOWN:
+    return MoveTo(y + 1, x);
+  case KEY_UP:
+    return MoveTo(y - 1, x);
+  case KEY_NPAGE:
+  case KEY_PPAGE: {
+    // Keep the active cell in the same place on-screen, if possible.
+    const int dy = ch == KEY_NPAGE ? rows_ : -rows_;
+    if (viewport_.Pan(dy, 0)) {
+      Relabel();
+      Refresh();
     }
+    return MoveTo(std::max(0, y + dy), x);
+  }
+  default:
+    break;
+  }
 
-    active_.reset();
-    active_ = std::make_unique<ActiveWidget>(w, new_y, new_x);
-    return true;
+  if (const auto direction = CtrlArrowDirection(ch);
+      direction.has_value() && edge_fn_.has_value()) {
+    const auto [dy, dx] = direction.value();
+    const auto [new_y, new_x] = edge_fn_.value()(y, x, dy, dx);
+    return MoveTo(new_y, new_x);
   }
 
   return false;
@@ -18,61 +18,60 @@
 
 #include "src/ui/widget.h"
 
-#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
 #include "src/ui/textwidget.h"
+#include "src/ui/viewport.h"
+
+#include <functional>
+#include <utility>
+#include <vector>
 
 namespace latis {
 namespace ui {
 
+// GridWidget shows a window onto an unbounded grid of cells. It only ever owns
+// enough TextWidgets to fill the screen, and binds each to whichever cell is
+// currently under it, so its cost scales with the size of the terminal rather
+// than the size of the sheet. All coordinates are those of the grid, not the
+// screen.
+//
+// Moving the active cell off the edge of the screen scrolls the grid.
+// PgUp/PgDn scroll a screenful at a time, and Ctrl-arrows jump to the edge of
+// the data, as decided by an EdgeFn.
 class GridWidget : public Widget {
 public:
+  // Returns what to show in cell (y, x).
+  using ContentFn = std::function<std::string(int y, int x)>;
+  // Called with the user's input when cell (y, x) is edited. Returns what to
+  // show in it instead, if anything.
+  using EditCb = std::function<absl::optional<std::string>(int y, int x,
+                                                           absl::string_view)>;
+  // Returns the cell a Ctrl-arrow from cell (y, x) lands on, given a
+  // direction (dy, dx), as {y, x}.
+  using EdgeFn = std::function<std::pair<int, int>(int y, int x, int dy,
+                                                   int dx)>;
+
   GridWidget(Dimensions dimensions);
   ~GridWidget() override {}
 
-  // returns nullptr if there is no room.
-  template <typename T, typename... Args> //
-  std::shared_ptr<T> AddCell(int y, int x, Args... args) {
-    Debug(absl::StrFormat("GridWidget::AddCell(%d, %d)", y, x));
-    auto p = std::make_shared<T>(
-        args..., window_->GetDerwin(
-                     /*dimensions=*/
-                     Dimensions{
-                         .nlines = cell_height_,
-                         .ncols = cell_width_,
-                         .begin_y = (cell_height_ * y) - y + col_header_height_,
-                         .begin_x = (cell_width_ * x) - x + row_header_width_,
-                     },
-                     Style{
-                         .border_style = BorderStyle::kThin,
-                         .corner_style = CornerStyle::kPlus,
-                     }));
-    widgets_[std::make_pair(y, x)] = p;
-    // if created recently, set active.
-    Debug(absl::StrFormat("Setting %d, %d to active.", y, x));
-    active_ = std::make_unique<ActiveWidget>(p, y, x);
-    return p;
-  }
-
-  template <typename T> //
-  std::shared_ptr<T> Get(int y, int x) {
-    Debug(absl::StrFormat("GridWidget::Get(%d, %d)", y, x));
-    const auto pair = std::make_pair(y, x);
-    const auto it = widgets_.find(pair);
-    if (it == widgets_.end()) {
-      return nullptr;
-    }
-    return std::dynamic_pointer_cast<T>(it->second);
-  }
-
-  // Returns true if successful.
-  bool SetActive(int y, int x) {
-    const auto it = widgets_.find(std::make_pair(y, x));
-    if (it == widgets_.end()) {
-      return false;
-    }
-    active_ = std::make_unique<ActiveWidget>(it->second, y, x);
-    return true;
-  }
+  // Sets where cell contents come from, and reads in every visible cell.
+  GridWidget *WithContent(ContentFn content_fn);
+  GridWidget *WithEditCb(EditCb edit_cb);
+  GridWidget *WithEdgeFn(EdgeFn edge_fn);
+
+  // Reads in every visible cell again.
+  void Refresh();
+
+  // Returns the widget showing cell (y, x), or nullptr if it is off-screen.
+  std::shared_ptr<TextWidget> Get(int y, int x);
+
+  // Returns true if successful, i.e. if (y, x) is on-screen.
+  bool SetActive(int y, int x);
+
+  // Scrolls as little as possible to put cell (y, x) on-screen, then makes it
+  // active. Returns false if (y, x) is out of bounds.
+  bool MoveTo(int y, int x);
 
   // Returns true if this widget consumed the event.
   bool Process(int ch) override;
@@ -81,19 +80,37 @@ public:
   void UnFocus() override {}
 
 private:
-  const int height_; // Height of the grid.
-  const int width_;  // Width of the grid.
+  // Shows the cell at screen position (row, col) in |cells_[row][col]|.
+  void Bind(int row, int col);
+
+  // Labels the headers for the current origin.
+  void Relabel();
+
   const int cell_width_;
   const int cell_height_;
 
   // for headers
   const int col_header_height_{1};
-  const int row_header_width_{3};
+  // Room for seven-digit row numbers.
+  const int row_header_width_{8};
+
+  // The number of cells which fit on-screen.
+  const int rows_;
+  const int cols_;
+
+  // Which cells are on-screen.
+  Viewport viewport_;
+
+  absl::optional<ContentFn> content_fn_;
+  absl::optional<EditCb> edit_cb_;
+  absl::optional<EdgeFn> edge_fn_;
 
   std::unique_ptr<ActiveWidget> active_;
 
-  std::vector<std::shared_ptr<TextWidget>> coordinate_markers_;
-  absl::flat_hash_map<std::pair<int, int>, std::shared_ptr<Widget>> widgets_;
+  std::vector<std::shared_ptr<TextWidget>> col_markers_;
+  std::vector<std::shared_ptr<TextWidget>> row_markers_;
+  // |rows_| x |cols_|, reused for whichever cells are on-screen.
+  std::vector<std::vector<std::shared_ptr<TextWidget>>> cells_;
 };
 
 } // namespace ui
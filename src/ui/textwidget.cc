@@ -15,6 +15,8 @@
 
 #include "src/ui/textwidget.h"
 
+#include <algorithm>
+
 namespace latis {
 namespace ui {
 
@@ -40,13 +42,22 @@ void TextWidget::UpdateUnderlyingContent(std::string s) {
   static auto id = [](std::string s) { return s; };
 
   Debug(absl::StrFormat("TextWidget::UpdateUnderlyingContent(%s)", s));
-  underlying_content_ = s;
-  display_content_ = tmpl_.value_or(id)(underlying_content_);
+  std::string display_content = tmpl_.value_or(id)(s);
+  // Skip the redraw if nothing changed, e.g. when a grid scrolls over cells
+  // holding the same thing.
+  if (s == underlying_content_ && display_content == display_content_) {
+    return;
+  }
+  underlying_content_ = std::move(s);
+  display_content_ = std::move(display_content);
   FormatAndFlushToWindow(display_content_);
 }
 
 void TextWidget::UpdateDisplayContent(std::string s) {
   Debug(absl::StrFormat("TextWidget::UpdateDisplayContent(%s)", s));
+  if (s == display_content_) {
+    return;
+  }
   display_content_ = s;
   FormatAndFlushToWindow(display_content_);
 }
@@ -107,10 +118,11 @@ void TextWidget::PersistForm() {
   form_ = nullptr;
 
   assert(recv_cb_.has_value());
-  UpdateDisplayContent(
-      recv_cb_.value()(underlying_content_).value_or(display_content_));
+  display_content_ =
+      recv_cb_.value()(underlying_content_).value_or(display_content_);
 
-  window_->Refresh();
+  // Always redraw, since the form took the window's contents with it.
+  FormatAndFlushToWindow(display_content_);
 }
 
 void TextWidget::CancelForm() {
@@ -118,6 +130,8 @@ void TextWidget::CancelForm() {
 
   assert(form_ != nullptr);
   form_ = nullptr;
+
+  FormatAndFlushToWindow(display_content_);
 }
 
 void TextWidget::FormatAndFlushToWindow(absl::string_view s) {
@@ -142,7 +156,7 @@ void TextWidget::FormatAndFlushToWindow(absl::string_view s) {
   }
   width -= style.xpad;
   if (width < int(to_print.size())) {
-    to_print.resize(width - 3);
+    to_print.resize(std::max(0, width - 3));
     to_print.append("...");
   }
 
@@ -0,0 +1,56 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "src/ui/viewport.h"
+
+#include <algorithm>
+
+namespace latis {
+namespace ui {
+
+bool Viewport::Contains(int y, int x) const {
+  return origin_y_ <= y && y < origin_y_ + rows_ && origin_x_ <= x &&
+         x < origin_x_ + cols_;
+}
+
+bool Viewport::Reveal(int y, int x) {
+  int dy = 0;
+  if (y < origin_y_) {
+    dy = y - origin_y_;
+  } else if (y >= origin_y_ + rows_) {
+    dy = y - (origin_y_ + rows_ - 1);
+  }
+  int dx = 0;
+  if (x < origin_x_) {
+    dx = x - origin_x_;
+  } else if (x >= origin_x_ + cols_) {
+    dx = x - (origin_x_ + cols_ - 1);
+  }
+  return Pan(dy, dx);
+}
+
+bool Viewport::Pan(int dy, int dx) {
+  const int new_y = std::max(0, origin_y_ + dy);
+  const int new_x = std::max(0, origin_x_ + dx);
+  if (new_y == origin_y_ && new_x == origin_x_) {
+    return false;
+  }
+  origin_y_ = new_y;
+  origin_x_ = new_x;
+  return true;
+}
+
+} // namespace ui
+} // namespace latis
@@ -0,0 +1,53 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef SRC_UI_VIEWPORT_H_
+#define SRC_UI_VIEWPORT_H_
+
+namespace latis {
+namespace ui {
+
+// A |rows| x |cols| window onto an unbounded grid, whose top-left corner is
+// at |origin_y|, |origin_x|. Never scrolls to negative coordinates.
+class Viewport {
+public:
+  Viewport(int rows, int cols) : rows_(rows), cols_(cols) {}
+
+  int rows() const { return rows_; }
+  int cols() const { return cols_; }
+  int origin_y() const { return origin_y_; }
+  int origin_x() const { return origin_x_; }
+
+  bool Contains(int y, int x) const;
+
+  // Moves the origin as little as possible for (y, x) to be visible. Returns
+  // true if it moved.
+  bool Reveal(int y, int x);
+
+  // Moves the origin by (dy, dx), but no further than zero. Returns true if it
+  // moved.
+  bool Pan(int dy, int dx);
+
+private:
+  const int rows_;
+  const int cols_;
+  int origin_y_{0};
+  int origin_x_{0};
+};
+
+} // namespace ui
+} // namespace latis
+
+#endif // SRC_UI_VIEWPORT_H_
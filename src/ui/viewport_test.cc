@@ -0,0 +1,72 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "src/ui/viewport.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace latis {
+namespace ui {
+namespace {
+
+using ::testing::Eq;
+
+TEST(ViewportTest, StartsAtZero) {
+  Viewport v(/*rows=*/3, /*cols=*/2);
+  EXPECT_TRUE(v.Contains(0, 0));
+  EXPECT_TRUE(v.Contains(2, 1));
+  EXPECT_FALSE(v.Contains(3, 0));
+  EXPECT_FALSE(v.Contains(0, 2));
+  EXPECT_FALSE(v.Contains(-1, 0));
+}
+
+TEST(ViewportTest, RevealMovesAsLittleAsPossible) {
+  Viewport v(/*rows=*/3, /*cols=*/2);
+  EXPECT_FALSE(v.Reveal(2, 1));
+
+  // Down one past the bottom edge.
+  EXPECT_TRUE(v.Reveal(3, 1));
+  EXPECT_THAT(v.origin_y(), Eq(1));
+  EXPECT_THAT(v.origin_x(), Eq(0));
+
+  // Far off to the bottom-right.
+  EXPECT_TRUE(v.Reveal(100, 50));
+  EXPECT_THAT(v.origin_y(), Eq(98));
+  EXPECT_THAT(v.origin_x(), Eq(49));
+  EXPECT_TRUE(v.Contains(100, 50));
+
+  // Back up above the top edge.
+  EXPECT_TRUE(v.Reveal(10, 49));
+  EXPECT_THAT(v.origin_y(), Eq(10));
+  EXPECT_THAT(v.origin_x(), Eq(49));
+}
+
+TEST(ViewportTest, PanStopsAtZero) {
+  Viewport v(/*rows=*/3, /*cols=*/2);
+  EXPECT_FALSE(v.Pan(-3, -1));
+
+  EXPECT_TRUE(v.Pan(5, 1));
+  EXPECT_THAT(v.origin_y(), Eq(5));
+  EXPECT_THAT(v.origin_x(), Eq(1));
+
+  EXPECT_TRUE(v.Pan(-10, 0));
+  EXPECT_THAT(v.origin_y(), Eq(0));
+  EXPECT_THAT(v.origin_x(), Eq(1));
+}
+
+} // namespace
+} // namespace ui
+} // namespace latis
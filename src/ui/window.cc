@@ -14,6 +14,7 @@
 
 #include "src/ui/window.h"
 
+#include "absl/container/flat_hash_set.h"
 #include "absl/memory/memory.h"
 #include "absl/strings/str_format.h"
 #include "absl/time/clock.h"
@@ -24,6 +25,16 @@
 namespace latis {
 namespace ui {
 
+namespace {
+
+// Windows to redraw at the next Flush().
+absl::flat_hash_set<Window *> &Damaged() {
+  static auto *damaged = new absl::flat_hash_set<Window *>();
+  return *damaged;
+}
+
+} // namespace
+
 Window::Window(Dimensions dimensions, Style style, WINDOW *window)
     : dimensions_(dimensions), style_(style), ptr_(window) {
   assert(dimensions_.ncols > 1);
@@ -53,16 +64,27 @@ void Window::Print(int y, int x, absl::string_view s) {
   assert(wattroff(ptr_, COLOR_PAIR(style_.color)) == OK);
 }
 
-void Window::Refresh() {
-  Debug("Window::Refresh()");
-  PrintPermanentComponents();
-  assert(OK == wrefresh(ptr_));
+void Window::Refresh() { Damaged().insert(this); }
+
+void Window::Flush() {
+  if (Damaged().empty()) {
+    return;
+  }
+  Debug(absl::StrFormat("Window::Flush(): %d windows", Damaged().size()));
+  // Stage each window on the virtual screen; doupdate() then sends only what
+  // differs from the physical screen.
+  for (Window *window : Damaged()) {
+    window->PrintPermanentComponents();
+    assert(OK == wnoutrefresh(window->ptr_));
+  }
+  Damaged().clear();
+  assert(OK == doupdate());
 }
 
 void Window::Clear() {
   // Debug("Window::Clear()");
 
-  assert(OK == wclear(ptr_));
+  assert(OK == werase(ptr_));
 }
 
 Dimensions Window::GetDimensions() const { return dimensions_; }
@@ -72,7 +94,8 @@ Style *Window::GetMutableStyle() { return &style_; }
 Window::~Window() {
   // Debug("Window::~Window()");
 
-  assert(wclear(ptr_) == OK);
+  Damaged().erase(this);
+  assert(werase(ptr_) == OK);
   delwin(ptr_);
 }
 
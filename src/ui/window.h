@@ -51,11 +51,17 @@ public:
   // Prints the string |s| to coordinates (x,y) within the window.
   void Print(int y, int x, absl::string_view s);
 
-  // Refreshes the window. Useful for outside methods which take this window as
-  // their canvas.
+  // Marks the window to be redrawn at the next Flush(). Useful for outside
+  // methods which take this window as their canvas.
   void Refresh();
 
-  // Clears the contents of the window.
+  // Redraws every window marked by Refresh() since the last Flush(), and only
+  // then writes to the terminal, once. Meant to be called once per tick of
+  // the event loop, from the UI thread.
+  static void Flush();
+
+  // Erases the contents of the window. Unlike wclear(), doesn't force the
+  // whole screen to be repainted.
   void Clear();
 
   // Gets the underlying Dimensions struct. Useful for querying .Contains(),
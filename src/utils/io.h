@@ -19,13 +19,18 @@
 #include "proto/latis_msg.pb.h"
 #include "src/utils/cleanup.h"
 
+#include "absl/strings/str_format.h"
+#include "absl/strings/string_view.h"
 #include "google/protobuf/stubs/status.h"
 #include "google/protobuf/stubs/statusor.h"
+#include <cstring>
 #include <fcntl.h>
 #include <fstream>
+#include <google/protobuf/io/coded_stream.h>
 #include <google/protobuf/io/zero_copy_stream_impl.h>
 #include <google/protobuf/text_format.h>
 #include <iostream>
+#include <limits>
 #include <unistd.h>
 
 namespace latis {
@@ -65,6 +70,94 @@ template <typename T> //
   return parsed;
 }
 
+// A binary file is these magic bytes followed by the serialized proto. No
+// textproto starts with 0x89, so the two can be told apart by the first byte.
+constexpr char kBinaryMagic[] = "\x89LATIS\r\n";
+constexpr int kBinaryMagicSize = sizeof(kBinaryMagic) - 1;
+
+enum class FileFormat { kTextproto, kBinary };
+
+// Reads either a textproto or a binary file, whichever |path| holds.
+template <typename T>
+::google::protobuf::util::StatusOr<T> FromFile(absl::string_view path) {
+  if (path.empty()) {
+    return ::google::protobuf::util::Status(
+        ::google::protobuf::util::error::INVALID_ARGUMENT,
+        "Can't parse a file from an empty path.");
+  }
+  int fd = open(std::string(path).c_str(), O_RDONLY);
+  if (fd < 0) {
+    return ::google::protobuf::util::Status(
+        ::google::protobuf::util::error::INVALID_ARGUMENT,
+        absl::StrFormat("Couldn't open %s", path));
+  }
+  auto cleanup = MakeCleanup([&] { close(fd); });
+
+  T parsed;
+
+  google::protobuf::io::FileInputStream fstream(fd);
+
+  // Peek at the first buffer for the magic bytes, then hand back whatever
+  // isn't magic.
+  bool is_binary = false;
+  const void *data;
+  int size;
+  if (fstream.Next(&data, &size)) {
+    is_binary = size >= kBinaryMagicSize &&
+                std::memcmp(data, kBinaryMagic, kBinaryMagicSize) == 0;
+    fstream.BackUp(is_binary ? size - kBinaryMagicSize : size);
+  }
+
+  if (is_binary) {
+    google::protobuf::io::CodedInputStream coded(&fstream);
+    // The default limit is well short of a large workbook.
+    coded.SetTotalBytesLimit(std::numeric_limits<int>::max());
+    if (!parsed.ParseFromCodedStream(&coded)) {
+      return ::google::protobuf::util::Status(
+          ::google::protobuf::util::error::INVALID_ARGUMENT,
+          absl::StrFormat("Couldn't parse binary from %s", path));
+    }
+  } else if (!google::protobuf::TextFormat::Parse(&fstream, &parsed)) {
+    return ::google::protobuf::util::Status(
+        ::google::protobuf::util::error::INVALID_ARGUMENT,
+        absl::StrFormat("Couldn't parse from %s", path));
+  }
+
+  return parsed;
+}
+
+// Writes |msg| to |path| in |format|, replacing whatever was there.
+template <typename T>
+::google::protobuf::util::Status ToFile(const T &msg, absl::string_view path,
+                                        FileFormat format) {
+  int fd = open(std::string(path).c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return ::google::protobuf::util::Status(
+        ::google::protobuf::util::error::INVALID_ARGUMENT,
+        absl::StrFormat("Couldn't open %s", path));
+  }
+
+  google::protobuf::io::FileOutputStream fstream(fd);
+
+  bool written = false;
+  if (format == FileFormat::kBinary) {
+    google::protobuf::io::CodedOutputStream coded(&fstream);
+    coded.WriteRaw(kBinaryMagic, kBinaryMagicSize);
+    written = msg.SerializeToCodedStream(&coded);
+  } else {
+    written = google::protobuf::TextFormat::Print(msg, &fstream);
+  }
+
+  // Closes |fd| too.
+  if (!fstream.Close() || !written) {
+    return ::google::protobuf::util::Status(
+        ::google::protobuf::util::error::INVALID_ARGUMENT,
+        absl::StrFormat("Couldn't write to %s", path));
+  }
+  // NB: Not error::OK, which ncurses defines as a macro.
+  return ::google::protobuf::util::Status();
+}
+
 } // namespace latis
 
 #endif // SRC_UTILS_IO_H_
@@ -0,0 +1,90 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/utils/io.h"
+
+#include "proto/latis_msg.pb.h"
+#include "src/test_utils/test_utils.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include <fstream>
+
+namespace latis {
+namespace {
+
+using ::testing::Not;
+
+LatisMsg Example() {
+  return ToProto<LatisMsg>(R"(
+    metadata { title: "t" author: "a" }
+    cells {
+      point_location { row: 0 col: 0 }
+      formula { cached_amount { str_amount: "hello" } }
+    }
+    cells {
+      point_location { row: 1 col: 0 }
+      formula { cached_amount { double_amount: 2.5 } }
+    }
+  )");
+}
+
+std::string TempPath(absl::string_view name) {
+  return absl::StrFormat("%s/%s", ::testing::TempDir(), name);
+}
+
+TEST(IoTest, BinaryRoundTrip) {
+  const std::string path = TempPath("binary.latis");
+  ASSERT_THAT(ToFile(Example(), path, FileFormat::kBinary), IsOk());
+
+  // Starts with the magic bytes.
+  std::ifstream file(path, std::ios::binary);
+  std::string magic(kBinaryMagicSize, '\0');
+  file.read(&magic[0], kBinaryMagicSize);
+  EXPECT_EQ(magic, std::string(kBinaryMagic, kBinaryMagicSize));
+
+  EXPECT_THAT(FromFile<LatisMsg>(path), IsOkAndHolds(EqualsProto(Example())));
+}
+
+TEST(IoTest, TextprotoRoundTrip) {
+  const std::string path = TempPath("text.textproto");
+  ASSERT_THAT(ToFile(Example(), path, FileFormat::kTextproto), IsOk());
+
+  EXPECT_THAT(FromFile<LatisMsg>(path), IsOkAndHolds(EqualsProto(Example())));
+  EXPECT_THAT(FromTextproto<LatisMsg>(path),
+              IsOkAndHolds(EqualsProto(Example())));
+}
+
+TEST(IoTest, EmptyFile) {
+  const std::string path = TempPath("empty");
+  std::ofstream(path).close();
+  EXPECT_THAT(FromFile<LatisMsg>(path), IsOkAndHolds(EqualsProto(LatisMsg())));
+}
+
+TEST(IoTest, Errors) {
+  EXPECT_THAT(FromFile<LatisMsg>(""), Not(IsOk()));
+  EXPECT_THAT(FromFile<LatisMsg>(TempPath("does_not_exist")), Not(IsOk()));
+
+  const std::string path = TempPath("garbage.latis");
+  std::ofstream(path, std::ios::binary)
+      << std::string(kBinaryMagic, kBinaryMagicSize) << "\xff\xff\xff";
+  EXPECT_THAT(FromFile<LatisMsg>(path), Not(IsOk()));
+
+  EXPECT_THAT(ToFile(Example(), TempPath("no/such/dir"), FileFormat::kBinary),
+              Not(IsOk()));
+}
+
+} // namespace
+} // namespace latis
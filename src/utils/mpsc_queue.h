@@ -0,0 +1,77 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_UTILS_MPSC_QUEUE_H_
+#define SRC_UTILS_MPSC_QUEUE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+#include <vector>
+
+namespace latis {
+
+// A lock-free queue which any number of threads push onto, and one thread
+// drains all at once. Pushing is a compare-and-swap onto the head of a linked
+// list; draining swaps the whole list out and reverses it.
+template <typename T> class MpscQueue {
+public:
+  MpscQueue() = default;
+  ~MpscQueue() { Drain(); }
+
+  MpscQueue(const MpscQueue &) = delete;
+  MpscQueue &operator=(const MpscQueue &) = delete;
+
+  void Push(T value) {
+    Node *node =
+        new Node{std::move(value), head_.load(std::memory_order_relaxed)};
+    while (!head_.compare_exchange_weak(node->next, node,
+                                        std::memory_order_release,
+                                        std::memory_order_relaxed)) {
+    }
+  }
+
+  // Takes everything pushed so far, oldest first. Only one thread may drain.
+  std::vector<T> Drain() {
+    Node *node = head_.exchange(nullptr, std::memory_order_acquire);
+    std::vector<T> values;
+    while (node != nullptr) {
+      values.push_back(std::move(node->value));
+      Node *next = node->next;
+      delete node;
+      node = next;
+    }
+    std::reverse(values.begin(), values.end());
+    return values;
+  }
+
+  bool empty() const {
+    return head_.load(std::memory_order_relaxed) == nullptr;
+  }
+
+private:
+  struct Node {
+    T value;
+    Node *next;
+  };
+
+  // The most recently pushed.
+  std::atomic<Node *> head_{nullptr};
+};
+
+} // namespace latis
+
+#endif // SRC_UTILS_MPSC_QUEUE_H_
@@ -0,0 +1,76 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/utils/mpsc_queue.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include <thread>
+
+namespace latis {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::Eq;
+using ::testing::IsEmpty;
+
+TEST(MpscQueueTest, DrainsOldestFirst) {
+  MpscQueue<int> queue;
+  EXPECT_TRUE(queue.empty());
+  EXPECT_THAT(queue.Drain(), IsEmpty());
+
+  queue.Push(1);
+  queue.Push(2);
+  queue.Push(3);
+  EXPECT_FALSE(queue.empty());
+  EXPECT_THAT(queue.Drain(), ElementsAre(1, 2, 3));
+  EXPECT_TRUE(queue.empty());
+
+  queue.Push(4);
+  EXPECT_THAT(queue.Drain(), ElementsAre(4));
+}
+
+TEST(MpscQueueTest, ManyProducers) {
+  constexpr int kThreads = 4;
+  constexpr int kPerThread = 10000;
+  MpscQueue<std::pair<int, int>> queue;
+
+  std::vector<std::thread> producers;
+  for (int t = 0; t < kThreads; ++t) {
+    producers.emplace_back([&queue, t] {
+      for (int i = 0; i < kPerThread; ++i) {
+        queue.Push({t, i});
+      }
+    });
+  }
+
+  // Drain while they're still pushing; each producer's values come out in the
+  // order it pushed them.
+  std::vector<int> next(kThreads, 0);
+  int total = 0;
+  while (total < kThreads * kPerThread) {
+    for (const auto &[t, i] : queue.Drain()) {
+      EXPECT_THAT(i, Eq(next[t]++));
+      ++total;
+    }
+  }
+  for (std::thread &producer : producers) {
+    producer.join();
+  }
+  EXPECT_TRUE(queue.empty());
+}
+
+} // namespace
+} // namespace latis
@@ -0,0 +1,139 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/utils/thread_pool.h"
+
+#include "absl/memory/memory.h"
+#include "absl/types/optional.h"
+
+#include <algorithm>
+
+namespace latis {
+
+namespace {
+
+// Each thread's share of a loop is cut into about this many chunks, so that
+// there is something left to steal when the work is uneven.
+constexpr size_t kChunksPerThread = 4;
+
+} // namespace
+
+ThreadPool::ThreadPool(int num_threads) {
+  for (int i = 0; i <= num_threads; ++i) {
+    queues_.push_back(absl::make_unique<Queue>());
+  }
+  for (int i = 0; i < num_threads; ++i) {
+    workers_.emplace_back([this, i]() { Work(i); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    absl::MutexLock l(&mu_);
+    done_ = true;
+  }
+  for (std::thread &worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPool::ParallelFor(size_t n, const std::function<void(size_t)> &fn) {
+  if (workers_.empty() || n < 2) {
+    for (size_t i = 0; i < n; ++i) {
+      fn(i);
+    }
+    return;
+  }
+
+  const size_t grain =
+      std::max<size_t>(1, n / (queues_.size() * kChunksPerThread));
+  const size_t num_chunks = (n + grain - 1) / grain;
+
+  // Counted before any chunk is visible, since a worker still draining the
+  // last loop might steal one straight away.
+  {
+    absl::MutexLock l(&mu_);
+    remaining_ = num_chunks;
+  }
+  for (size_t c = 0; c < num_chunks; ++c) {
+    Queue &queue = *queues_[c % queues_.size()];
+    absl::MutexLock l(&queue.mu);
+    queue.chunks.push_back(
+        Chunk{&fn, c * grain, std::min(n, (c + 1) * grain)});
+  }
+  {
+    absl::MutexLock l(&mu_);
+    ++generation_;
+  }
+
+  const int self = static_cast<int>(queues_.size()) - 1;
+  while (RunOne(self)) {
+  }
+
+  absl::MutexLock l(&mu_);
+  mu_.Await(absl::Condition(
+      +[](size_t *remaining) { return *remaining == 0; }, &remaining_));
+}
+
+void ThreadPool::Work(int self) {
+  uint64_t seen = 0;
+  while (true) {
+    {
+      absl::MutexLock l(&mu_);
+      const auto woken = [this, seen]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        return done_ || generation_ != seen;
+      };
+      mu_.Await(absl::Condition(&woken));
+      if (done_) {
+        return;
+      }
+      seen = generation_;
+    }
+    while (RunOne(self)) {
+    }
+  }
+}
+
+bool ThreadPool::RunOne(int self) {
+  absl::optional<Chunk> chunk;
+  {
+    Queue &own = *queues_[self];
+    absl::MutexLock l(&own.mu);
+    if (!own.chunks.empty()) {
+      chunk = own.chunks.back();
+      own.chunks.pop_back();
+    }
+  }
+  for (size_t i = 1; !chunk.has_value() && i < queues_.size(); ++i) {
+    Queue &victim = *queues_[(self + i) % queues_.size()];
+    absl::MutexLock l(&victim.mu);
+    if (!victim.chunks.empty()) {
+      chunk = victim.chunks.front();
+      victim.chunks.pop_front();
+    }
+  }
+  if (!chunk.has_value()) {
+    return false;
+  }
+
+  for (size_t i = chunk->begin; i < chunk->end; ++i) {
+    (*chunk->fn)(i);
+  }
+
+  absl::MutexLock l(&mu_);
+  --remaining_;
+  return true;
+}
+
+} // namespace latis
@@ -0,0 +1,87 @@
+/*
+ * Copyright 2020 Google LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SRC_UTILS_THREAD_POOL_H_
+#define SRC_UTILS_THREAD_POOL_H_
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace latis {
+
+// A fixed set of worker threads which share out the iterations of a loop by
+// work stealing. Each ParallelFor() cuts its range into chunks and deals them
+// out to one deque per thread; a thread works from the back of its own deque
+// and, once that runs dry, steals from the front of the others'.
+class ThreadPool {
+public:
+  // Starts |num_threads| workers. The thread calling ParallelFor() works too,
+  // so a pool of 0 runs everything on the caller.
+  explicit ThreadPool(int num_threads);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  // The number of worker threads, not counting the caller.
+  int size() const { return static_cast<int>(workers_.size()); }
+
+  // Calls fn(i) for every i in [0, n), in no particular order and possibly
+  // concurrently, and returns once every call has. Only one ParallelFor() may
+  // run at a time.
+  void ParallelFor(size_t n, const std::function<void(size_t)> &fn);
+
+private:
+  struct Chunk {
+    const std::function<void(size_t)> *fn;
+    size_t begin;
+    size_t end;
+  };
+
+  struct Queue {
+    absl::Mutex mu;
+    std::deque<Chunk> chunks ABSL_GUARDED_BY(mu);
+  };
+
+  // Waits for chunks and runs them until the pool is destroyed.
+  void Work(int self);
+
+  // Runs one chunk, taken from queue |self| or stolen from another. Returns
+  // false if there were none left anywhere.
+  bool RunOne(int self);
+
+  // One per worker, plus the caller's at the back.
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::vector<std::thread> workers_;
+
+  absl::Mutex mu_;
+  // Bumped by each ParallelFor(), to wake the workers.
+  uint64_t generation_ ABSL_GUARDED_BY(mu_){0};
+  // Chunks of the current ParallelFor() which haven't finished yet.
+  size_t remaining_ ABSL_GUARDED_BY(mu_){0};
+  bool done_ ABSL_GUARDED_BY(mu_){false};
+};
+
+} // namespace latis
+
+#endif // SRC_UTILS_THREAD_POOL_H_
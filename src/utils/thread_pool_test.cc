@@ -0,0 +1,68 @@
+// Copyright 2020 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/utils/thread_pool.h"
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#include <atomic>
+
+namespace latis {
+namespace {
+
+using ::testing::Eq;
+
+class ThreadPoolTest : public ::testing::TestWithParam<int> {};
+
+TEST_P(ThreadPoolTest, VisitsEachIndexOnce) {
+  ThreadPool pool(GetParam());
+  for (size_t n : {0, 1, 2, 7, 100, 10000}) {
+    std::vector<std::atomic<int>> visits(n);
+    pool.ParallelFor(n, [&visits](size_t i) { visits[i]++; });
+    for (size_t i = 0; i < n; ++i) {
+      EXPECT_THAT(visits[i].load(), Eq(1)) << "n=" << n << ", i=" << i;
+    }
+  }
+}
+
+TEST_P(ThreadPoolTest, UnevenWork) {
+  ThreadPool pool(GetParam());
+  std::vector<int64_t> sums(64);
+  pool.ParallelFor(sums.size(), [&sums](size_t i) {
+    // The last few iterations are much more expensive than the rest.
+    const int64_t work = i < 60 ? 10 : 100000;
+    for (int64_t j = 0; j < work; ++j) {
+      sums[i] += j;
+    }
+  });
+  for (size_t i = 0; i < sums.size(); ++i) {
+    const int64_t work = i < 60 ? 10 : 100000;
+    EXPECT_THAT(sums[i], Eq(work * (work - 1) / 2));
+  }
+}
+
+TEST_P(ThreadPoolTest, ManyRounds) {
+  ThreadPool pool(GetParam());
+  std::atomic<int> total{0};
+  for (int round = 0; round < 200; ++round) {
+    pool.ParallelFor(50, [&total](size_t) { total++; });
+  }
+  EXPECT_THAT(total.load(), Eq(200 * 50));
+}
+
+INSTANTIATE_TEST_SUITE_P(Sizes, ThreadPoolTest, ::testing::Values(0, 1, 4));
+
+} // namespace
+} // namespace latis
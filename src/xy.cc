@@ -65,8 +65,8 @@ StatusOr<XY> XY::From(std::string_view a1) {
 
 PointLocation XY::ToPointLocation() const {
   PointLocation pl;
-  pl.set_col(y_);
-  pl.set_row(x_);
+  pl.set_col(x_);
+  pl.set_row(y_);
   return pl;
 }
 
@@ -108,4 +108,29 @@ std::string XY::IntegerToColumnLetter(int i) {
   return v;
 }
 
+StatusOr<XYRange> XYRange::From(const RangeLocation &rl) {
+  if (rl.has_from_cell()) {
+    const XY from = XY::From(rl.from_cell());
+    if (rl.has_to_cell()) {
+      return XYRange(from, XY::From(rl.to_cell()));
+    } else if (rl.has_to_row()) {
+      // A1:3, i.e. A1:A3.
+      return XYRange(from, XY(from.X(), rl.to_row()));
+    } else if (rl.has_to_col()) {
+      // A1:C, i.e. A1:C1.
+      return XYRange(from, XY(rl.to_col(), from.Y()));
+    }
+  } else if (rl.has_from_row() && rl.has_to_row()) {
+    // 1:3, i.e. every column of rows 1 through 3.
+    return XYRange(XY(0, std::min(rl.from_row(), rl.to_row())),
+                   XY(kUnbounded, std::max(rl.from_row(), rl.to_row())));
+  } else if (rl.has_from_col() && rl.has_to_col()) {
+    // A:C, i.e. every row of columns A through C.
+    return XYRange(XY(std::min(rl.from_col(), rl.to_col()), 0),
+                   XY(std::max(rl.from_col(), rl.to_col()), kUnbounded));
+  }
+  return Status(INVALID_ARGUMENT,
+                absl::StrCat("Invalid RangeLocation: ", rl.ShortDebugString()));
+}
+
 } // namespace latis
@@ -23,6 +23,9 @@
 #include "google/protobuf/stubs/status.h"
 #include "google/protobuf/stubs/statusor.h"
 
+#include <algorithm>
+#include <limits>
+
 namespace latis {
 
 // XY is the lingua franca.
@@ -83,6 +86,41 @@ inline std::ostream &operator<<(std::ostream &os, const XY &xy) {
   return os;
 }
 
+// XYRange is an inclusive rectangle of XYs, i.e. the resolved form of a
+// RangeLocation. Whole rows / columns extend to kUnbounded.
+class XYRange {
+public:
+  static constexpr int kUnbounded = std::numeric_limits<int>::max();
+
+  XYRange() {}
+  // Any two corners.
+  XYRange(XY a, XY b)
+      : min_(std::min(a.X(), b.X()), std::min(a.Y(), b.Y())),
+        max_(std::max(a.X(), b.X()), std::max(a.Y(), b.Y())) {}
+  static ::google::protobuf::util::StatusOr<XYRange>
+  From(const RangeLocation &rl);
+
+  XY Min() const { return min_; }
+  XY Max() const { return max_; }
+
+  bool Contains(XY xy) const {
+    return min_.X() <= xy.X() && xy.X() <= max_.X() && min_.Y() <= xy.Y() &&
+           xy.Y() <= max_.Y();
+  }
+  // False for whole rows and columns.
+  bool IsBounded() const {
+    return max_.X() != kUnbounded && max_.Y() != kUnbounded;
+  }
+
+  friend bool operator==(const XYRange &lhs, const XYRange &rhs) {
+    return lhs.min_ == rhs.min_ && lhs.max_ == rhs.max_;
+  }
+
+private:
+  XY min_;
+  XY max_;
+};
+
 } // namespace latis
 
 #endif // SRC_XY_H_
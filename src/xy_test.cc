@@ -109,6 +109,13 @@ TEST(A1ToXy, A2) { EXPECT_THAT(XY::From("A2"), IsOkAndHolds(XY(0, 1))); }
 TEST(A1ToXy, B1) { EXPECT_THAT(XY::From("B1"), IsOkAndHolds(XY(1, 0))); }
 TEST(A1ToXy, B2) { EXPECT_THAT(XY::From("B2"), IsOkAndHolds(XY(1, 1))); }
 
+TEST(XyToPointLocation, RoundTrips) {
+  const XY xy(2, 5);
+  EXPECT_EQ(xy.ToPointLocation().col(), 2);
+  EXPECT_EQ(xy.ToPointLocation().row(), 5);
+  EXPECT_EQ(XY::From(xy.ToPointLocation()), xy);
+}
+
 TEST(A1ToXy, Empty) { EXPECT_FALSE(XY::From("").ok()); }
 TEST(A1ToXy, A) { EXPECT_FALSE(XY::From("A").ok()); }
 TEST(A1ToXy, B) { EXPECT_FALSE(XY::From("B").ok()); }
@@ -116,5 +123,36 @@ TEST(A1ToXy, One) { EXPECT_FALSE(XY::From("1").ok()); }
 TEST(A1ToXy, Two) { EXPECT_FALSE(XY::From("2").ok()); }
 TEST(A1ToXy, 1A) { EXPECT_FALSE(XY::From("1A").ok()); }
 
+TEST(XYRange, FromCells) {
+  const auto range = XYRange::From(ToProto<RangeLocation>(
+      "from_cell { col: 2 row: 3 } to_cell { col: 0 row: 1 }"));
+  ASSERT_THAT(range, IsOk());
+  EXPECT_EQ(range.ValueOrDie().Min(), XY(0, 1));
+  EXPECT_EQ(range.ValueOrDie().Max(), XY(2, 3));
+  EXPECT_TRUE(range.ValueOrDie().IsBounded());
+  EXPECT_TRUE(range.ValueOrDie().Contains(XY(1, 2)));
+  EXPECT_FALSE(range.ValueOrDie().Contains(XY(3, 2)));
+}
+
+TEST(XYRange, FromCellToRow) {
+  EXPECT_THAT(XYRange::From(ToProto<RangeLocation>(
+                  "from_cell { col: 0 row: 0 } to_row: 2")),
+              IsOkAndHolds(XYRange(XY(0, 0), XY(0, 2))));
+}
+
+TEST(XYRange, WholeColumns) {
+  const auto range =
+      XYRange::From(ToProto<RangeLocation>("from_col: 1 to_col: 0"));
+  ASSERT_THAT(range, IsOk());
+  EXPECT_FALSE(range.ValueOrDie().IsBounded());
+  EXPECT_TRUE(range.ValueOrDie().Contains(XY(1, 1000000)));
+  EXPECT_FALSE(range.ValueOrDie().Contains(XY(2, 0)));
+}
+
+TEST(XYRange, Invalid) {
+  EXPECT_FALSE(
+      XYRange::From(ToProto<RangeLocation>("from_row: 1 to_col: 0")).ok());
+}
+
 } // namespace
 } // namespace latis